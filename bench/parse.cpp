@@ -0,0 +1,131 @@
+// Heap allocations made while lexing, parsing and compiling generated programs.
+// Every allocation goes through the counting `operator new` below, so the numbers don't depend on
+// the build type or the machine.
+
+#include "../src/asm/asm.hpp"
+#include "../src/hdl/lexer.hpp"
+#include "../src/hdl/parser.hpp"
+#include "../src/report/source.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+
+namespace fs = std::filesystem;
+
+static std::atomic<std::size_t> allocations { 0 };
+
+void *operator new(std::size_t size) {
+   allocations.fetch_add(1, std::memory_order_relaxed);
+   if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+      return ptr;
+   }
+   throw std::bad_alloc { };
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+// allocations made by `fn`
+template <typename Fn> static std::size_t count_allocations(Fn &&fn) {
+   const auto before = allocations.load(std::memory_order_relaxed);
+   fn();
+   return allocations.load(std::memory_order_relaxed) - before;
+}
+
+// a program using every kind of computation, destination and jump the parser knows about
+static std::string make_asm_program(std::size_t blocks) {
+   std::string program { };
+   for (std::size_t i = 0; i < blocks; i++) {
+      program += std::format("(LOOP_{})\n@var_{}\nD=M\n@{}\nD=D+A\nAM=M-1\nMD=D|M\nA=!D\n"
+                             "D;JGT\n@LOOP_{}\n0;JMP\nAMD=D-1\nM=-1\n",
+          i, i % 300, i, i / 2);
+   }
+   return program;
+}
+
+// a chip with `parts` parts, using buses, ranges and constants in their arguments.
+// Wires have names too long for the small string buffer, so every copy of their token allocates.
+static std::string make_hdl_chip(std::size_t parts) {
+   std::string chip { "CHIP Bench {\n  IN a[16], b[16], sel;\n  OUT out[16];\n\n  PARTS:\n" };
+   for (std::size_t i = 0; i < parts; i++) {
+      chip += std::format("  Mux16(a=a, b[0..7]=selected_word_{}, b[8..15]=false, sel=sel, "
+                          "out=selected_word_{});\n"
+                          "  And(a[{}]=a, b=carry_from_bit_{}, out=carry_from_bit_{});\n",
+          i / 2, i, i % 16, i / 2, i);
+   }
+   chip += "}\n";
+   return chip;
+}
+
+static void bench_asm(std::size_t blocks) {
+   const auto program = make_asm_program(blocks);
+   const report::SourceFile source { std::string_view { program } };
+
+   std::vector<assembly::Token> tokens { };
+   assembly::Lexer lexer { source };
+   const auto lexing = count_allocations([&] { tokens = lexer.tokenize(); });
+
+   std::optional<std::vector<assembly::Instruction>> instructions { };
+   const auto parsing = count_allocations([&] {
+      assembly::Parser parser { tokens, source };
+      instructions = parser.parse();
+   });
+   if (!instructions.has_value()) {
+      std::cerr << "bench_parse: generated assembly failed to parse\n";
+      std::exit(1);
+   }
+
+   std::size_t size = 0;
+   const auto compiling = count_allocations([&] {
+      assembly::CodeGen codegen { std::move(*instructions), std::move(lexer.symbols()), source };
+      const auto rom = codegen.compile();
+      size = rom.has_value() ? rom->size() : 0;
+   });
+
+   std::cout << std::format("asm, {:>5} instructions: {:>7} lexing, {:>7} parsing, {:>7} "
+                            "compiling\n",
+       size, lexing, parsing, compiling);
+}
+
+static void bench_hdl(std::size_t parts) {
+   const auto path = fs::temp_directory_path() / "n2t_bench_parse.hdl";
+   const auto chip = make_hdl_chip(parts);
+   std::ofstream { path } << chip;
+   const report::SourceFile source { std::string_view { chip }, path };
+
+   std::vector<hdl::Token> tokens { };
+   const auto lexing = count_allocations([&] {
+      hdl::Lexer lexer { path.c_str() };
+      tokens = lexer.tokenize();
+   });
+
+   std::optional<std::vector<hdl::Chip>> chips { };
+   const auto parsing = count_allocations([&] {
+      hdl::Parser parser { tokens, source };
+      chips = parser.parse();
+   });
+   fs::remove(path);
+   if (!chips.has_value() || chips->empty()) {
+      std::cerr << "bench_parse: generated chip failed to parse\n";
+      std::exit(1);
+   }
+
+   std::cout << std::format("hdl, {:>5} parts:        {:>7} lexing, {:>7} parsing\n",
+       chips->front().parts.size(), lexing, parsing);
+}
+
+int main() {
+   for (const auto blocks : { 100, 1000 }) {
+      bench_asm(blocks);
+   }
+   for (const auto parts : { 100, 1000 }) {
+      bench_hdl(parts);
+   }
+   return 0;
+}
@@ -0,0 +1,99 @@
+// Interning and assembling with many symbols, as in translated VM programs.
+// Prints the best of several runs of each case, build in release mode for meaningful numbers.
+
+#include "../src/asm/asm.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace chrono = std::chrono;
+
+constexpr std::size_t interns_per_run = 1'000'000;
+constexpr int runs = 9;
+
+// returns the fastest of `runs` calls of `fn` in nanoseconds
+template <typename Fn> static double best_of(Fn &&fn) {
+   auto best = chrono::nanoseconds::max();
+   for (int i = 0; i < runs; i++) {
+      const auto start = chrono::steady_clock::now();
+      fn();
+      best = std::min(best, chrono::steady_clock::now() - start);
+   }
+   return static_cast<double>(best.count());
+}
+
+// names like the ones the VM translator makes up for labels
+static std::vector<std::string> make_names(std::size_t count) {
+   std::vector<std::string> names { };
+   names.reserve(count);
+   for (std::size_t i = 0; i < count; i++) {
+      names.push_back(std::format("Sys.func{}$label_{}", i % 97, i));
+   }
+   return names;
+}
+
+// a program declaring `count` labels and loading every one of them along with a variable
+static std::string make_program(std::size_t count) {
+   std::string program { };
+   for (std::size_t i = 0; i < count; i++) {
+      program += std::format("(Sys.func{}$label_{})\n@Sys.func{}$label_{}\nD=A\n@var_{}\nM=D\n",
+          i % 97, i, (i * 7) % 97, (i * 7) % count, i % 500);
+   }
+   return program;
+}
+
+static void bench_interning(std::size_t symbol_count) {
+   const auto names = make_names(symbol_count);
+   volatile std::uint32_t sink = 0;
+
+   const auto table_ns = best_of([&] {
+      assembly::SymbolTable table { };
+      for (std::size_t i = 0; i < interns_per_run; i++) {
+         sink = static_cast<std::uint32_t>(table.intern(names[i % names.size()]));
+      }
+   });
+
+   // what the table replaced
+   const auto map_ns = best_of([&] {
+      std::unordered_map<std::string, std::uint32_t> map { };
+      for (std::size_t i = 0; i < interns_per_run; i++) {
+         const auto &name = names[i % names.size()];
+         auto it = map.find(name);
+         if (it == map.end()) {
+            it = map.emplace(name, static_cast<std::uint32_t>(map.size())).first;
+         }
+         sink = it->second;
+      }
+   });
+
+   std::cout << std::format("intern, {:>6} symbols: {:6.1f} ns/call flat table, {:6.1f} ns/call "
+                            "unordered_map\n",
+       symbol_count, table_ns / interns_per_run, map_ns / interns_per_run);
+}
+
+static void bench_assembling(std::size_t label_count) {
+   const auto program = make_program(label_count);
+   std::size_t size = 0;
+   const auto ns = best_of([&] {
+      const auto rom = assembly::assemble(program);
+      size = rom.has_value() ? rom->size() : 0;
+   });
+
+   std::cout << std::format("assemble, {:>6} labels: {:8.2f} ms for {} instructions\n",
+       label_count, ns / 1e6, size);
+}
+
+int main() {
+   for (const auto count : { 87, 1000, 25000 }) {
+      bench_interning(count);
+   }
+   for (const auto count : { 1000, 8000 }) {
+      bench_assembling(count);
+   }
+   return 0;
+}
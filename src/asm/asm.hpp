@@ -1,11 +1,144 @@
+#ifndef ASM_ASM_HPP
+#define ASM_ASM_HPP
+
 #include "../base_parser.hpp"
+#include "../isa.hpp"
 #include "../report/report.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
+#include <memory>
+#include <ostream>
+#include <span>
 #include <sstream>
+#include <string_view>
+#include <unordered_map>
 #include <variant>
 
 namespace assembly {
 
+// dense id of a symbol (label or variable name), indexes into per-symbol arrays
+enum class SymbolId : std::uint32_t { };
+
+struct PredefinedSymbol {
+   std::string_view name;
+   std::uint16_t address;
+};
+
+// symbols every program starts out with, they always take the first ids in this order
+constexpr std::array<PredefinedSymbol, 23> PREDEFINED_SYMBOLS { {
+    { "R0", 0 },
+    { "R1", 1 },
+    { "R2", 2 },
+    { "R3", 3 },
+    { "R4", 4 },
+    { "R5", 5 },
+    { "R6", 6 },
+    { "R7", 7 },
+    { "R8", 8 },
+    { "R9", 9 },
+    { "R10", 10 },
+    { "R11", 11 },
+    { "R12", 12 },
+    { "R13", 13 },
+    { "R14", 14 },
+    { "R15", 15 },
+    { "SCREEN", 16384 },
+    { "KBD", 24576 },
+    { "SP", 0 },
+    { "LCL", 1 },
+    { "ARG", 2 },
+    { "THIS", 3 },
+    { "THAT", 4 },
+} };
+
+// variables are given addresses from here on, in order of first use
+constexpr std::uint16_t VAR_START_ADDRESS = 16;
+
+// reads the bytes of `name` in [pos, end) as a little endian word, at most 8 of them
+constexpr std::uint64_t load_symbol_word(std::string_view name, std::size_t pos, std::size_t end) {
+   std::uint64_t word = 0;
+   if (!std::is_constant_evaluated() && std::endian::native == std::endian::little) {
+      // fixed size copies compile down to single loads, shorter words are read from the 8 bytes
+      // ending at `end` when there's enough of them
+      if (end - pos == 8) {
+         std::memcpy(&word, name.data() + pos, 8);
+         return word;
+      }
+      if (end >= 8) {
+         std::memcpy(&word, name.data() + end - 8, 8);
+         return word >> ((8 - (end - pos)) * 8);
+      }
+   }
+
+   for (std::size_t byte = 0; pos + byte < end; byte++) {
+      word |= std::uint64_t { static_cast<unsigned char>(name[pos + byte]) } << (byte * 8);
+   }
+   return word;
+}
+
+// Hashes 8 bytes at a time. Usable at compile time too, so that the predefined symbols can be
+// hashed ahead of time.
+constexpr std::uint32_t hash_symbol(std::string_view name) {
+   constexpr std::uint64_t multiplier = 0x9e3779b97f4a7c15;
+
+   std::uint64_t hash = name.size() * multiplier;
+   for (std::size_t i = 0; i < name.size(); i += 8) {
+      const auto word = load_symbol_word(name, i, std::min(i + 8, name.size()));
+      hash = (hash ^ word) * multiplier;
+      hash ^= hash >> 32;
+   }
+   return static_cast<std::uint32_t>(hash);
+}
+
+// Interns symbol names into `SymbolId`s, so that the rest of the assembler only deals with ids.
+// Movable but not copyable, the names handed out stay valid for as long as the table lives.
+class SymbolTable final {
+   // An open addressing table with linear probing. Each slot keeps the name's hash so that
+   // probing and growing never have to rehash or compare names unless the hashes match.
+   struct Slot {
+      std::uint32_t hash;
+      // `EMPTY_SLOT` when the slot isn't taken
+      std::uint32_t id;
+   };
+
+   static constexpr std::uint32_t EMPTY_SLOT = UINT32_MAX;
+   // holds the predefined symbols, a power of two like every size the table grows to
+   static constexpr std::size_t INITIAL_SLOTS = 64;
+   static constexpr std::size_t CHUNK_SIZE = 4096;
+
+   static constexpr std::array<Slot, INITIAL_SLOTS> seed_slots();
+
+   std::vector<Slot> m_slots { };
+   std::vector<std::string_view> m_names { };
+   // names are copied into chunks that are never reallocated, so that views into them stay valid
+   std::vector<std::unique_ptr<char[]>> m_chunks { };
+   char *m_chunk_next { nullptr };
+   std::size_t m_chunk_left { 0 };
+
+   std::string_view store(std::string_view name);
+   void grow();
+
+   public:
+   SymbolTable();
+   SymbolTable(SymbolTable &&) = default;
+   SymbolTable &operator=(SymbolTable &&) = default;
+
+   SymbolId intern(std::string_view name);
+   std::string_view name(SymbolId id) const;
+   // number of symbols interned so far, ids are always below it
+   std::size_t size() const;
+};
+
+// a label or variable name as it appears in the source
+struct Symbol {
+   SymbolId id;
+   std::string_view name;
+};
+
 struct TokenCoordinate {
    std::size_t row, col;
 };
@@ -21,6 +154,8 @@ enum class TokenType {
    Plus,
    Pipe,
    Ampersand,
+   // only valid with the extended ISA
+   Star,
    AtSymbol,
    Semicolon,
    OpenParen,
@@ -32,7 +167,9 @@ enum class TokenType {
 struct Token {
    TokenType type;
    TokenCoordinate start_coord, end_coord;
-   std::variant<int, std::size_t, std::string> value;
+   // where the token's text is in the lexed source
+   std::size_t offset, length;
+   std::variant<int, std::size_t, Symbol> value;
 };
 enum class Operator {
    None,
@@ -46,6 +183,8 @@ enum class Operator {
    Sub,
    And,
    Or,
+   // extended ISA only
+   Mul,
 };
 
 enum class Address {
@@ -73,34 +212,36 @@ struct BinaryComp {
    Operand right;
 };
 
-enum class Jump {
-   None,
-
-   JGT,
-   JEQ,
-   JLT,
-   JGE,
-   JNE,
-   JLE,
-   JMP,
+// the values are the jump bits, see `isa::JUMPS`
+enum class Jump : std::uint8_t {
+   None = 0,
+
+   JGT = isa::JUMP_GT,
+   JEQ = isa::JUMP_EQ,
+   JLT = isa::JUMP_LT,
+   JGE = isa::JUMP_GT | isa::JUMP_EQ,
+   JNE = isa::JUMP_LT | isa::JUMP_GT,
+   JLE = isa::JUMP_LT | isa::JUMP_EQ,
+   JMP = isa::JUMP_LT | isa::JUMP_EQ | isa::JUMP_GT,
 };
 
-enum class Destination {
-   None,
-
-   A,
-   D,
-   M,
-   MD,
-   AM,
-   AD,
-   AMD
+// the values are the dest bits, see `isa::DESTINATIONS`
+enum class Destination : std::uint8_t {
+   None = 0,
+
+   A = isa::DEST_A,
+   D = isa::DEST_D,
+   M = isa::DEST_M,
+   MD = isa::DEST_M | isa::DEST_D,
+   AM = isa::DEST_A | isa::DEST_M,
+   AD = isa::DEST_A | isa::DEST_D,
+   AMD = isa::DEST_A | isa::DEST_M | isa::DEST_D
 };
 
 struct AInstr {
    TokenCoordinate start_coord;
    TokenCoordinate end_coord;
-   std::variant<std::size_t, std::string> value;
+   std::variant<std::size_t, SymbolId> value;
 };
 
 struct CInstr {
@@ -114,7 +255,7 @@ struct CInstr {
 struct Label {
    TokenCoordinate start_coord;
    TokenCoordinate end_coord;
-   std::string value;
+   SymbolId value;
 };
 
 using Instruction = std::variant<Label, AInstr, CInstr>;
@@ -132,11 +273,16 @@ class Parser final : public BaseParser<Token, TokenType> {
 
    public:
    using BaseParser::BaseParser;
+   // the instructions are moved out, so it's meant to be called once
    std::optional<std::vector<Instruction>> parse();
 };
 
+// Tokens reference the source they were lexed from, so it has to outlive them.
+// Label tokens are interned into `symbols`, which has to be handed over to `CodeGen`.
 class Lexer final {
-   std::istringstream m_asm_file;
+   std::string_view m_source { };
+   SymbolTable m_symbols { };
+   std::size_t m_pos { 0 };
    std::vector<Token> m_tokens { };
    std::size_t m_curr_x { 0 }, m_curr_y { 0 };
 
@@ -145,36 +291,434 @@ class Lexer final {
    void ignore_comment();
 
    public:
-   explicit Lexer(const std::filesystem::path filepath);
-   explicit Lexer(const std::string_view assembly);
+   explicit Lexer(const report::SourceFile &source);
+   // keeps interning into `symbols`, e.g. the table of sources lexed before
+   explicit Lexer(const report::SourceFile &source, SymbolTable symbols);
+
+   Lexer(const Lexer &) = delete;
+   Lexer &operator=(const Lexer &) = delete;
+
+   // the tokens are moved out, so it's meant to be called once
    std::vector<Token> tokenize();
+   SymbolTable &symbols();
 };
 
 // operand can either be in the interval 0, 1 or an address name
 using Operand = std::variant<Address, std::size_t>;
 
+// maps label names to the ROM address they point to
+using Labels = std::unordered_map<std::string, std::uint16_t>;
+
+// appends the lowest `size` bytes of `value` to `buf`, little endian
+void push_uint(std::string &buf, std::uint64_t value, std::size_t size);
+
+// Reads little endian values front to back, any read past the end fails the whole read.
+class ByteReader final {
+   std::string_view m_data;
+   std::size_t m_pos { 0 };
+   bool m_ok { true };
+
+   public:
+   explicit ByteReader(std::string_view data);
+
+   // whether every read so far was within the data
+   bool ok() const;
+   // whether everything was read
+   bool at_end() const;
+   std::string_view bytes(std::size_t size);
+   std::uint64_t uint(std::size_t size);
+};
+
+// where an instruction was written, rows and columns start at 0 just like `TokenCoordinate`'s
+struct SourceLocation {
+   // index into `SourceMap::files`
+   std::uint16_t file { 0 };
+   std::uint16_t col { 0 };
+   std::uint32_t row { 0 };
+};
+
+// Source maps start with SOURCE_MAP_MAGIC and a byte of SOURCE_MAP_VERSION, followed by:
+//   u16 file count, then for every file its u16 path size and the path
+//   u32 instruction count, then for every instruction its u16 file, u16 column and u32 row
+//   u32 label count, then for every label in order of declaration its u16 address, u16 name size
+//   and the name
+//   u32 variable count, then for every variable in order of address its u16 name size and the name
+// All values are little endian.
+constexpr std::array<char, 8> SOURCE_MAP_MAGIC { 'N', '2', 'T', 'S', 'R', 'M', 'A', 'P' };
+constexpr std::uint8_t SOURCE_MAP_VERSION = 1;
+
+// Debug info of an assembled program: where each of its instructions was written, its labels and
+// its variables. It's written next to the ROM as `<rom>.map` by `asm -g`, so that a `.hack` file
+// can be shown with its source lines and symbol names instead of raw disassembly.
+// Lookups by PC and by variable address are O(1).
+class SourceMap final {
+   std::vector<std::filesystem::path> m_files { };
+   // indexed by PC
+   std::vector<SourceLocation> m_locations { };
+   std::vector<std::pair<std::string, std::uint16_t>> m_labels { };
+   // the first one is at `VAR_START_ADDRESS`
+   std::vector<std::string> m_variables { };
+   // index + 1 into `m_labels` of the label closest before each PC, 0 if there's none
+   std::vector<std::uint32_t> m_enclosing_labels { };
+
+   public:
+   SourceMap() = default;
+   // `labels` are in order of declaration, a label declared twice points where it's declared first
+   SourceMap(std::vector<std::filesystem::path> files, std::vector<SourceLocation> locations,
+       std::vector<std::pair<std::string, std::uint16_t>> labels,
+       std::vector<std::string> variables);
+
+   // number of instructions
+   std::size_t size() const;
+   const std::vector<std::filesystem::path> &files() const;
+   // for a program that was moved, e.g. one taken from `ProgramCache`
+   void set_files(std::vector<std::filesystem::path> files);
+   // nothing past the end of the program
+   std::optional<SourceLocation> location(std::uint16_t pc) const;
+   // a label pointing at `pc`, empty if none does
+   std::string_view label_at(std::uint16_t pc) const;
+   // name of the variable at `address`, empty if there's none
+   std::string_view variable_at(std::uint16_t address) const;
+   // where `pc` was written and the closest label before it, e.g. `Prog.asm:12:5 (LOOP+2)`
+   std::string describe(std::uint16_t pc) const;
+   // labels in order of declaration
+   const std::vector<std::pair<std::string, std::uint16_t>> &declared_labels() const;
+   Labels labels() const;
+
+   std::string serialize() const;
+   static std::optional<SourceMap> parse(std::string_view data);
+   bool write(const std::filesystem::path &path) const;
+   // nothing if the file can't be read or isn't a valid map
+   static std::optional<SourceMap> read(const std::filesystem::path &path);
+};
+
 class CodeGen {
    std::vector<Instruction> m_instructions;
+   SymbolTable m_symbols;
    std::uint16_t m_pc { 0 };
+   Labels m_labels { };
+   SourceMap m_source_map { };
+   std::filesystem::path m_path;
+   std::size_t m_first_row;
    std::string m_error_report { "" };
    report::Context m_reporter;
-
-   std::uint16_t compile_cinstr_dest(CInstr ctx) const noexcept;
-   std::optional<std::uint16_t> compile_cinstr_comp(CInstr ctx);
-   std::uint16_t compile_cinstr_jump(CInstr ctx) const noexcept;
-   inline void emit_error(TokenCoordinate start, TokenCoordinate end, std::string_view error_msg);
+   bool m_extended_isa { false };
 
    public:
-   explicit CodeGen(std::vector<Instruction> instructions, std::filesystem::path filepath);
-   explicit CodeGen(std::vector<Instruction> instructions, std::string_view contents);
+   // `symbols` is the table the instructions were lexed with and `source` where they came from,
+   // the source is only borrowed
+   explicit CodeGen(std::vector<Instruction> instructions, SymbolTable symbols,
+       const report::SourceFile &source);
+
+   // accepts the instructions of the multiply extension, see `Hack::extended_isa`
+   void set_extended_isa(bool enabled);
 
    std::optional<std::vector<std::uint16_t>> compile();
    std::string get_error_report();
+   // labels declared in the program, only available after compiling
+   const Labels &get_labels() const;
+   // only available after compiling
+   const SourceMap &get_source_map() const;
+};
+
+// Peephole optimizations over a parsed program, meant to run in between `Parser` and `CodeGen`:
+// - loads of what the A register already holds are removed
+// - `@0 D=A` like pairs are folded into a single `D=0` when A isn't read afterwards
+// - code after an unconditional jump is removed up to the next label that's jumped to
+// - jumps to a label that jumps straight on to another label go to that label instead
+// Then the blocks in between labels are laid out so that each one is followed by its most likely
+// successor, the jumps to the block placed right after are dropped and conditional jumps are
+// inverted when it's their target that's placed right after. Without a profile a block is only
+// moved next to a jump to it when nothing falls into it.
+// Every pass moves instructions around, so jumps have to go to labels. A program with a jump right
+// after loading a number (or any other symbol that isn't a label) is left as is, one that computes
+// numeric jump targets some other way may break. Instructions with errors are left for `CodeGen`
+// to report, and variables keep the addresses they'd get without optimizing.
+class Optimizer final {
+   std::vector<Instruction> m_instructions;
+   // whether each instruction is removed in the current pass
+   std::vector<bool> m_removed { };
+   // labels loaded by some A-instruction, indexed by `SymbolId`
+   std::vector<bool> m_jump_targets { };
+   // index of the first declaration of each label, indexed by `SymbolId`
+   std::vector<std::size_t> m_label_decls { };
+   // see `set_profile`, indexed by PC
+   std::vector<std::uint64_t> m_executed { };
+   std::vector<std::uint64_t> m_taken { };
+   std::ptrdiff_t m_saved { 0 };
+   bool m_extended_isa { false };
+   bool m_profile_used { false };
+
+   void find_labels();
+   bool is_label(SymbolId symbol) const;
+   // whether the label at `index` can be jumped to, as opposed to only being fallen into
+   bool is_jump_target(std::size_t index) const;
+   // the label that the code at `label` does nothing but jump to, if that's all it does
+   std::optional<SymbolId> forwarded_label(SymbolId label) const;
+   // whether some jump goes to the address loaded right before it, e.g. `@7 0;JMP`
+   bool jumps_to_address() const;
+   bool remove_marked();
+
+   bool thread_jumps();
+   bool remove_unreachable();
+   bool fold_constants();
+   bool remove_reloads();
+   // runs the passes above until they're done
+   void simplify();
+   bool lay_out_blocks(bool use_profile);
+
+   public:
+   explicit Optimizer(std::vector<Instruction> instructions);
+
+   // accepts the instructions of the multiply extension, see `Hack::extended_isa`
+   void set_extended_isa(bool enabled);
+   // Lays out the blocks of the program by how often each instruction ran and jumped, as recorded
+   // by `run --profile`. The profile has to be of the program as optimized without one, it's
+   // ignored otherwise.
+   void set_profile(std::span<const std::uint64_t> executed, std::span<const std::uint64_t> taken);
+
+   // the instructions are moved out, so it's meant to be called once
+   std::vector<Instruction> optimize();
+   // number of instructions optimized away, not counting labels. Laying out the blocks by a
+   // profile can add jumps to save cycles, so it can be negative.
+   std::ptrdiff_t saved() const;
+   // whether the profile matched the program and was used, only available after optimizing
+   bool profile_used() const;
+};
+
+// Assembles a program as it's read, a line at a time, without ever holding all of its tokens or
+// instructions. References to labels that aren't declared yet are backpatched once they are,
+// symbols still undeclared by the end become variables, just like with `CodeGen`.
+// Output is written as soon as no earlier instruction is waiting on a symbol, and is otherwise
+// held back, so memory is bounded by the size of the ROM rather than by the size of the source.
+// Once an error is found nothing else is written, but the rest of the lines are still checked.
+class StreamAssembler final {
+   struct SymbolState {
+      // -1 until the symbol is declared or becomes a variable
+      std::int32_t address { -1 };
+      // latest instruction waiting on the symbol, -1 if none are
+      std::int32_t last_ref { -1 };
+   };
+
+   std::ostream &m_output;
+   std::filesystem::path m_name;
+   SymbolTable m_symbols { };
+   std::vector<SymbolState> m_states { };
+   // symbols in the order they were first waited on, variables are allocated in this order
+   std::vector<SymbolId> m_waited_on { };
+   std::size_t m_waiting { 0 };
+   // instructions not written yet, the ones waiting on a symbol hold the address of the previous
+   // instruction waiting on the same symbol (or their own address if they're the first)
+   std::vector<std::uint16_t> m_pending { };
+   std::string m_line { };
+   std::size_t m_row { 0 };
+   std::size_t m_pc { 0 };
+   std::string m_error_report { "" };
+   bool m_rom_full { false };
+   bool m_extended_isa { false };
+
+   void emit(std::uint16_t instruction);
+   void resolve(SymbolId symbol, std::uint16_t address);
+   void flush();
+
+   public:
+   // `name` is only used to refer to the source in reports
+   explicit StreamAssembler(std::ostream &output, std::filesystem::path name);
+
+   // accepts the instructions of the multiply extension, see `Hack::extended_isa`
+   void set_extended_isa(bool enabled);
+
+   // assembles the next line of the source, without its newline
+   void feed_line(std::string_view line);
+   // allocates the remaining variables and writes out what's left.
+   // Returns the number of instructions assembled, or nothing if there were errors.
+   std::optional<std::size_t> finish();
+   std::string get_error_report();
 };
 
+// Assembles a whole source split at line boundaries into chunks, which are lexed, parsed and
+// encoded on separate threads. Only merging the symbols, resolving the labels and allocating the
+// variables are done serially in between.
+// The output is the same as going through `Lexer`, `Parser` and `CodeGen`, which is what's used
+// for small sources and to report errors.
+class ParallelAssembler final {
+   const report::SourceFile &m_source;
+   std::size_t m_threads;
+   Labels m_labels { };
+   std::string m_error_report { "" };
+   SourceMap m_source_map { };
+   std::span<const std::uint64_t> m_executed { };
+   std::span<const std::uint64_t> m_taken { };
+   std::ptrdiff_t m_optimized_away { 0 };
+   bool m_extended_isa { false };
+   bool m_optimize { false };
+   bool m_profile_used { false };
+
+   std::optional<std::vector<std::uint16_t>> assemble_serially();
+
+   public:
+   // the source is only borrowed, `threads` includes the calling thread
+   explicit ParallelAssembler(const report::SourceFile &source, std::size_t threads);
+
+   // accepts the instructions of the multiply extension, see `Hack::extended_isa`
+   void set_extended_isa(bool enabled);
+   // runs `Optimizer` over the program, which needs all of it at once so it's assembled serially
+   void set_optimize(bool enabled);
+   // see `Optimizer::set_profile`, the counts are only borrowed
+   void set_profile(std::span<const std::uint64_t> executed, std::span<const std::uint64_t> taken);
+
+   std::optional<std::vector<std::uint16_t>> assemble();
+   std::string get_error_report();
+   // labels declared in the program, only available after assembling
+   const Labels &get_labels() const;
+   // only available after assembling
+   const SourceMap &get_source_map() const;
+   // see `Optimizer::saved`, only available after assembling
+   std::ptrdiff_t optimized_away() const;
+   // see `Optimizer::profile_used`, only available after assembling
+   bool profile_used() const;
+};
+
+// Keeps a program assembled across edits of its source, for editing programs interactively.
+// Every line is lexed, parsed and encoded on its own, so an edit only goes through the lines it
+// replaces. ROM addresses only shift when an edit changes the number of instructions, and only the
+// A-instructions loading a symbol whose address changed are encoded again.
+// Like with `StreamAssembler` each line holds at most one instruction or label, the output is
+// otherwise the same as `CodeGen`'s.
+class AssemblySession final {
+   enum class LineKind : std::uint8_t {
+      // blank, only a comment or has errors
+      Empty,
+      Label,
+      // an A-instruction loading a symbol, its word depends on where the symbol ends up
+      Load,
+      // any other instruction, its word only depends on the line
+      Word,
+   };
+
+   struct Line {
+      std::string text { };
+      LineKind kind { LineKind::Empty };
+      // the label declared or the symbol loaded
+      SymbolId symbol { };
+      std::uint16_t word { 0 };
+      bool has_errors { false };
+      // loads that have to be encoded even if their symbol's address didn't change
+      bool dirty { false };
+   };
+
+   std::filesystem::path m_name;
+   SymbolTable m_symbols { };
+   std::vector<Line> m_lines { };
+   // pc of each line's instruction, lines without one have the pc of the next instruction
+   std::vector<std::size_t> m_line_pcs { };
+   // address of each symbol, -1 when it's neither declared nor loaded
+   std::vector<std::int32_t> m_addresses { };
+   std::vector<std::uint16_t> m_rom { };
+   Labels m_labels { };
+   std::size_t m_error_lines { 0 };
+   std::string m_line_buf { };
+   bool m_extended_isa { false };
+
+   static bool has_instruction(const Line &line);
+   // assembles `text` found at `row`, appending its errors to `error_report` if given
+   Line assemble_line(std::string_view text, std::size_t row, std::string *error_report = nullptr);
+   // lays out the labels and variables again, re-encoding the loads whose address changed
+   void resolve();
+
+   public:
+   // `name` is only used to refer to the source in reports
+   explicit AssemblySession(std::filesystem::path name);
+
+   // accepts the instructions of the multiply extension, see `Hack::extended_isa`.
+   // Only applies to lines assembled afterwards, `load` the source again to apply it everywhere.
+   void set_extended_isa(bool enabled);
+   bool extended_isa() const;
+
+   // assembles `source` from scratch
+   void load(std::string_view source);
+   // replaces `removed` lines starting at line `first` (0-indexed) with `lines`
+   void edit(std::size_t first, std::size_t removed, std::span<const std::string_view> lines);
+   // replaces the whole source, only reassembling the lines that differ from the current one
+   void update(std::string_view source);
+
+   std::size_t line_count() const;
+   std::string_view line(std::size_t index) const;
+   // line of the instruction at `pc`, if there's one
+   std::optional<std::size_t> line_at(std::size_t pc) const;
+
+   // whether any line has errors, the ROM is incomplete until they're fixed
+   bool has_errors() const;
+   std::string get_error_report();
+   const std::vector<std::uint16_t> &rom() const;
+   const Labels &get_labels() const;
+};
+
+// Bumped whenever the same source would assemble to something different, which invalidates the
+// entries of `ProgramCache`.
+constexpr std::uint32_t ASSEMBLER_VERSION = 2;
+
+// everything besides the source that changes what a program assembles to
+struct AssemblyFlags {
+   // the multiply extension, see `Hack::extended_isa`
+   bool extended_isa { false };
+   // see `Optimizer`
+   bool optimize { false };
+   // whether `CachedProgram::source_map` is kept
+   bool source_map { false };
+};
+
+// an assembled program as stored in `ProgramCache`
+struct CachedProgram {
+   std::vector<std::uint16_t> rom;
+   Labels labels;
+   // see `Optimizer::saved`
+   std::ptrdiff_t optimized_away { 0 };
+   // only with `AssemblyFlags::source_map`
+   std::optional<SourceMap> source_map { };
+};
+
+// Content addressed on-disk cache of assembled programs, so that sources that didn't change are
+// never assembled twice. Entries are keyed by a hash of the source, `ASSEMBLER_VERSION` and the
+// flags the program was assembled with. Only programs without errors are stored, so errors are
+// always reported.
+class ProgramCache final {
+   // nothing when there's nowhere to put the cache, every lookup misses then
+   std::optional<std::filesystem::path> m_dir { };
+
+   std::filesystem::path entry_path(std::string_view source, AssemblyFlags flags) const;
+
+   public:
+   // `$XDG_CACHE_HOME/n2t`, or `~/.cache/n2t` when it isn't set
+   ProgramCache();
+   explicit ProgramCache(std::filesystem::path dir);
+
+   std::optional<CachedProgram> load(std::string_view source, AssemblyFlags flags) const;
+   // failing to write is ignored, the program just gets assembled again the next time
+   void store(std::string_view source, AssemblyFlags flags, const CachedProgram &program) const;
+};
+
+// encodes a C-instruction, reporting errors to `reporter`.
+// `extended_isa` enables the multiply extension, see `Hack::extended_isa`
+std::optional<std::uint16_t> compile_cinstr(
+    const CInstr &inst, report::Context &reporter, bool extended_isa = false);
+// the computation as it's written in `isa::COMPUTATIONS`, e.g. `D+M`
+std::string comp_mnemonic(const std::variant<UnaryComp, BinaryComp> &comp);
+// encodes an A-instruction loading a number, reporting errors to `reporter`
+std::optional<std::uint16_t> compile_ainstr_constant(
+    const AInstr &inst, report::Context &reporter);
+
+// where an instruction starting at `coord` was written, for a source starting at `first_row`.
+// Columns past what `SourceLocation` holds are cut short.
+SourceLocation source_location(TokenCoordinate coord, std::size_t first_row);
+
 std::string to_string(std::vector<std::uint16_t> asm_instructions);
 
-std::optional<std::vector<std::uint16_t>> assemble(std::string_view instructions);
-std::optional<std::string> disassemble(std::uint16_t instruction);
-std::optional<std::string> disassemble(std::string_view instructions);
+// `extended_isa` enables the multiply extension, see `Hack::extended_isa`
+std::optional<std::vector<std::uint16_t>> assemble(
+    std::string_view instructions, bool extended_isa = false);
+std::optional<std::string> disassemble(std::uint16_t instruction, bool extended_isa = false);
+std::optional<std::string> disassemble(std::string_view instructions, bool extended_isa = false);
 }
+
+#endif
@@ -0,0 +1,189 @@
+#include "asm.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+
+namespace assembly {
+
+// Entry layout, all values little endian:
+//   magic `N2TCACHE`, u32 `ASSEMBLER_VERSION`, u8 flags
+//   u64 source size, the source itself
+//   u32 ROM size, the ROM words as u16
+//   u32 label count, then for every label its u16 address, u16 name size and the name
+//   i32 number of instructions optimized away
+//   with CACHE_SOURCE_MAP, the u32 size of the serialized `SourceMap` and the map itself
+// The source is kept so that a hash collision can never hand out the wrong program.
+constexpr std::array<char, 8> CACHE_MAGIC { 'N', '2', 'T', 'C', 'A', 'C', 'H', 'E' };
+constexpr std::uint8_t CACHE_EXTENDED_ISA = 1 << 0;
+constexpr std::uint8_t CACHE_OPTIMIZE = 1 << 1;
+constexpr std::uint8_t CACHE_SOURCE_MAP = 1 << 2;
+
+// the ROM holds 32K instructions, programs that don't fit in it aren't worth caching
+constexpr std::uint64_t max_rom_size = 1 << 15;
+
+// hashes 8 bytes at a time like `hash_symbol`, but keeps all 64 bits
+static std::uint64_t hash_source(std::string_view source, std::uint64_t seed) {
+   constexpr std::uint64_t multiplier = 0x9e3779b97f4a7c15;
+
+   std::uint64_t hash = (seed ^ source.size()) * multiplier;
+   for (std::size_t i = 0; i < source.size(); i += 8) {
+      const auto word = load_symbol_word(source, i, std::min(i + 8, source.size()));
+      hash = (hash ^ word) * multiplier;
+      hash ^= hash >> 32;
+   }
+   return hash;
+}
+
+static std::uint8_t flag_bits(AssemblyFlags flags) {
+   return (flags.extended_isa ? CACHE_EXTENDED_ISA : 0) | (flags.optimize ? CACHE_OPTIMIZE : 0)
+       | (flags.source_map ? CACHE_SOURCE_MAP : 0);
+}
+
+ProgramCache::ProgramCache() {
+   const char *xdg_cache = std::getenv("XDG_CACHE_HOME");
+   if (xdg_cache && std::filesystem::path(xdg_cache).is_absolute()) {
+      m_dir = std::filesystem::path(xdg_cache) / "n2t";
+      return;
+   }
+
+   if (const char *home = std::getenv("HOME"); home && *home) {
+      m_dir = std::filesystem::path(home) / ".cache" / "n2t";
+   }
+}
+
+ProgramCache::ProgramCache(std::filesystem::path dir)
+    : m_dir { std::move(dir) } { }
+
+std::filesystem::path ProgramCache::entry_path(std::string_view source, AssemblyFlags flags) const {
+   const auto hash
+       = hash_source(source, (std::uint64_t { ASSEMBLER_VERSION } << 8) | flag_bits(flags));
+   return m_dir.value() / std::format("{:016x}.bin", hash);
+}
+
+std::optional<CachedProgram> ProgramCache::load(
+    std::string_view source, AssemblyFlags flags) const {
+   if (!m_dir.has_value()) {
+      return std::nullopt;
+   }
+
+   std::ifstream file { this->entry_path(source, flags), std::ios::binary };
+   if (!file.is_open()) {
+      return std::nullopt;
+   }
+   const std::string data { std::istreambuf_iterator<char>(file), { } };
+
+   ByteReader reader { data };
+   const auto magic = reader.bytes(CACHE_MAGIC.size());
+   const auto version = reader.uint(4);
+   const auto cached_flags = reader.uint(1);
+   const auto source_size = reader.uint(8);
+   const auto cached_source = reader.bytes(source_size);
+   if (!reader.ok() || magic != std::string_view(CACHE_MAGIC.data(), CACHE_MAGIC.size())
+       || version != ASSEMBLER_VERSION || cached_flags != flag_bits(flags)
+       || cached_source != source) {
+      return std::nullopt;
+   }
+
+   // a corrupt entry can't hold more than the ROM does, nor more words than it has bytes left for
+   const auto rom_size = reader.uint(4);
+   if (rom_size > max_rom_size || rom_size > data.size() / 2) {
+      return std::nullopt;
+   }
+
+   CachedProgram program { };
+   program.rom.resize(rom_size);
+   for (auto &word : program.rom) {
+      word = static_cast<std::uint16_t>(reader.uint(2));
+   }
+
+   const auto label_count = reader.uint(4);
+   for (std::uint64_t i = 0; i < label_count && reader.ok(); i++) {
+      const auto address = static_cast<std::uint16_t>(reader.uint(2));
+      const auto name = reader.bytes(reader.uint(2));
+      program.labels.emplace(name, address);
+   }
+   program.optimized_away = static_cast<std::int32_t>(reader.uint(4));
+   if (flags.source_map) {
+      program.source_map = SourceMap::parse(reader.bytes(reader.uint(4)));
+      if (!program.source_map.has_value()) {
+         return std::nullopt;
+      }
+   }
+
+   if (!reader.ok()) {
+      return std::nullopt;
+   }
+   return program;
+}
+
+void ProgramCache::store(
+    std::string_view source, AssemblyFlags flags, const CachedProgram &program) const {
+   if (!m_dir.has_value() || program.rom.size() > max_rom_size
+       || (flags.source_map && !program.source_map.has_value())) {
+      return;
+   }
+
+   std::string data { };
+   data.reserve(64 + source.size() + program.rom.size() * 2);
+   data.append(CACHE_MAGIC.data(), CACHE_MAGIC.size());
+   push_uint(data, ASSEMBLER_VERSION, 4);
+   push_uint(data, flag_bits(flags), 1);
+   push_uint(data, source.size(), 8);
+   data.append(source);
+   push_uint(data, program.rom.size(), 4);
+   for (const auto word : program.rom) {
+      push_uint(data, word, 2);
+   }
+   push_uint(data, program.labels.size(), 4);
+   for (const auto &[name, address] : program.labels) {
+      push_uint(data, address, 2);
+      push_uint(data, name.size(), 2);
+      data.append(name);
+   }
+   push_uint(data, static_cast<std::uint32_t>(program.optimized_away), 4);
+   if (flags.source_map) {
+      const auto source_map = program.source_map->serialize();
+      push_uint(data, source_map.size(), 4);
+      data.append(source_map);
+   }
+
+   std::error_code ec;
+   std::filesystem::create_directories(m_dir.value(), ec);
+   if (ec) {
+      return;
+   }
+
+   // written next to the entry and renamed over it, so that readers (possibly other processes
+   // assembling the same source) never see half an entry. The name is unique to the process and
+   // thread, so that writers never share a temporary file either.
+   static std::atomic<std::uint64_t> tmp_counter { 0 };
+   const auto entry = this->entry_path(source, flags);
+   auto tmp = entry;
+   tmp += std::format(".{}.{}.{}.tmp", getpid(),
+       std::hash<std::thread::id> { }(std::this_thread::get_id()), tmp_counter++);
+
+   {
+      std::ofstream file { tmp, std::ios::binary };
+      file.write(data.data(), static_cast<std::streamsize>(data.size()));
+      if (!file) {
+         file.close();
+         std::filesystem::remove(tmp, ec);
+         return;
+      }
+   }
+
+   std::filesystem::rename(tmp, entry, ec);
+   if (ec) {
+      std::filesystem::remove(tmp, ec);
+   }
+}
+
+}; // namespace assembly
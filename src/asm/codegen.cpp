@@ -1,28 +1,45 @@
 #include "../report/report.hpp"
 #include "asm.hpp"
+#include <algorithm>
 #include <bitset>
 #include <cstdint>
 #include <filesystem>
 #include <format>
+#include <limits>
 #include <unordered_map>
 #include <variant>
 #include <vector>
 
 namespace assembly {
 
-CodeGen::CodeGen(std::vector<Instruction> instructions, std::filesystem::path filepath)
-    : m_instructions { instructions }
-    , m_reporter { filepath } { }
-
-CodeGen::CodeGen(std::vector<Instruction> instructions, std::string_view contents)
-    : m_instructions { instructions }
-    , m_reporter { contents } { }
+CodeGen::CodeGen(std::vector<Instruction> instructions, SymbolTable symbols,
+    const report::SourceFile &source)
+    : m_instructions { std::move(instructions) }
+    , m_symbols { std::move(symbols) }
+    , m_path { source.path() }
+    , m_first_row { source.first_row() }
+    , m_reporter { source } { }
 
 std::string CodeGen::get_error_report() { return m_error_report; }
 
-inline void CodeGen::emit_error(
-    TokenCoordinate start, TokenCoordinate end, std::string_view error_msg) {
-   m_reporter.create_report(
+void CodeGen::set_extended_isa(bool enabled) { m_extended_isa = enabled; }
+
+const Labels &CodeGen::get_labels() const { return m_labels; }
+
+const SourceMap &CodeGen::get_source_map() const { return m_source_map; }
+
+SourceLocation source_location(TokenCoordinate coord, std::size_t first_row) {
+   return SourceLocation {
+      .file = 0,
+      .col = static_cast<std::uint16_t>(
+          std::min<std::size_t>(coord.col, std::numeric_limits<std::uint16_t>::max())),
+      .row = static_cast<std::uint32_t>(first_row + coord.row),
+   };
+}
+
+static void emit_error(report::Context &reporter, TokenCoordinate start, TokenCoordinate end,
+    std::string_view error_msg) {
+   reporter.create_report(
        report::ReportType::Error, report::coord(start), report::coord(end), error_msg);
 }
 
@@ -38,369 +55,204 @@ std::string to_string(std::vector<std::uint16_t> asm_instructions) {
    return stringed_asm;
 }
 
-std::optional<std::uint16_t> CodeGen::compile_cinstr_comp(CInstr ctx) {
-   constexpr std::uint16_t comp_mask = 0b0001111111000000;
-   const auto comp = ctx.comp;
-
-   std::uint16_t inst = 0;
-
-   if (std::holds_alternative<UnaryComp>(comp)) {
-      auto unary = std::get<UnaryComp>(comp);
-      switch (unary.op) {
-      case Operator::None:
-         if (std::holds_alternative<std::size_t>(unary.operand)) {
-            auto digit = std::get<std::size_t>(unary.operand);
-            if (digit) {
-               inst = 0b0111111;
-            } else {
-               inst = 0b0101010;
-            }
-         }
-
-         if (std::holds_alternative<Address>(unary.operand)) {
-            auto addr = std::get<Address>(unary.operand);
-            switch (addr) {
-            case Address::D:
-               inst = 0b0001100;
-               break;
-            case Address::A:
-               inst = 0b0110000;
-               break;
-            case Address::M:
-               inst = 0b1110000;
-               break;
-            default:
-               this->emit_error(ctx.start, ctx.end, "Invalid address. Expected A, D or M.");
-               return std::nullopt;
-               break;
-            }
-         }
-         break;
-
-      case Operator::Neg:
-         if (std::holds_alternative<std::size_t>(unary.operand)) {
-            auto digit = std::get<std::size_t>(unary.operand);
-            if (digit) {
-               inst = 0b0111010;
-            } else {
-               this->emit_error(
-                   ctx.start, ctx.end, "`0` cannot be negated. No such instruction exists.");
-               return std::nullopt;
-            }
-         }
-
-         if (std::holds_alternative<Address>(unary.operand)) {
-            auto addr = std::get<Address>(unary.operand);
-            switch (addr) {
-            case Address::D:
-               inst = 0b0001111;
-               break;
-            case Address::A:
-               inst = 0b0110011;
-               break;
-            case Address::M:
-               inst = 0b1110011;
-               break;
-            default:
-               this->emit_error(ctx.start, ctx.end,
-                   "Invalid address. Address cannot be negated. "
-                   "Expected D, A or M.");
-               return std::nullopt;
-               break;
-            }
-         }
-         break;
-
-      case Operator::Not:
-         if (std::holds_alternative<std::size_t>(unary.operand)) {
-            this->emit_error(ctx.start, ctx.end, "Notting a binary number is an invalid operation");
-            return std::nullopt;
-         }
+static void append_operand(std::string &mnemonic, const Operand &operand) {
+   if (std::holds_alternative<std::size_t>(operand)) {
+      mnemonic += std::to_string(std::get<std::size_t>(operand));
+      return;
+   }
 
-         if (std::holds_alternative<Address>(unary.operand)) {
-            auto addr = std::get<Address>(unary.operand);
-            switch (addr) {
-            case Address::D:
-               inst = 0b0001101;
-               break;
-            case Address::A:
-               inst = 0b0110001;
-               break;
-            case Address::M:
-               inst = 0b1110001;
-               break;
-            default:
-               this->emit_error(ctx.start, ctx.end, "Invalid address. Expected D, A or M.");
-               return std::nullopt;
-               break;
-            }
-         }
-         break;
+   switch (std::get<Address>(operand)) {
+   case Address::A:
+      mnemonic += 'A';
+      break;
+   case Address::D:
+      mnemonic += 'D';
+      break;
+   case Address::M:
+      mnemonic += 'M';
+      break;
+   case Address::None:
+      break;
+   }
+}
 
-      default:
-         this->emit_error(
-             ctx.start, ctx.end, "Invalid operator. Expected `|`, `&`, `!`, `+` or `-`.");
-         return std::nullopt;
-         break;
-      }
+static void append_operator(std::string &mnemonic, Operator op) {
+   switch (op) {
+   case Operator::None:
+      break;
+   case Operator::Neg:
+   case Operator::Sub:
+      mnemonic += '-';
+      break;
+   case Operator::Not:
+      mnemonic += '!';
+      break;
+   case Operator::Add:
+      mnemonic += '+';
+      break;
+   case Operator::And:
+      mnemonic += '&';
+      break;
+   case Operator::Or:
+      mnemonic += '|';
+      break;
+   case Operator::Mul:
+      mnemonic += '*';
+      break;
    }
+}
 
-   if (std::holds_alternative<BinaryComp>(comp)) {
-      auto binary = std::get<BinaryComp>(comp);
-      switch (binary.op) {
-      case Operator::Sub:
-         [[fallthrough]];
-      case Operator::Add:
-         if (std::holds_alternative<std::size_t>(binary.right)) {
-            auto digit = std::get<std::size_t>(binary.right);
-            if (!digit) {
-               this->emit_error(
-                   ctx.start, ctx.end, std::format("Expected `1` but found `0`", digit));
-               return std::nullopt;
-            }
+std::string comp_mnemonic(const std::variant<UnaryComp, BinaryComp> &comp) {
+   std::string mnemonic { };
+   if (std::holds_alternative<UnaryComp>(comp)) {
+      const auto &unary = std::get<UnaryComp>(comp);
+      append_operator(mnemonic, unary.op);
+      append_operand(mnemonic, unary.operand);
+   } else {
+      const auto &binary = std::get<BinaryComp>(comp);
+      append_operand(mnemonic, binary.left);
+      append_operator(mnemonic, binary.op);
+      append_operand(mnemonic, binary.right);
+   }
+   return mnemonic;
+}
 
-            switch (binary.left) {
-            case Address::D:
-               inst = binary.op == Operator::Add ? 0b0011111 : 0b0001110;
-               break;
-            case Address::A:
-               inst = binary.op == Operator::Add ? 0b0110111 : 0b0110010;
-               break;
-            case Address::M:
-               inst = binary.op == Operator::Add ? 0b1110111 : 0b1110010;
-               break;
-            default:
-               this->emit_error(ctx.start, ctx.end, "Invalid Address. Expected A, D or M.");
-               return std::nullopt;
-               break;
-            }
-         }
+// `A+D` for `D+A` and so on, for the operators that only exist with D on the left
+static std::optional<std::string> swapped_mnemonic(const BinaryComp &binary) {
+   const auto commutative = binary.op == Operator::Add || binary.op == Operator::And
+       || binary.op == Operator::Or || binary.op == Operator::Mul;
+   if (!commutative || !std::holds_alternative<Address>(binary.right)) {
+      return std::nullopt;
+   }
 
-         if (std::holds_alternative<Address>(binary.right)) {
-            auto addr = std::get<Address>(binary.right);
-            if (binary.left == Address::D) {
-               switch (addr) {
-               case Address::A:
-                  inst = binary.op == Operator::Add ? 0b0000010 : 0b0010011;
-                  break;
-               case Address::M:
-                  inst = binary.op == Operator::Add ? 0b1000010 : 0b1010011;
-                  break;
-               default:
-                  this->emit_error(ctx.start, ctx.end, "Invalid address. Expected A or M");
-                  return std::nullopt;
-                  break;
-               }
-            } else if (addr == Address::D && binary.op == Operator::Sub) {
-               switch (binary.left) {
-               case Address::A:
-                  inst = 0b0000111;
-                  break;
-               case Address::M:
-                  inst = 0b1000111;
-                  break;
-               default:
-                  this->emit_error(ctx.start, ctx.end, "Invalid address. Expected A or M");
-                  return std::nullopt;
-                  break;
-               }
-            } else {
-               this->emit_error(ctx.start, ctx.end, "Invalid address. Expected A or M");
-               return std::nullopt;
-            }
-         }
-         break;
-
-      case Operator::Or:
-         [[fallthrough]];
-      case Operator::And:
-         if (binary.left != Address::D) {
-            this->emit_error(ctx.start, ctx.end, "Invalid address. Left-hand side has to be D.");
-            return std::nullopt;
-         }
+   std::string mnemonic { };
+   append_operand(mnemonic, binary.right);
+   append_operator(mnemonic, binary.op);
+   append_operand(mnemonic, binary.left);
+   return mnemonic;
+}
 
-         if (std::holds_alternative<Address>(binary.right)) {
-            // emit error: and can only be used with addresses
-            auto addr = std::get<Address>(binary.right);
-            switch (addr) {
-            case Address::A:
-               inst = binary.op == Operator::And ? 0b0000000 : 0b0010101;
-               break;
-            case Address::M:
-               inst = binary.op == Operator::And ? 0b1000000 : 0b1010101;
-               break;
-            default:
-               this->emit_error(ctx.start, ctx.end, "Invalid address. Expected A or M");
-               return std::nullopt;
-               break;
-            }
-         } else {
-            this->emit_error(ctx.start, ctx.end, "Right-hand has to be either A or M address.");
-            return std::nullopt;
+static std::optional<std::uint16_t> compile_cinstr_comp(
+    const CInstr &ctx, report::Context &reporter, bool extended_isa) {
+   const auto mnemonic = comp_mnemonic(ctx.comp);
+   const auto comp = isa::find_computation(mnemonic);
+
+   if (!comp.has_value()) {
+      std::string hint { };
+      if (std::holds_alternative<BinaryComp>(ctx.comp)) {
+         const auto swapped = swapped_mnemonic(std::get<BinaryComp>(ctx.comp));
+         if (swapped.has_value() && isa::find_computation(swapped.value()).has_value()) {
+            hint = std::format(" Did you mean `{}`?", swapped.value());
          }
+      }
 
-         break;
+      emit_error(reporter, ctx.start, ctx.end,
+          std::format("`{}` is not a computation the Hack CPU can do.{}", mnemonic, hint));
+      return std::nullopt;
+   }
 
-      default:
-         this->emit_error(
-             ctx.start, ctx.end, "Invalid operator. Expected `|`, `&`, `!`, `+` or `-`.");
-         return std::nullopt;
-         break;
-      }
+   if (comp->extended && !extended_isa) {
+      emit_error(reporter, ctx.start, ctx.end,
+          "Multiplication is only available with the extended instruction set.");
+      return std::nullopt;
    }
 
-   return (inst << 6) & comp_mask;
+   return comp->bits << 6;
 }
 
-std::uint16_t CodeGen::compile_cinstr_dest(CInstr ctx) const noexcept {
-   const auto dest = ctx.dest;
-
-   std::uint16_t inst = 0;
-   switch (dest) {
-   case Destination::None:
-      break;
-   case Destination::M:
-      inst = 0b001;
-      break;
-   case Destination::D:
-      inst = 0b010;
-      break;
-   case Destination::MD:
-      inst = 0b011;
-      break;
-   case Destination::A:
-      inst = 0b100;
-      break;
-   case Destination::AM:
-      inst = 0b101;
-      break;
-   case Destination::AD:
-      inst = 0b110;
-      break;
-   case Destination::AMD:
-      inst = 0b111;
-      break;
+std::optional<std::uint16_t> compile_cinstr(
+    const CInstr &inst, report::Context &reporter, bool extended_isa) {
+   auto comp = compile_cinstr_comp(inst, reporter, extended_isa);
+   if (!comp.has_value()) {
+      return std::nullopt;
    }
 
-   return inst << 3;
+   // the enums hold the dest and jump bits
+   return 0b1110000000000000 | comp.value() | static_cast<std::uint16_t>(inst.dest) << 3
+       | static_cast<std::uint16_t>(inst.jump);
 }
 
-std::uint16_t CodeGen::compile_cinstr_jump(CInstr ctx) const noexcept {
-   std::uint16_t inst = 0;
-   const auto jump = ctx.jump;
+std::optional<std::uint16_t> compile_ainstr_constant(
+    const AInstr &inst, report::Context &reporter) {
+   constexpr std::uint16_t max_label_number = (1 << 15) - 1;
 
-   switch (jump) {
-   case Jump::None:
-      break;
-   case Jump::JGT:
-      inst = 0b001;
-      break;
-   case Jump::JEQ:
-      inst = 0b010;
-      break;
-   case Jump::JGE:
-      inst = 0b011;
-      break;
-   case Jump::JLT:
-      inst = 0b100;
-      break;
-   case Jump::JNE:
-      inst = 0b101;
-      break;
-   case Jump::JLE:
-      inst = 0b110;
-      break;
-   case Jump::JMP:
-      inst = 0b111;
-      break;
+   auto value = std::get<std::size_t>(inst.value);
+   if (value > max_label_number) {
+      emit_error(reporter, inst.start_coord, inst.end_coord,
+          std::format("Label number overflows the 16-bit number. "
+                      "Maximum value is `{}` but found `{}`",
+              max_label_number, value));
+      return std::nullopt;
    }
 
-   return inst;
+   return 0b0111111111111111 & value;
 }
 
 std::optional<std::vector<std::uint16_t>> CodeGen::compile() {
    std::vector<std::uint16_t> compiled_insts { };
-   std::unordered_map<std::string, std::uint16_t> pc_labels {
-      { "R0", 0 },
-      { "R1", 1 },
-      { "R2", 2 },
-      { "R3", 3 },
-      { "R4", 4 },
-      { "R5", 5 },
-      { "R6", 6 },
-      { "R7", 7 },
-      { "R8", 8 },
-      { "R9", 9 },
-      { "R10", 10 },
-      { "R11", 01 },
-      { "R12", 12 },
-      { "R13", 13 },
-      { "R14", 14 },
-      { "R15", 15 },
-      { "SCREEN", 16384 },
-      { "KBD", 24576 },
-      { "SP", 0 },
-      { "LCL", 1 },
-      { "ARG", 2 },
-      { "THIS", 3 },
-      { "THAT", 4 },
-   };
 
-   constexpr std::uint16_t max_label_number = (1 << 15) - 1;
-   constexpr std::uint16_t var_start_address = 16;
+   // address of each symbol indexed by its id, `unresolved` until it's declared or first used
+   constexpr std::int32_t unresolved = -1;
+   std::vector<std::int32_t> symbol_addrs(m_symbols.size(), unresolved);
+   for (std::size_t i = 0; i < PREDEFINED_SYMBOLS.size(); i++) {
+      symbol_addrs[i] = PREDEFINED_SYMBOLS[i].address;
+   }
+
 
-   auto var_addr = var_start_address;
+   auto var_addr = VAR_START_ADDRESS;
+   m_labels.clear();
+   std::vector<std::pair<std::string, std::uint16_t>> declared_labels { };
    for (const auto &inst_variant : m_instructions) {
       if (std::holds_alternative<Label>(inst_variant)) {
-         auto inst = std::get<Label>(inst_variant);
-         pc_labels.emplace(inst.value, m_pc);
+         auto label = std::get<Label>(inst_variant).value;
+         // the first declaration wins and predefined symbols can't be redeclared
+         auto &label_addr = symbol_addrs[static_cast<std::size_t>(label)];
+         if (label_addr == unresolved) {
+            label_addr = m_pc;
+         }
+         m_labels.emplace(m_symbols.name(label), m_pc);
+         declared_labels.emplace_back(m_symbols.name(label), m_pc);
          continue;
       }
       ++m_pc;
    }
 
+   std::vector<SourceLocation> locations { };
+   locations.reserve(m_pc);
+   std::vector<std::string> variables { };
    for (const auto &inst_variant : m_instructions) {
       if (std::holds_alternative<Label>(inst_variant)) {
          continue;
       }
 
       if (std::holds_alternative<AInstr>(inst_variant)) {
-         auto inst = std::get<AInstr>(inst_variant);
+         const auto &inst = std::get<AInstr>(inst_variant);
+         locations.push_back(source_location(inst.start_coord, m_first_row));
          if (std::holds_alternative<std::size_t>(inst.value)) {
-            auto value = std::get<std::size_t>(inst.value);
-            if (value > max_label_number) {
-               this->emit_error(inst.start_coord, inst.end_coord,
-                   std::format("Label number overflows the 16-bit number. "
-                               "Maximum value is `{}` but found `{}`",
-                       max_label_number, value));
-               continue;
+            if (auto binary = compile_ainstr_constant(inst, m_reporter); binary.has_value()) {
+               compiled_insts.push_back(binary.value());
             }
-
-            std::uint16_t binary = 0b0111111111111111 & value;
-            compiled_insts.push_back(binary);
          }
 
-         if (std::holds_alternative<std::string>(inst.value)) {
-            auto value = std::get<std::string>(inst.value);
-
-            if (!pc_labels.contains(value)) {
-               pc_labels.emplace(value, var_addr);
+         if (std::holds_alternative<SymbolId>(inst.value)) {
+            auto symbol = std::get<SymbolId>(inst.value);
+            auto &value_addr = symbol_addrs[static_cast<std::size_t>(symbol)];
+            if (value_addr == unresolved) {
+               value_addr = var_addr;
                ++var_addr;
+               variables.emplace_back(m_symbols.name(symbol));
             }
 
-            auto value_addr = pc_labels.at(value);
             std::uint16_t binary = 0b0111111111111111 & value_addr;
             compiled_insts.push_back(binary);
          }
       }
 
       if (std::holds_alternative<CInstr>(inst_variant)) {
-         auto inst = std::get<CInstr>(inst_variant);
-         if (auto comp_opt = this->compile_cinstr_comp(inst); comp_opt.has_value()) {
-            auto comp = comp_opt.value();
-            std::uint16_t binary = 0b1110000000000000 | comp | this->compile_cinstr_dest(inst)
-                | this->compile_cinstr_jump(inst);
-            compiled_insts.push_back(binary);
+         const auto &inst = std::get<CInstr>(inst_variant);
+         locations.push_back(source_location(inst.start, m_first_row));
+         if (auto binary = compile_cinstr(inst, m_reporter, m_extended_isa); binary.has_value()) {
+            compiled_insts.push_back(binary.value());
          } else {
             continue;
          }
@@ -413,6 +265,8 @@ std::optional<std::vector<std::uint16_t>> CodeGen::compile() {
       return std::nullopt;
    }
 
+   m_source_map = SourceMap { { m_path }, std::move(locations), std::move(declared_labels),
+      std::move(variables) };
    m_pc = 0;
    return compiled_insts;
 }
@@ -421,20 +275,23 @@ std::optional<std::vector<std::uint16_t>> CodeGen::compile() {
 // matters. If good error messages are important, going through all the assembling steps and getting
 // the error reports is preferrable.
 // TODO: return the appended report string when error occurs so that users can still have feedback
-std::optional<std::vector<std::uint16_t>> assemble(std::string_view instructions) {
-   Lexer lexer { instructions };
+std::optional<std::vector<std::uint16_t>> assemble(
+    std::string_view instructions, bool extended_isa) {
+   const report::SourceFile source { instructions };
+   Lexer lexer { source };
    auto tokens = lexer.tokenize();
    if (tokens.empty()) {
       return std::nullopt;
    }
 
-   Parser parser { tokens, std::string_view("<memory>") };
+   Parser parser { tokens, source };
    auto parsed_insts = parser.parse();
    if (!parsed_insts.has_value()) {
       return std::nullopt;
    }
 
-   CodeGen codegen { parsed_insts.value(), std::string_view("<memory>") };
+   CodeGen codegen { std::move(parsed_insts.value()), std::move(lexer.symbols()), source };
+   codegen.set_extended_isa(extended_isa);
    return codegen.compile();
 }
 
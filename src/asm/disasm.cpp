@@ -1,3 +1,4 @@
+#include "../isa.hpp"
 #include <cstdint>
 #include <format>
 #include <optional>
@@ -6,138 +7,29 @@
 
 namespace assembly {
 
-std::optional<std::string> disassemble(std::uint16_t instruction) {
+std::optional<std::string> disassemble(std::uint16_t instruction, bool extended_isa) {
 
    constexpr std::uint16_t cinstr_flag = 0b111 << 13;
    constexpr std::uint16_t ainst_flag = 1 << 15;
 
    if ((instruction & cinstr_flag) == cinstr_flag) {
-      std::uint16_t a = (instruction >> 12) & 1;
-      std::uint16_t comp = (instruction >> 6) & 0b111111;
       std::uint16_t dest = (instruction >> 3) & 0b111;
       std::uint16_t jump = instruction & 0b111;
 
-      std::string inst_str;
-      if (dest) {
-         switch (dest) {
-         case 0b001:
-            inst_str += 'M';
-            break;
-         case 0b010:
-            inst_str += 'D';
-            break;
-         case 0b011:
-            inst_str += "MD";
-            break;
-         case 0b100:
-            inst_str += 'A';
-            break;
-         case 0b101:
-            inst_str += "AM";
-            break;
-         case 0b110:
-            inst_str += "AD";
-            break;
-         case 0b111:
-            inst_str += "AMD";
-            break;
-         }
-      }
+      std::string inst_str { isa::DESTINATIONS[dest] };
 
-      std::string comp_str;
-      bool valid_comp = true;
-      switch (comp) {
-      case 0b101010:
-         comp_str += '0';
-         break;
-      case 0b111111:
-         comp_str += '1';
-         break;
-      case 0b111010:
-         comp_str += "-1";
-         break;
-      case 0b001100:
-         comp_str += 'D';
-         break;
-      case 0b110000:
-         comp_str += a ? 'M' : 'A';
-         break;
-      case 0b001101:
-         comp_str += "!D";
-         break;
-      case 0b110001:
-         comp_str += a ? "!M" : "!A";
-         break;
-      case 0b001111:
-         comp_str += "-D";
-         break;
-      case 0b110011:
-         comp_str += a ? "-M" : "-A";
-         break;
-      case 0b011111:
-         comp_str += "D+1";
-         break;
-      case 0b110111:
-         comp_str += a ? "M+1" : "A+1";
-         break;
-      case 0b001110:
-         comp_str += "D-1";
-         break;
-      case 0b110010:
-         comp_str += a ? "M-1" : "A-1";
-         break;
-      case 0b000010:
-         comp_str += a ? "D+M" : "D+A";
-         break;
-      case 0b010011:
-         comp_str += a ? "D-M" : "D-A";
-         break;
-      case 0b000111:
-         comp_str += a ? "M-D" : "A-D";
-         break;
-      case 0b000000:
-         comp_str += a ? "D&M" : "D&A";
-         break;
-      case 0b010101:
-         comp_str += a ? "D|M" : "D|A";
-         break;
-      default:
-         valid_comp = false;
-         break;
-      }
-
-      if (valid_comp) {
+      // invalid computations are left out, only dest and jump are shown for them
+      const auto &comp = isa::DECODED_COMPUTATIONS[(instruction >> 6) & 0b1111111];
+      if (comp.has_value() && (!comp->extended || extended_isa)) {
          if (dest) {
             inst_str += '=';
          }
-         inst_str += comp_str;
+         inst_str += comp->mnemonic;
       }
 
       if (jump) {
          inst_str += ';';
-         switch (jump) {
-         case 0b001:
-            inst_str += "JGT";
-            break;
-         case 0b010:
-            inst_str += "JEQ";
-            break;
-         case 0b011:
-            inst_str += "JGE";
-            break;
-         case 0b100:
-            inst_str += "JLT";
-            break;
-         case 0b101:
-            inst_str += "JNE";
-            break;
-         case 0b110:
-            inst_str += "JLE";
-            break;
-         case 0b111:
-            inst_str += "JMP";
-            break;
-         }
+         inst_str += isa::JUMPS[jump];
       }
       return inst_str;
    }
@@ -150,7 +42,7 @@ std::optional<std::string> disassemble(std::uint16_t instruction) {
    return std::nullopt;
 }
 
-std::optional<std::string> disassemble(std::string_view instructions) {
+std::optional<std::string> disassemble(std::string_view instructions, bool extended_isa) {
    std::stringstream inststream { instructions.data() };
    std::string asm_str;
 
@@ -158,7 +50,7 @@ std::optional<std::string> disassemble(std::string_view instructions) {
    while (std::getline(inststream, tmp)) {
       try {
          auto inst = std::stoull(tmp, nullptr, 2);
-         auto inst_str = disassemble(inst);
+         auto inst_str = disassemble(inst, extended_isa);
          if (!inst_str.has_value()) {
             return std::nullopt;
          }
@@ -1,65 +1,58 @@
 #include "asm.hpp"
 #include <cctype>
-#include <filesystem>
-#include <fstream>
-#include <stdexcept>
+#include <charconv>
 #include <vector>
 
 namespace assembly {
 
-Lexer::Lexer(const std::filesystem::path filepath)
-    : m_asm_file { } {
-   if (!std::filesystem::exists(filepath)) {
-      // TODO check appropriate exception to throw
-      throw "The assembly file path does not exist";
-   }
-
-   std::ifstream asm_input { filepath };
-   std::stringstream ss;
-   ss << asm_input.rdbuf();
-   m_asm_file.str(ss.str());
+static bool is_label_start(char ch) {
+   return std::isalpha(static_cast<unsigned char>(ch)) || ch == '_' || ch == '.' || ch == '$';
 }
 
-Lexer::Lexer(const std::string_view assembly) {
-   std::string asm_copy { assembly };
-   m_asm_file = std::istringstream(std::move(asm_copy));
+static bool is_label_char(char ch) {
+   return std::isalnum(static_cast<unsigned char>(ch)) || ch == '_' || ch == '.' || ch == '$';
 }
 
-std::vector<Token> Lexer::tokenize() {
-   for (;;) {
-      auto ch = m_asm_file.get();
+static bool is_digit(char ch) { return ch >= '0' && ch <= '9'; }
 
-      if (m_asm_file.eof()) {
-         break;
+Lexer::Lexer(const report::SourceFile &source)
+    : m_source { source.contents() } { }
+
+Lexer::Lexer(const report::SourceFile &source, SymbolTable symbols)
+    : m_source { source.contents() }
+    , m_symbols { std::move(symbols) } { }
+
+std::vector<Token> Lexer::tokenize() {
+   // most lines hold a single instruction of around 3 tokens plus the newline
+   m_tokens.reserve(m_source.size() / 4);
+
+   while (m_pos < m_source.size()) {
+      const char ch = m_source[m_pos];
+
+      if (ch == '\n') {
+         TokenCoordinate coord { m_curr_y, m_curr_x };
+         m_tokens.push_back(Token {
+             .type = TokenType::Newline,
+             .start_coord = coord,
+             .end_coord = coord,
+             .offset = m_pos,
+             .length = 1,
+             .value = ch,
+         });
+
+         ++m_pos;
+         ++m_curr_y;
+         m_curr_x = 0;
+         continue;
       }
 
-      if (std::isspace(ch)) {
-         if (ch == '\n') {
-            Token newline{
-            .type = TokenType::Newline,
-            .start_coord =
-                {
-                    .row = m_curr_y,
-                    .col = m_curr_x,
-                },
-            .end_coord =
-                {
-                    .row = m_curr_y,
-                    .col = m_curr_x,
-                },
-            .value = ch,
-        };
-            m_tokens.push_back(newline);
-
-            ++m_curr_y;
-            m_curr_x = 0;
-         } else {
-            ++m_curr_x;
-         }
+      if (std::isspace(static_cast<unsigned char>(ch))) {
+         ++m_pos;
+         ++m_curr_x;
          continue;
       }
 
-      if (ch == '/' && m_asm_file.peek() == '/') {
+      if (ch == '/' && m_pos + 1 < m_source.size() && m_source[m_pos + 1] == '/') {
          this->ignore_comment();
          continue;
       }
@@ -84,6 +77,9 @@ std::vector<Token> Lexer::tokenize() {
       case '&':
          type = TokenType::Ampersand;
          break;
+      case '*':
+         type = TokenType::Star;
+         break;
       case '(':
          type = TokenType::OpenParen;
          break;
@@ -98,107 +94,88 @@ std::vector<Token> Lexer::tokenize() {
          break;
       }
 
-      TokenCoordinate token_coord { m_curr_y, m_curr_x };
-      Token tok { type, token_coord, token_coord, ch };
-
-      if (type == TokenType::Unknown) {
-         if (std::isalpha(ch) || ch == '_' || ch == '.' || ch == '$') {
-            tok = this->lex_label();
-         }
-
-         if (std::isdigit(ch)) {
-            tok = this->lex_number();
-         }
+      if (type == TokenType::Unknown && is_label_start(ch)) {
+         m_tokens.push_back(this->lex_label());
+      } else if (type == TokenType::Unknown && is_digit(ch)) {
+         m_tokens.push_back(this->lex_number());
+      } else {
+         TokenCoordinate coord { m_curr_y, m_curr_x };
+         m_tokens.push_back(Token {
+             .type = type,
+             .start_coord = coord,
+             .end_coord = coord,
+             .offset = m_pos,
+             .length = 1,
+             .value = ch,
+         });
+         ++m_pos;
+         ++m_curr_x;
       }
-
-      m_tokens.push_back(tok);
-      ++m_curr_x;
    }
 
-   return m_tokens;
+   return std::move(m_tokens);
 }
 
-Token Lexer::lex_label() {
-   TokenCoordinate start {
-      .row = m_curr_y,
-      .col = m_curr_x,
-   };
-
-   std::string ident { };
-   m_asm_file.unget();
-   ident += m_asm_file.get();
+SymbolTable &Lexer::symbols() { return m_symbols; }
 
-   while (!m_asm_file.eof()) {
-      auto ch = m_asm_file.peek();
-      if (!std::isalnum(ch) && ch != '_' && ch != '.' && ch != '$') {
-         break;
-      }
+Token Lexer::lex_label() {
+   const std::size_t start = m_pos;
+   const auto start_x = m_curr_x;
 
-      ident += m_asm_file.get();
-      ++m_curr_x;
+   ++m_pos;
+   while (m_pos < m_source.size() && is_label_char(m_source[m_pos])) {
+      ++m_pos;
    }
 
-   TokenCoordinate end {
-      .row = m_curr_y,
-      .col = m_curr_x,
-   };
+   const std::size_t length = m_pos - start;
+   m_curr_x += length;
 
+   const auto name = m_source.substr(start, length);
    return Token {
       .type = TokenType::Label,
-      .start_coord = start,
-      .end_coord = end,
-      .value = ident,
+      .start_coord = { m_curr_y, start_x },
+      .end_coord = { m_curr_y, start_x + length - 1 },
+      .offset = start,
+      .length = length,
+      .value = Symbol { m_symbols.intern(name), name },
    };
 }
 
 Token Lexer::lex_number() {
-   TokenCoordinate start {
-      .row = m_curr_y,
-      .col = m_curr_x,
-   };
+   const std::size_t start = m_pos;
+   const auto start_x = m_curr_x;
 
-   std::string numstr { };
-   m_asm_file.unget();
-   numstr += m_asm_file.get();
-
-   while (!m_asm_file.eof() && std::isdigit(m_asm_file.peek())) {
-      numstr += m_asm_file.get();
-      ++m_curr_x;
+   ++m_pos;
+   while (m_pos < m_source.size() && is_digit(m_source[m_pos])) {
+      ++m_pos;
    }
 
-   TokenCoordinate end {
-      .row = m_curr_y,
-      .col = m_curr_x,
+   const std::size_t length = m_pos - start;
+   m_curr_x += length;
+
+   Token tok {
+      .type = TokenType::Number,
+      .start_coord = { m_curr_y, start_x },
+      .end_coord = { m_curr_y, start_x + length - 1 },
+      .offset = start,
+      .length = length,
+      .value = 0,
    };
 
    int num;
-   try {
-      num = std::stoi(numstr);
-   } catch (std::out_of_range) {
-      return Token {
-         .type = TokenType::Unknown,
-         .start_coord = start,
-         .end_coord = end,
-         .value = 0,
-      };
+   const char *first = m_source.data() + start;
+   if (std::from_chars(first, first + length, num).ec != std::errc()) {
+      tok.type = TokenType::Unknown;
+      return tok;
    }
 
-   return Token {
-      .type = TokenType::Number,
-      .start_coord = start,
-      .end_coord = end,
-      .value = static_cast<std::size_t>(num),
-   };
+   tok.value = static_cast<std::size_t>(num);
+   return tok;
 }
 
 void Lexer::ignore_comment() {
-   if (m_asm_file.peek() != '/') {
-      return;
-   }
-   m_asm_file.get();
-
-   while (!m_asm_file.eof() && m_asm_file.peek() != '\n') {
-      m_asm_file.get();
+   while (m_pos < m_source.size() && m_source[m_pos] != '\n') {
+      ++m_pos;
       ++m_curr_x;
    }
 }
@@ -0,0 +1,839 @@
+#include "asm.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <variant>
+#include <vector>
+
+namespace assembly {
+
+// passes are repeated until none of them finds anything left to do, usually after 2 or 3 rounds
+constexpr std::size_t max_rounds = 16;
+// labels jumping to each other in a loop never settle, so threading gives up after this many
+constexpr std::size_t max_jump_hops = 8;
+constexpr std::size_t max_constant = (1 << 15) - 1;
+constexpr std::uint8_t comp_a_bit = 0b1000000;
+constexpr std::size_t no_instruction = static_cast<std::size_t>(-1);
+constexpr std::size_t no_block = static_cast<std::size_t>(-1);
+
+namespace {
+
+enum class JumpKind {
+   Never,
+   Conditional,
+   Always,
+};
+
+// instructions in between labels, which can only be entered at the start
+struct Block {
+   // the labels at the start are part of the block
+   std::size_t start { 0 };
+   std::size_t end { 0 };
+   // index and PC of the last instruction that isn't a label
+   std::size_t last { no_instruction };
+   std::size_t last_pc { 0 };
+   // label to jump to the block with, the first one declared at its start
+   std::optional<SymbolId> anchor { };
+   // whether A is read before it's loaded, so it matters how the block is entered
+   bool reads_a { true };
+   bool falls_through { true };
+   // block that the `@label` and jump at the end go to, if they can be dropped or inverted when
+   // it's placed right after
+   std::size_t jump_target { no_block };
+   JumpKind jump { JumpKind::Never };
+};
+
+// the chance of `to` being run right after `from`
+struct Edge {
+   std::uint64_t weight { 0 };
+   std::size_t from { 0 };
+   std::size_t to { 0 };
+};
+
+}; // namespace
+
+// the computation of a C-instruction, nothing if it's not one the CPU can do (`CodeGen` reports
+// those)
+static std::optional<isa::Computation> computation(const CInstr &inst, bool extended_isa) {
+   const auto comp = isa::find_computation(comp_mnemonic(inst.comp));
+   if (!comp.has_value() || (comp->extended && !extended_isa)) {
+      return std::nullopt;
+   }
+   return comp;
+}
+
+// whether computing `op` reads A, or M when the a-bit is set
+static bool reads_y(isa::AluOp op) {
+   switch (op) {
+   case isa::AluOp::Invalid:
+   case isa::AluOp::Zero:
+   case isa::AluOp::One:
+   case isa::AluOp::MinusOne:
+   case isa::AluOp::X:
+   case isa::AluOp::NotX:
+   case isa::AluOp::NegX:
+   case isa::AluOp::IncX:
+   case isa::AluOp::DecX:
+      return false;
+   case isa::AluOp::Y:
+   case isa::AluOp::NotY:
+   case isa::AluOp::NegY:
+   case isa::AluOp::IncY:
+   case isa::AluOp::DecY:
+   case isa::AluOp::XPlusY:
+   case isa::AluOp::XMinusY:
+   case isa::AluOp::YMinusX:
+   case isa::AluOp::XAndY:
+   case isa::AluOp::XOrY:
+   case isa::AluOp::XTimesY:
+      return true;
+   }
+   return true;
+}
+
+static bool has_dest(const CInstr &inst, std::uint8_t dest) {
+   return (static_cast<std::uint8_t>(inst.dest) & dest) != 0;
+}
+
+// jumps on a constant computation are decided before the program even runs
+static JumpKind jump_kind(const CInstr &inst, const isa::Computation &comp) {
+   if (inst.jump == Jump::None) {
+      return JumpKind::Never;
+   }
+   if (inst.jump == Jump::JMP) {
+      return JumpKind::Always;
+   }
+
+   std::uint16_t result = 0;
+   switch (comp.op) {
+   case isa::AluOp::Zero:
+      result = 0;
+      break;
+   case isa::AluOp::One:
+      result = 1;
+      break;
+   case isa::AluOp::MinusOne:
+      result = 0xFFFF;
+      break;
+   default:
+      return JumpKind::Conditional;
+   }
+
+   const auto taken = static_cast<std::uint8_t>(inst.jump) & isa::jump_condition(result);
+   return taken ? JumpKind::Always : JumpKind::Never;
+}
+
+static bool is_valid(const AInstr &inst) {
+   return !std::holds_alternative<std::size_t>(inst.value)
+       || std::get<std::size_t>(inst.value) <= max_constant;
+}
+
+// what A holds after `inst`, predefined symbols are the same as the address they stand for
+static std::variant<std::size_t, SymbolId> loaded_value(const AInstr &inst) {
+   if (std::holds_alternative<SymbolId>(inst.value)) {
+      const auto symbol = static_cast<std::size_t>(std::get<SymbolId>(inst.value));
+      if (symbol < PREDEFINED_SYMBOLS.size()) {
+         return std::size_t { PREDEFINED_SYMBOLS[symbol].address };
+      }
+   }
+   return inst.value;
+}
+
+// what `inst` computes with A holding `value`, as a computation that doesn't read A.
+// Nothing when the result isn't one the CPU can compute from D alone.
+static std::optional<std::variant<UnaryComp, BinaryComp>> fold_comp(
+    const CInstr &inst, isa::AluOp op, std::size_t value) {
+   const auto unary = [&](Operator op, Operand operand) {
+      return UnaryComp { .start = inst.start, .end = inst.end, .op = op, .operand = operand };
+   };
+   const auto d_and_one = [&](Operator op) {
+      return BinaryComp {
+         .start = inst.start,
+         .end = inst.end,
+         .left = Address::D,
+         .op = op,
+         .right = std::size_t { 1 },
+      };
+   };
+   const auto constant = [&](std::uint16_t result) -> std::optional<UnaryComp> {
+      switch (result) {
+      case 0:
+         return unary(Operator::None, std::size_t { 0 });
+      case 1:
+         return unary(Operator::None, std::size_t { 1 });
+      case 0xFFFF:
+         return unary(Operator::Neg, std::size_t { 1 });
+      default:
+         return std::nullopt;
+      }
+   };
+
+   const auto y = static_cast<std::uint16_t>(value);
+   switch (op) {
+   case isa::AluOp::Y:
+      return constant(y);
+   case isa::AluOp::NotY:
+      return constant(static_cast<std::uint16_t>(~y));
+   case isa::AluOp::NegY:
+      return constant(static_cast<std::uint16_t>(-y));
+   case isa::AluOp::IncY:
+      return constant(static_cast<std::uint16_t>(y + 1));
+   case isa::AluOp::DecY:
+      return constant(static_cast<std::uint16_t>(y - 1));
+   case isa::AluOp::XPlusY:
+      if (y <= 1) {
+         return y == 0 ? std::variant<UnaryComp, BinaryComp> { unary(Operator::None, Address::D) }
+                       : d_and_one(Operator::Add);
+      }
+      break;
+   case isa::AluOp::XMinusY:
+      if (y <= 1) {
+         return y == 0 ? std::variant<UnaryComp, BinaryComp> { unary(Operator::None, Address::D) }
+                       : d_and_one(Operator::Sub);
+      }
+      break;
+   case isa::AluOp::YMinusX:
+      if (y == 0) {
+         return unary(Operator::Neg, Address::D);
+      }
+      break;
+   case isa::AluOp::XAndY:
+      if (y == 0) {
+         return constant(0);
+      }
+      break;
+   case isa::AluOp::XOrY:
+      if (y == 0) {
+         return unary(Operator::None, Address::D);
+      }
+      break;
+   case isa::AluOp::XTimesY:
+      if (y <= 1) {
+         return y == 0 ? constant(0) : unary(Operator::None, Address::D);
+      }
+      break;
+   default:
+      break;
+   }
+   return std::nullopt;
+}
+
+// whether the code in [start, end) reads A before loading it, which it also does by running past
+// `end`
+static bool reads_a_first(std::span<const Instruction> instructions, std::size_t start,
+    std::size_t end, bool extended_isa) {
+   for (std::size_t i = start; i < end; i++) {
+      if (std::holds_alternative<Label>(instructions[i])) {
+         continue;
+      }
+      if (std::holds_alternative<AInstr>(instructions[i])) {
+         return false;
+      }
+
+      const auto &inst = std::get<CInstr>(instructions[i]);
+      const auto comp = computation(inst, extended_isa);
+      if (!comp.has_value() || reads_y(comp->op) || has_dest(inst, isa::DEST_M)) {
+         return true;
+      }
+      // a jump goes wherever A was just set to
+      if (has_dest(inst, isa::DEST_A)) {
+         return false;
+      }
+      if (inst.jump != Jump::None) {
+         return true;
+      }
+   }
+   return true;
+}
+
+Optimizer::Optimizer(std::vector<Instruction> instructions)
+    : m_instructions { std::move(instructions) } { }
+
+void Optimizer::set_extended_isa(bool enabled) { m_extended_isa = enabled; }
+
+void Optimizer::set_profile(
+    std::span<const std::uint64_t> executed, std::span<const std::uint64_t> taken) {
+   m_executed.assign(executed.begin(), executed.end());
+   m_taken.assign(taken.begin(), taken.end());
+}
+
+std::ptrdiff_t Optimizer::saved() const { return m_saved; }
+
+bool Optimizer::profile_used() const { return m_profile_used; }
+
+void Optimizer::find_labels() {
+   std::size_t symbol_count = PREDEFINED_SYMBOLS.size();
+   for (const auto &inst_variant : m_instructions) {
+      if (const auto *label = std::get_if<Label>(&inst_variant)) {
+         symbol_count = std::max(symbol_count, static_cast<std::size_t>(label->value) + 1);
+      } else if (const auto *inst = std::get_if<AInstr>(&inst_variant);
+          inst && std::holds_alternative<SymbolId>(inst->value)) {
+         const auto symbol = static_cast<std::size_t>(std::get<SymbolId>(inst->value));
+         symbol_count = std::max(symbol_count, symbol + 1);
+      }
+   }
+
+   // the first declaration wins and predefined symbols can't be redeclared, just like in `CodeGen`
+   m_label_decls.assign(symbol_count, no_instruction);
+   for (std::size_t i = 0; i < m_instructions.size(); i++) {
+      if (const auto *label = std::get_if<Label>(&m_instructions[i])) {
+         const auto symbol = static_cast<std::size_t>(label->value);
+         if (symbol >= PREDEFINED_SYMBOLS.size() && m_label_decls[symbol] == no_instruction) {
+            m_label_decls[symbol] = i;
+         }
+      }
+   }
+
+   // a label that's loaded can be jumped to, be it right away or later on from a return address
+   m_jump_targets.assign(symbol_count, false);
+   for (const auto &inst_variant : m_instructions) {
+      const auto *inst = std::get_if<AInstr>(&inst_variant);
+      if (inst && std::holds_alternative<SymbolId>(inst->value)) {
+         const auto symbol = std::get<SymbolId>(inst->value);
+         m_jump_targets[static_cast<std::size_t>(symbol)] = this->is_label(symbol);
+      }
+   }
+}
+
+bool Optimizer::is_label(SymbolId symbol) const {
+   const auto index = static_cast<std::size_t>(symbol);
+   return index < m_label_decls.size() && m_label_decls[index] != no_instruction;
+}
+
+bool Optimizer::is_jump_target(std::size_t index) const {
+   const auto &label = std::get<Label>(m_instructions[index]);
+   const auto symbol = static_cast<std::size_t>(label.value);
+   return m_label_decls[symbol] == index && m_jump_targets[symbol];
+}
+
+std::optional<SymbolId> Optimizer::forwarded_label(SymbolId label) const {
+   auto target = m_label_decls[static_cast<std::size_t>(label)];
+   while (target < m_instructions.size() && std::holds_alternative<Label>(m_instructions[target])) {
+      ++target;
+   }
+   if (target + 1 >= m_instructions.size()) {
+      return std::nullopt;
+   }
+
+   const auto *load = std::get_if<AInstr>(&m_instructions[target]);
+   const auto *jump = std::get_if<CInstr>(&m_instructions[target + 1]);
+   if (!load || !jump || !std::holds_alternative<SymbolId>(load->value)
+       || !this->is_label(std::get<SymbolId>(load->value))) {
+      return std::nullopt;
+   }
+
+   // the jump can't do anything besides jumping
+   const auto comp = computation(*jump, m_extended_isa);
+   if (!comp.has_value() || jump_kind(*jump, comp.value()) != JumpKind::Always
+       || jump->dest != Destination::None || reads_y(comp->op)) {
+      return std::nullopt;
+   }
+   return std::get<SymbolId>(load->value);
+}
+
+bool Optimizer::jumps_to_address() const {
+   for (std::size_t i = 0; i + 1 < m_instructions.size(); i++) {
+      const auto *load = std::get_if<AInstr>(&m_instructions[i]);
+      const auto *jump = std::get_if<CInstr>(&m_instructions[i + 1]);
+      if (!load || !jump || jump->jump == Jump::None) {
+         continue;
+      }
+      if (!std::holds_alternative<SymbolId>(load->value)
+          || !this->is_label(std::get<SymbolId>(load->value))) {
+         return true;
+      }
+   }
+   return false;
+}
+
+bool Optimizer::remove_marked() {
+   std::size_t kept = 0;
+   for (std::size_t i = 0; i < m_instructions.size(); i++) {
+      if (m_removed[i]) {
+         ++m_saved;
+         continue;
+      }
+      if (kept != i) {
+         m_instructions[kept] = std::move(m_instructions[i]);
+      }
+      ++kept;
+   }
+
+   const bool changed = kept != m_instructions.size();
+   m_instructions.erase(m_instructions.begin() + static_cast<std::ptrdiff_t>(kept),
+       m_instructions.end());
+   m_removed.assign(m_instructions.size(), false);
+   return changed;
+}
+
+// `@L1 0;JMP` where `L1` is followed by `@L2 0;JMP` becomes `@L2 0;JMP`. Either way the jump
+// lands on `L2` with A holding `L2` and nothing else changed. A conditional jump that isn't taken
+// leaves `L2` in A instead of `L1`, so it's only threaded when the code after it loads A first.
+bool Optimizer::thread_jumps() {
+   this->find_labels();
+
+   bool changed = false;
+   for (std::size_t i = 0; i + 1 < m_instructions.size(); i++) {
+      auto *load = std::get_if<AInstr>(&m_instructions[i]);
+      const auto *jump = std::get_if<CInstr>(&m_instructions[i + 1]);
+      if (!load || !jump || !std::holds_alternative<SymbolId>(load->value)
+          || !this->is_label(std::get<SymbolId>(load->value))) {
+         continue;
+      }
+
+      // A can't be used for anything besides where to jump to
+      const auto comp = computation(*jump, m_extended_isa);
+      if (!comp.has_value() || jump->jump == Jump::None || reads_y(comp->op)
+          || has_dest(*jump, isa::DEST_A | isa::DEST_M)) {
+         continue;
+      }
+      if (jump_kind(*jump, comp.value()) != JumpKind::Always
+          && reads_a_first(m_instructions, i + 2, m_instructions.size(), m_extended_isa)) {
+         continue;
+      }
+
+      const auto label = std::get<SymbolId>(load->value);
+      auto target = label;
+      for (std::size_t hop = 0; hop < max_jump_hops; hop++) {
+         const auto next = this->forwarded_label(target);
+         if (!next.has_value() || next.value() == target) {
+            break;
+         }
+         target = next.value();
+      }
+
+      if (target != label) {
+         load->value = target;
+         changed = true;
+      }
+   }
+   return changed;
+}
+
+// Code after an unconditional jump can only be reached through a label, anything before the next
+// label that's jumped to is removed. Jumps that are never taken are removed too.
+bool Optimizer::remove_unreachable() {
+   this->find_labels();
+
+   // the first load of a variable is kept so that variables are allocated in the same order
+   std::vector<bool> loaded(m_label_decls.size(), false);
+   bool changed = false;
+   bool reachable = true;
+   for (std::size_t i = 0; i < m_instructions.size(); i++) {
+      auto &inst_variant = m_instructions[i];
+      if (std::holds_alternative<Label>(inst_variant)) {
+         reachable = reachable || this->is_jump_target(i);
+         continue;
+      }
+
+      if (const auto *inst = std::get_if<AInstr>(&inst_variant)) {
+         bool first_variable_load = false;
+         if (std::holds_alternative<SymbolId>(inst->value)) {
+            const auto symbol = std::get<SymbolId>(inst->value);
+            const auto index = static_cast<std::size_t>(symbol);
+            first_variable_load = !loaded[index] && index >= PREDEFINED_SYMBOLS.size()
+                && !this->is_label(symbol);
+            loaded[index] = true;
+         }
+
+         m_removed[i] = !reachable && is_valid(*inst) && !first_variable_load;
+         continue;
+      }
+
+      auto &inst = std::get<CInstr>(inst_variant);
+      const auto comp = computation(inst, m_extended_isa);
+      if (!comp.has_value()) {
+         continue;
+      }
+      if (!reachable) {
+         m_removed[i] = true;
+         continue;
+      }
+
+      switch (jump_kind(inst, comp.value())) {
+      case JumpKind::Always:
+         reachable = false;
+         break;
+      case JumpKind::Never:
+         if (inst.jump == Jump::None) {
+            break;
+         }
+         if (inst.dest == Destination::None) {
+            m_removed[i] = true;
+         } else {
+            inst.jump = Jump::None;
+            changed = true;
+         }
+         break;
+      case JumpKind::Conditional:
+         break;
+      }
+   }
+
+   return this->remove_marked() || changed;
+}
+
+// `@0 D=A` becomes `D=0`, `@1 D=D+A` becomes `D=D+1` and so on, as long as A is loaded again before
+// anything reads it
+bool Optimizer::fold_constants() {
+   for (std::size_t i = 0; i + 1 < m_instructions.size(); i++) {
+      const auto *load = std::get_if<AInstr>(&m_instructions[i]);
+      auto *next = std::get_if<CInstr>(&m_instructions[i + 1]);
+      if (!load || !next || !is_valid(*load)) {
+         continue;
+      }
+
+      const auto value = loaded_value(*load);
+      const auto comp = computation(*next, m_extended_isa);
+      if (!std::holds_alternative<std::size_t>(value) || !comp.has_value()
+          || (comp->bits & comp_a_bit) || !reads_y(comp->op) || next->jump != Jump::None
+          || has_dest(*next, isa::DEST_M)) {
+         continue;
+      }
+
+      const bool next_is_load
+          = i + 2 < m_instructions.size() && std::holds_alternative<AInstr>(m_instructions[i + 2]);
+      if (!has_dest(*next, isa::DEST_A) && !next_is_load) {
+         continue;
+      }
+
+      auto folded = fold_comp(*next, comp->op, std::get<std::size_t>(value));
+      if (!folded.has_value()) {
+         continue;
+      }
+
+      m_removed[i] = true;
+      // `D=D` doesn't do anything
+      if (next->dest == Destination::D && comp_mnemonic(folded.value()) == "D") {
+         m_removed[i + 1] = true;
+      } else {
+         next->comp = std::move(folded.value());
+      }
+      ++i;
+   }
+
+   return this->remove_marked();
+}
+
+// removes the A-instructions loading what A already holds, which is forgotten at every label that
+// can be jumped to
+bool Optimizer::remove_reloads() {
+   this->find_labels();
+
+   std::optional<std::variant<std::size_t, SymbolId>> a_value { };
+   for (std::size_t i = 0; i < m_instructions.size(); i++) {
+      const auto &inst_variant = m_instructions[i];
+      if (std::holds_alternative<Label>(inst_variant)) {
+         if (this->is_jump_target(i)) {
+            a_value.reset();
+         }
+         continue;
+      }
+
+      if (const auto *inst = std::get_if<AInstr>(&inst_variant)) {
+         if (!is_valid(*inst)) {
+            a_value.reset();
+            continue;
+         }
+
+         const auto value = loaded_value(*inst);
+         if (a_value == value) {
+            m_removed[i] = true;
+         } else {
+            a_value = value;
+         }
+         continue;
+      }
+
+      const auto &inst = std::get<CInstr>(inst_variant);
+      const auto comp = computation(inst, m_extended_isa);
+      if (!comp.has_value() || has_dest(inst, isa::DEST_A)
+          || jump_kind(inst, comp.value()) == JumpKind::Always) {
+         a_value.reset();
+      }
+   }
+
+   return this->remove_marked();
+}
+
+// Blocks are chained to their most likely successor, going through the edges from most to least
+// likely as long as both ends are still free (Pettis and Hansen). Without a profile, falling
+// through counts for a bit more than a jump and conditional jumps are assumed not taken.
+bool Optimizer::lay_out_blocks(bool use_profile) {
+   this->find_labels();
+
+   // === split at labels ===
+   std::vector<Block> blocks { };
+   std::vector<std::size_t> block_of(m_instructions.size(), no_block);
+   std::size_t pc = 0;
+   for (std::size_t i = 0; i < m_instructions.size(); i++) {
+      const auto &inst_variant = m_instructions[i];
+      if (const auto *label = std::get_if<Label>(&inst_variant)) {
+         const auto symbol = static_cast<std::size_t>(label->value);
+         // the first declaration of a label would change if they were reordered
+         if (symbol >= PREDEFINED_SYMBOLS.size() && m_label_decls[symbol] != i) {
+            return false;
+         }
+         if (i == 0 || !std::holds_alternative<Label>(m_instructions[i - 1])) {
+            blocks.push_back({ .start = i });
+         }
+         if (symbol >= PREDEFINED_SYMBOLS.size() && !blocks.back().anchor.has_value()) {
+            blocks.back().anchor = label->value;
+         }
+      } else {
+         // errors are reported in the order they're found in, so nothing can move
+         const auto *load = std::get_if<AInstr>(&inst_variant);
+         const auto *inst = std::get_if<CInstr>(&inst_variant);
+         if ((load && !is_valid(*load)) || (inst && !computation(*inst, m_extended_isa))) {
+            return false;
+         }
+
+         if (blocks.empty()) {
+            blocks.push_back({ .start = i });
+         }
+         blocks.back().last = i;
+         blocks.back().last_pc = pc;
+         ++pc;
+      }
+      blocks.back().end = i + 1;
+      block_of[i] = blocks.size() - 1;
+   }
+
+   if (use_profile) {
+      if (m_executed.size() != pc || m_taken.size() != pc) {
+         return false;
+      }
+      m_profile_used = true;
+   }
+
+   // === how each block ends ===
+   for (auto &block : blocks) {
+      block.reads_a = reads_a_first(m_instructions, block.start, block.end, m_extended_isa);
+   }
+
+   for (std::size_t b = 0; b < blocks.size(); b++) {
+      auto &block = blocks[b];
+      if (block.last == no_instruction) {
+         continue;
+      }
+      const auto *jump = std::get_if<CInstr>(&m_instructions[block.last]);
+      if (!jump) {
+         continue;
+      }
+      const auto comp = computation(*jump, m_extended_isa).value();
+      block.jump = jump_kind(*jump, comp);
+      block.falls_through = block.jump != JumpKind::Always;
+
+      // A can't be used for anything besides where to jump to
+      const auto *load = block.last > block.start
+          ? std::get_if<AInstr>(&m_instructions[block.last - 1])
+          : nullptr;
+      if (block.jump == JumpKind::Never || !load || !std::holds_alternative<SymbolId>(load->value)
+          || !this->is_label(std::get<SymbolId>(load->value)) || reads_y(comp.op)
+          || has_dest(*jump, isa::DEST_A | isa::DEST_M)) {
+         continue;
+      }
+
+      // once the jump is gone the target is entered with A holding something else
+      const auto label = static_cast<std::size_t>(std::get<SymbolId>(load->value));
+      const auto target = block_of[m_label_decls[label]];
+      if (target != 0 && target != b && !blocks[target].reads_a) {
+         block.jump_target = target;
+      }
+   }
+
+   // the last block can't fall off the end of the program anymore once it's moved
+   if (blocks.empty() || blocks.back().falls_through) {
+      return false;
+   }
+
+   // === chain the blocks ===
+   // a block can only be jumped to instead of fallen into when that doesn't change A
+   const auto jumpable = [&](std::size_t b) {
+      return blocks[b].anchor.has_value() && !blocks[b].reads_a;
+   };
+
+   std::vector<Edge> edges { };
+   for (std::size_t b = 0; b < blocks.size(); b++) {
+      const auto &block = blocks[b];
+      std::uint64_t executed = 1;
+      std::uint64_t taken = block.jump == JumpKind::Always ? 1 : 0;
+      if (use_profile && block.last != no_instruction) {
+         executed = m_executed[block.last_pc];
+         taken = std::min(m_taken[block.last_pc], executed);
+      }
+
+      // falling through wins a tie, so blocks only move when it saves something
+      if (block.falls_through && b + 1 < blocks.size()) {
+         const auto weight = jumpable(b + 1) ? 2 * (executed - taken) + 1
+                                             : std::numeric_limits<std::uint64_t>::max();
+         edges.push_back({ .weight = weight, .from = b, .to = b + 1 });
+      }
+      if (block.jump_target != no_block) {
+         edges.push_back({ .weight = 2 * taken, .from = b, .to = block.jump_target });
+      }
+   }
+   std::stable_sort(edges.begin(), edges.end(),
+       [](const Edge &lhs, const Edge &rhs) { return lhs.weight > rhs.weight; });
+
+   std::vector<std::size_t> next(blocks.size(), no_block);
+   std::vector<std::size_t> prev(blocks.size(), no_block);
+   std::vector<std::size_t> chains(blocks.size());
+   for (std::size_t b = 0; b < blocks.size(); b++) {
+      chains[b] = b;
+   }
+   const auto find_chain = [&](std::size_t b) {
+      while (chains[b] != b) {
+         chains[b] = chains[chains[b]];
+         b = chains[b];
+      }
+      return b;
+   };
+
+   for (const auto &edge : edges) {
+      const auto from_chain = find_chain(edge.from);
+      const auto to_chain = find_chain(edge.to);
+      if (next[edge.from] == no_block && prev[edge.to] == no_block && from_chain != to_chain) {
+         next[edge.from] = edge.to;
+         prev[edge.to] = edge.from;
+         chains[to_chain] = from_chain;
+      }
+   }
+
+   // nothing jumps into the first block, so its chain is still the first one
+   std::vector<std::size_t> order { };
+   order.reserve(blocks.size());
+   for (std::size_t b = 0; b < blocks.size(); b++) {
+      for (auto chained = prev[b] == no_block ? b : no_block; chained != no_block;
+           chained = next[chained]) {
+         order.push_back(chained);
+      }
+   }
+
+   bool moved = false;
+   for (std::size_t i = 0; i < order.size(); i++) {
+      moved = moved || order[i] != i;
+   }
+   if (!moved) {
+      return false;
+   }
+
+   // variables are allocated in the order they're first loaded in, which has to stay the same
+   const auto variables = [&](auto block_at) {
+      std::vector<bool> loaded(m_label_decls.size(), false);
+      std::vector<SymbolId> variables { };
+      for (std::size_t b = 0; b < blocks.size(); b++) {
+         for (auto i = blocks[block_at(b)].start; i < blocks[block_at(b)].end; i++) {
+            const auto *load = std::get_if<AInstr>(&m_instructions[i]);
+            if (!load || !std::holds_alternative<SymbolId>(load->value)) {
+               continue;
+            }
+            const auto symbol = std::get<SymbolId>(load->value);
+            const auto index = static_cast<std::size_t>(symbol);
+            if (!loaded[index] && index >= PREDEFINED_SYMBOLS.size() && !this->is_label(symbol)) {
+               loaded[index] = true;
+               variables.push_back(symbol);
+            }
+         }
+      }
+      return variables;
+   };
+   if (variables([](std::size_t b) { return b; })
+       != variables([&](std::size_t b) { return order[b]; })) {
+      return false;
+   }
+
+   // === move the blocks and fix up their ends ===
+   std::vector<Instruction> laid_out { };
+   laid_out.reserve(m_instructions.size());
+   for (std::size_t i = 0; i < order.size(); i++) {
+      const auto &block = blocks[order[i]];
+      const auto following = i + 1 < order.size() ? order[i + 1] : no_block;
+      const auto fallen_into = order[i] + 1;
+      const auto begin = m_instructions.begin();
+      laid_out.insert(laid_out.end(), begin + static_cast<std::ptrdiff_t>(block.start),
+          begin + static_cast<std::ptrdiff_t>(block.end));
+
+      if (block.jump_target != no_block && following == block.jump_target) {
+         auto &load = std::get<AInstr>(laid_out[laid_out.size() - 2]);
+         auto &jump = std::get<CInstr>(laid_out.back());
+         if (block.jump == JumpKind::Conditional) {
+            // jumps where it used to fall into instead
+            load.value = blocks[fallen_into].anchor.value();
+            jump.jump = static_cast<Jump>(
+                static_cast<std::uint8_t>(jump.jump) ^ static_cast<std::uint8_t>(Jump::JMP));
+         } else if (jump.dest == Destination::None) {
+            laid_out.erase(laid_out.end() - 2, laid_out.end());
+            m_saved += 2;
+         } else {
+            jump.jump = Jump::None;
+            laid_out.erase(laid_out.end() - 2);
+            ++m_saved;
+         }
+      } else if (block.falls_through && following != fallen_into) {
+         const auto anchor = blocks[fallen_into].anchor.value();
+         const auto &label
+             = std::get<Label>(m_instructions[m_label_decls[static_cast<std::size_t>(anchor)]]);
+         const auto zero = UnaryComp {
+            .start = label.start_coord,
+            .end = label.end_coord,
+            .op = Operator::None,
+            .operand = std::size_t { 0 },
+         };
+         laid_out.emplace_back(AInstr {
+             .start_coord = label.start_coord,
+             .end_coord = label.end_coord,
+             .value = anchor,
+         });
+         laid_out.emplace_back(CInstr {
+             .start = label.start_coord,
+             .end = label.end_coord,
+             .dest = Destination::None,
+             .comp = zero,
+             .jump = Jump::JMP,
+         });
+         m_saved -= 2;
+      }
+   }
+
+   m_instructions = std::move(laid_out);
+   m_removed.assign(m_instructions.size(), false);
+   return true;
+}
+
+void Optimizer::simplify() {
+   for (std::size_t round = 0; round < max_rounds; round++) {
+      // every pass goes through all of the instructions, so they're all run even after a change
+      bool changed = this->thread_jumps();
+      changed = this->remove_unreachable() || changed;
+      changed = this->fold_constants() || changed;
+      changed = this->remove_reloads() || changed;
+      if (!changed) {
+         break;
+      }
+   }
+}
+
+std::vector<Instruction> Optimizer::optimize() {
+   // the address would point somewhere else once anything before it moves
+   this->find_labels();
+   if (this->jumps_to_address()) {
+      return std::move(m_instructions);
+   }
+
+   m_removed.assign(m_instructions.size(), false);
+   this->simplify();
+   if (this->lay_out_blocks(false)) {
+      this->simplify();
+   }
+
+   // profiles are recorded from the program as laid out above, their PCs only match from here on
+   if (!m_executed.empty() && this->lay_out_blocks(true)) {
+      this->simplify();
+   }
+   return std::move(m_instructions);
+}
+
+}; // namespace assembly
@@ -0,0 +1,314 @@
+#include "../report/report.hpp"
+#include "asm.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <thread>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace assembly {
+
+// below this much source per thread, starting the threads costs more than they save
+constexpr std::size_t min_chunk_size = 64 * 1024;
+
+namespace {
+
+// a part of the source lexed and parsed on its own, ids are local to its symbol table
+struct Chunk {
+   std::string_view contents { };
+   SymbolTable symbols { };
+   std::vector<Instruction> instructions { };
+   std::size_t token_count { 0 };
+   // number of instructions, not counting labels
+   std::size_t size { 0 };
+   // labels declared in the chunk and the pc they're at, relative to the start of the chunk
+   std::vector<std::pair<SymbolId, std::size_t>> labels { };
+   // symbols loaded by A-instructions, in the order they're first loaded
+   std::vector<SymbolId> first_loads { };
+   // id in the merged symbol table of each of the chunk's ids
+   std::vector<SymbolId> global_ids { };
+   // index of the chunk's first instruction in the output
+   std::size_t offset { 0 };
+   // newlines in the chunk, and the row it starts at in the whole source
+   std::size_t rows { 0 };
+   std::size_t first_row { 0 };
+   // errors (or anything else going wrong) are left for the serial assembler to report
+   bool failed { false };
+};
+
+}; // namespace
+
+// runs `func` on every chunk, each on its own thread except for the first which is run on the
+// calling one
+template <typename Func> static void for_each_chunk(std::vector<Chunk> &chunks, Func func) {
+   std::vector<std::jthread> workers { };
+   workers.reserve(chunks.size() - 1);
+   for (std::size_t i = 1; i < chunks.size(); i++) {
+      workers.emplace_back([&chunk = chunks[i], &func] { func(chunk); });
+   }
+   func(chunks[0]);
+}
+
+static void parse_chunk(Chunk &chunk, const std::filesystem::path &name) {
+   chunk.rows = static_cast<std::size_t>(
+       std::count(chunk.contents.begin(), chunk.contents.end(), '\n'));
+
+   const report::SourceFile source { chunk.contents, name };
+   Lexer lexer { source };
+   const auto tokens = lexer.tokenize();
+   chunk.token_count = tokens.size();
+
+   Parser parser { tokens, source };
+   auto instructions = parser.parse();
+   if (!instructions.has_value()) {
+      chunk.failed = true;
+      return;
+   }
+   chunk.instructions = std::move(instructions.value());
+   chunk.symbols = std::move(lexer.symbols());
+
+   std::vector<bool> loaded(chunk.symbols.size(), false);
+   for (const auto &inst_variant : chunk.instructions) {
+      if (std::holds_alternative<Label>(inst_variant)) {
+         chunk.labels.emplace_back(std::get<Label>(inst_variant).value, chunk.size);
+         continue;
+      }
+
+      if (std::holds_alternative<AInstr>(inst_variant)) {
+         const auto &value = std::get<AInstr>(inst_variant).value;
+         if (std::holds_alternative<SymbolId>(value)) {
+            const auto symbol = std::get<SymbolId>(value);
+            if (!loaded[static_cast<std::size_t>(symbol)]) {
+               loaded[static_cast<std::size_t>(symbol)] = true;
+               chunk.first_loads.push_back(symbol);
+            }
+         }
+      }
+      ++chunk.size;
+   }
+}
+
+static void encode_chunk(Chunk &chunk, const report::SourceFile &whole_source,
+    const std::vector<std::int32_t> &symbol_addrs, bool extended_isa,
+    std::vector<std::uint16_t> &output, std::vector<SourceLocation> &locations) {
+   const report::SourceFile source { chunk.contents, whole_source.path() };
+   report::Context reporter { source };
+   const auto first_row = whole_source.first_row() + chunk.first_row;
+
+   auto pc = chunk.offset;
+   for (const auto &inst_variant : chunk.instructions) {
+      if (std::holds_alternative<Label>(inst_variant)) {
+         continue;
+      }
+
+      std::optional<std::uint16_t> binary { };
+      if (std::holds_alternative<AInstr>(inst_variant)) {
+         const auto &inst = std::get<AInstr>(inst_variant);
+         locations[pc] = source_location(inst.start_coord, first_row);
+         if (std::holds_alternative<std::size_t>(inst.value)) {
+            binary = compile_ainstr_constant(inst, reporter);
+         } else {
+            const auto local = static_cast<std::size_t>(std::get<SymbolId>(inst.value));
+            const auto symbol = static_cast<std::size_t>(chunk.global_ids[local]);
+            binary = 0b0111111111111111 & symbol_addrs[symbol];
+         }
+      } else {
+         const auto &inst = std::get<CInstr>(inst_variant);
+         locations[pc] = source_location(inst.start, first_row);
+         binary = compile_cinstr(inst, reporter, extended_isa);
+      }
+
+      if (!binary.has_value()) {
+         chunk.failed = true;
+         return;
+      }
+      output[pc] = binary.value();
+      ++pc;
+   }
+}
+
+ParallelAssembler::ParallelAssembler(const report::SourceFile &source, std::size_t threads)
+    : m_source { source }
+    , m_threads { std::max<std::size_t>(threads, 1) } { }
+
+void ParallelAssembler::set_extended_isa(bool enabled) { m_extended_isa = enabled; }
+
+void ParallelAssembler::set_optimize(bool enabled) { m_optimize = enabled; }
+
+void ParallelAssembler::set_profile(
+    std::span<const std::uint64_t> executed, std::span<const std::uint64_t> taken) {
+   m_executed = executed;
+   m_taken = taken;
+}
+
+std::string ParallelAssembler::get_error_report() { return m_error_report; }
+
+const Labels &ParallelAssembler::get_labels() const { return m_labels; }
+
+const SourceMap &ParallelAssembler::get_source_map() const { return m_source_map; }
+
+std::ptrdiff_t ParallelAssembler::optimized_away() const { return m_optimized_away; }
+
+bool ParallelAssembler::profile_used() const { return m_profile_used; }
+
+std::optional<std::vector<std::uint16_t>> ParallelAssembler::assemble_serially() {
+   Lexer lexer { m_source };
+   auto tokens = lexer.tokenize();
+   if (tokens.empty()) {
+      m_error_report = std::format(
+          "Failed to tokenize `{}`. File is possibly not a valid assembly file.\n",
+          m_source.path().string());
+      return std::nullopt;
+   }
+
+   Parser parser { tokens, m_source };
+   auto instructions = parser.parse();
+   if (!instructions.has_value()) {
+      m_error_report = parser.get_error_report();
+      return std::nullopt;
+   }
+
+   if (m_optimize) {
+      Optimizer optimizer { std::move(instructions.value()) };
+      optimizer.set_extended_isa(m_extended_isa);
+      optimizer.set_profile(m_executed, m_taken);
+      instructions = optimizer.optimize();
+      m_optimized_away = optimizer.saved();
+      m_profile_used = optimizer.profile_used();
+   }
+
+   CodeGen codegen { std::move(instructions.value()), std::move(lexer.symbols()), m_source };
+   codegen.set_extended_isa(m_extended_isa);
+   auto output = codegen.compile();
+   if (!output.has_value()) {
+      m_error_report = codegen.get_error_report();
+      return std::nullopt;
+   }
+
+   m_labels = codegen.get_labels();
+   m_source_map = codegen.get_source_map();
+   return output;
+}
+
+std::optional<std::vector<std::uint16_t>> ParallelAssembler::assemble() {
+   m_labels.clear();
+   m_source_map = { };
+   m_error_report.clear();
+   m_optimized_away = 0;
+   m_profile_used = false;
+
+   const auto contents = m_source.contents();
+   const auto chunk_count = std::min(m_threads, contents.size() / min_chunk_size);
+   if (chunk_count <= 1 || m_optimize) {
+      return this->assemble_serially();
+   }
+
+   // === split at line boundaries ===
+   std::vector<Chunk> chunks { };
+   chunks.reserve(chunk_count);
+   std::size_t chunk_start = 0;
+   for (std::size_t i = 1; i <= chunk_count && chunk_start < contents.size(); i++) {
+      auto chunk_end = contents.size();
+      if (i < chunk_count) {
+         const auto newline
+             = contents.find('\n', std::max(chunk_start, contents.size() * i / chunk_count));
+         chunk_end = newline == std::string_view::npos ? contents.size() : newline + 1;
+      }
+
+      chunks.emplace_back().contents = contents.substr(chunk_start, chunk_end - chunk_start);
+      chunk_start = chunk_end;
+   }
+
+   // === lex and parse ===
+   for_each_chunk(chunks, [&](Chunk &chunk) {
+      // the parser can throw on malformed input, the serial assembler rethrows it on this thread
+      try {
+         parse_chunk(chunk, m_source.path());
+      } catch (...) {
+         chunk.failed = true;
+      }
+   });
+
+   const auto failed = [](const Chunk &chunk) { return chunk.failed; };
+   const auto no_tokens = [](const Chunk &chunk) { return chunk.token_count == 0; };
+   if (std::any_of(chunks.begin(), chunks.end(), failed)
+       || std::all_of(chunks.begin(), chunks.end(), no_tokens)) {
+      return this->assemble_serially();
+   }
+
+   // === merge symbols and resolve them, in the same order `CodeGen` does ===
+   SymbolTable symbols { };
+   std::size_t total_size = 0;
+   std::size_t total_rows = 0;
+   for (auto &chunk : chunks) {
+      chunk.global_ids.resize(chunk.symbols.size());
+      for (std::size_t id = 0; id < chunk.symbols.size(); id++) {
+         // every table starts out with the predefined symbols under the same ids
+         chunk.global_ids[id] = id < PREDEFINED_SYMBOLS.size()
+             ? static_cast<SymbolId>(id)
+             : symbols.intern(chunk.symbols.name(static_cast<SymbolId>(id)));
+      }
+
+      chunk.offset = total_size;
+      total_size += chunk.size;
+      chunk.first_row = total_rows;
+      total_rows += chunk.rows;
+   }
+
+   constexpr std::int32_t unresolved = -1;
+   std::vector<std::int32_t> symbol_addrs(symbols.size(), unresolved);
+   for (std::size_t i = 0; i < PREDEFINED_SYMBOLS.size(); i++) {
+      symbol_addrs[i] = PREDEFINED_SYMBOLS[i].address;
+   }
+
+   std::vector<std::pair<std::string, std::uint16_t>> declared_labels { };
+   for (const auto &chunk : chunks) {
+      for (const auto &[local, pc] : chunk.labels) {
+         const auto symbol = chunk.global_ids[static_cast<std::size_t>(local)];
+         // the pc wraps around just like `CodeGen`'s
+         const auto label_pc = static_cast<std::uint16_t>(chunk.offset + pc);
+         // the first declaration wins and predefined symbols can't be redeclared
+         auto &label_addr = symbol_addrs[static_cast<std::size_t>(symbol)];
+         if (label_addr == unresolved) {
+            label_addr = label_pc;
+         }
+         m_labels.emplace(symbols.name(symbol), label_pc);
+         declared_labels.emplace_back(symbols.name(symbol), label_pc);
+      }
+   }
+
+   // whatever is still unresolved is a variable, allocated in the order of first use
+   auto var_addr = VAR_START_ADDRESS;
+   std::vector<std::string> variables { };
+   for (const auto &chunk : chunks) {
+      for (const auto local : chunk.first_loads) {
+         const auto symbol = chunk.global_ids[static_cast<std::size_t>(local)];
+         auto &value_addr = symbol_addrs[static_cast<std::size_t>(symbol)];
+         if (value_addr == unresolved) {
+            value_addr = var_addr;
+            ++var_addr;
+            variables.emplace_back(symbols.name(symbol));
+         }
+      }
+   }
+
+   // === encode ===
+   std::vector<std::uint16_t> output(total_size);
+   std::vector<SourceLocation> locations(total_size);
+   for_each_chunk(chunks, [&](Chunk &chunk) {
+      encode_chunk(chunk, m_source, symbol_addrs, m_extended_isa, output, locations);
+   });
+
+   if (std::any_of(chunks.begin(), chunks.end(), failed)) {
+      m_labels.clear();
+      return this->assemble_serially();
+   }
+
+   m_source_map = SourceMap { { m_source.path() }, std::move(locations), std::move(declared_labels),
+      std::move(variables) };
+   return output;
+}
+
+}; // namespace assembly
@@ -1,12 +1,93 @@
 #include "asm.hpp"
+#include <array>
 #include <cctype>
 #include <format>
 #include <optional>
 #include <string>
+#include <utility>
 #include <variant>
 
 namespace assembly {
 
+// Perfect hash of the destination mnemonics: A, D and M get 2 bits each, so every name made of up
+// to 3 of them has its own slot. Anything else hashes to 0, which holds `Destination::None`.
+static constexpr std::size_t dest_hash(std::string_view name) {
+   if (name.empty() || name.size() > 3) {
+      return 0;
+   }
+
+   std::size_t hash = 0;
+   for (std::size_t i = 0; i < name.size(); i++) {
+      std::size_t code = 0;
+      switch (name[i]) {
+      case 'A':
+         code = 1;
+         break;
+      case 'D':
+         code = 2;
+         break;
+      case 'M':
+         code = 3;
+         break;
+      default:
+         return 0;
+      }
+      hash |= code << (i * 2);
+   }
+
+   return hash;
+}
+
+constexpr auto DEST_TABLE = [] {
+   std::array<Destination, 64> table { };
+   for (std::size_t bits = 1; bits < isa::DESTINATIONS.size(); bits++) {
+      table[dest_hash(isa::DESTINATIONS[bits])] = static_cast<Destination>(bits);
+   }
+   return table;
+}();
+
+// Perfect hash of the (case insensitive) jump mnemonics, the last two letters are enough to tell
+// them apart and this happens to spread them over 8 slots without collisions.
+static constexpr std::size_t jump_hash(std::string_view name) {
+   return ((name[1] | 0x20) * 7 + (name[2] | 0x20)) & 0b111;
+}
+
+struct JumpEntry {
+   std::string_view name;
+   Jump jump;
+};
+
+constexpr auto JUMP_TABLE = [] {
+   std::array<JumpEntry, 8> table { };
+   for (std::size_t bits = 1; bits < isa::JUMPS.size(); bits++) {
+      const JumpEntry entry { isa::JUMPS[bits], static_cast<Jump>(bits) };
+      if (table[jump_hash(entry.name)].jump != Jump::None) {
+         throw "jump mnemonics collide, the hash has to be changed";
+      }
+      table[jump_hash(entry.name)] = entry;
+   }
+   return table;
+}();
+
+static Jump find_jump(std::string_view name) {
+   if (name.size() != 3) {
+      return Jump::None;
+   }
+
+   const auto &entry = JUMP_TABLE[jump_hash(name)];
+   if (entry.jump == Jump::None) {
+      return Jump::None;
+   }
+
+   for (std::size_t i = 0; i < name.size(); i++) {
+      if ((name[i] | 0x20) != (entry.name[i] | 0x20)) {
+         return Jump::None;
+      }
+   }
+
+   return entry.jump;
+}
+
 std::string get_stringified_token(decltype(Token::value) token) {
    if (std::holds_alternative<int>(token)) {
       return std::string(1, std::get<int>(token));
@@ -16,11 +97,11 @@ std::string get_stringified_token(decltype(Token::value) token) {
       return std::to_string(std::get<std::size_t>(token));
    }
 
-   return std::get<std::string>(token);
+   return std::string(std::get<Symbol>(token).name);
 }
 
 std::optional<Label> Parser::parse_label() {
-   auto curr_token = this->curr_token();
+   const auto &curr_token = this->curr_token();
    if (curr_token.type != TokenType::OpenParen) {
       this->emit_error(curr_token,
           std::format("Expected '(', found '{}'", get_stringified_token(curr_token.value)));
@@ -43,16 +124,16 @@ std::optional<Label> Parser::parse_label() {
    this->eat();
 
    Label label { };
-   if (label_option.has_value()) {
-      auto label_token = label_option.value();
-      if (!std::holds_alternative<std::string>(label_token.value)) {
+   if (label_option) {
+      const auto &label_token = *label_option;
+      if (!std::holds_alternative<Symbol>(label_token.value)) {
          this->emit_error(label_token,
              std::format("Expected label to be a valid string but instead found '{}'",
                  get_stringified_token(label_token.value)));
          return std::nullopt;
       }
 
-      label.value = std::get<std::string>(label_token.value);
+      label.value = std::get<Symbol>(label_token.value).id;
       label.start_coord = curr_token.start_coord;
       label.end_coord = label_token.end_coord;
    }
@@ -61,7 +142,7 @@ std::optional<Label> Parser::parse_label() {
 }
 
 std::optional<Destination> Parser::parse_dest() {
-   auto curr_token = this->curr_token();
+   const auto &curr_token = this->curr_token();
    auto dest = Destination::None;
 
    // valid destinations:
@@ -69,25 +150,11 @@ std::optional<Destination> Parser::parse_dest() {
    // - D
    // - M, MD
 
-   if (curr_token.type == TokenType::Label
-       && std::holds_alternative<std::string>(curr_token.value)) {
-      auto token_value = std::get<std::string>(curr_token.value);
-
-      if (token_value == "A") {
-         dest = Destination::A;
-      } else if (token_value == "AM") {
-         dest = Destination::AM;
-      } else if (token_value == "AD") {
-         dest = Destination::AD;
-      } else if (token_value == "AMD") {
-         dest = Destination::AMD;
-      } else if (token_value == "D") {
-         dest = Destination::D;
-      } else if (token_value == "M") {
-         dest = Destination::M;
-      } else if (token_value == "MD") {
-         dest = Destination::MD;
-      } else {
+   if (curr_token.type == TokenType::Label && std::holds_alternative<Symbol>(curr_token.value)) {
+      auto token_value = std::get<Symbol>(curr_token.value).name;
+
+      dest = DEST_TABLE[dest_hash(token_value)];
+      if (dest == Destination::None) {
          this->emit_error(curr_token,
              std::format("Invalid destination. Expected A, M, D, AM, "
                          "AD, AMD, M, or MD. But found `{}`",
@@ -106,7 +173,7 @@ std::optional<Destination> Parser::parse_dest() {
 }
 
 std::optional<std::variant<UnaryComp, BinaryComp>> Parser::parse_comp() {
-   auto curr_token = this->curr_token();
+   const auto &curr_token = this->curr_token();
 
    // unary
 
@@ -115,17 +182,20 @@ std::optional<std::variant<UnaryComp, BinaryComp>> Parser::parse_comp() {
    unary_comp.op = Operator::None;
 
    auto parse_single_dest
-       = [this](const Token curr, TokenCoordinate &token_end) -> std::optional<Address> {
-      if (std::holds_alternative<std::string>(curr.value)) {
-         auto curr_value = std::get<std::string>(curr.value);
+       = [this](const Token &curr, TokenCoordinate &token_end) -> std::optional<Address> {
+      if (std::holds_alternative<Symbol>(curr.value)) {
+         auto curr_value = std::get<Symbol>(curr.value).name;
          token_end = curr.end_coord;
 
-         if (curr_value == "D") {
-            return Address::D;
-         } else if (curr_value == "A") {
-            return Address::A;
-         } else if (curr_value == "M") {
-            return Address::M;
+         if (curr_value.size() == 1) {
+            switch (curr_value[0]) {
+            case 'D':
+               return Address::D;
+            case 'A':
+               return Address::A;
+            case 'M':
+               return Address::M;
+            }
          }
       }
 
@@ -141,7 +211,7 @@ std::optional<std::variant<UnaryComp, BinaryComp>> Parser::parse_comp() {
       unary_comp.op = Operator::Not;
 
       if (this->peek_expected(TokenType::Label)) {
-         auto curr = this->eat().value();
+         const auto &curr = *this->eat();
          auto dest = parse_single_dest(curr, unary_comp.end);
          if (dest.has_value()) {
             unary_comp.operand = dest.value();
@@ -149,7 +219,7 @@ std::optional<std::variant<UnaryComp, BinaryComp>> Parser::parse_comp() {
             return std::nullopt;
          }
       } else {
-         auto curr = this->peek();
+         const auto &curr = this->peek();
          this->emit_error(curr,
              std::format("Expected one of the valid addresses (A, M, D), but found `{}`",
                  get_stringified_token(curr.value)));
@@ -162,7 +232,7 @@ std::optional<std::variant<UnaryComp, BinaryComp>> Parser::parse_comp() {
       unary_comp.op = Operator::Neg;
 
       if (this->peek_expected(TokenType::Label)) {
-         auto curr = this->eat().value();
+         const auto &curr = *this->eat();
          auto dest = parse_single_dest(curr, unary_comp.end);
          if (dest.has_value()) {
             unary_comp.operand = dest.value();
@@ -170,7 +240,7 @@ std::optional<std::variant<UnaryComp, BinaryComp>> Parser::parse_comp() {
             return std::nullopt;
          }
       } else if (this->peek_expected(TokenType::Number)) {
-         auto curr = this->eat().value();
+         const auto &curr = *this->eat();
          unary_comp.end = curr.end_coord;
          if (std::holds_alternative<std::size_t>(curr.value)) {
             auto num = std::get<std::size_t>(curr.value);
@@ -220,7 +290,8 @@ std::optional<std::variant<UnaryComp, BinaryComp>> Parser::parse_comp() {
    }
 
    if (!this->peek_expected(TokenType::Plus) && !this->peek_expected(TokenType::Minus)
-       && !this->peek_expected(TokenType::Ampersand) && !this->peek_expected(TokenType::Pipe)) {
+       && !this->peek_expected(TokenType::Ampersand) && !this->peek_expected(TokenType::Pipe)
+       && !this->peek_expected(TokenType::Star)) {
       return unary_comp;
    }
 
@@ -229,6 +300,7 @@ std::optional<std::variant<UnaryComp, BinaryComp>> Parser::parse_comp() {
    // D+A, D-A, D&A, D|A
    // A-D, M-D,
    // D+M, D-M, D&M, D|M
+   // D*A, D*M (extended ISA)
 
    if (!std::holds_alternative<Address>(unary_comp.operand)) {
       this->emit_error(curr_token,
@@ -242,8 +314,8 @@ std::optional<std::variant<UnaryComp, BinaryComp>> Parser::parse_comp() {
    binary_comp.left = std::get<Address>(unary_comp.operand);
    binary_comp.right = Address::None;
 
-   auto next_token = this->peek();
-   switch (next_token.type) {
+   const auto &op_token = this->peek();
+   switch (op_token.type) {
    case TokenType::Plus:
       binary_comp.op = Operator::Add;
       break;
@@ -256,33 +328,35 @@ std::optional<std::variant<UnaryComp, BinaryComp>> Parser::parse_comp() {
    case TokenType::Ampersand:
       binary_comp.op = Operator::And;
       break;
+   case TokenType::Star:
+      binary_comp.op = Operator::Mul;
+      break;
    default:
-      this->emit_error(next_token,
+      this->emit_error(op_token,
           std::format("Expected one of the valid operators (+, -, | and &), found `{}`",
-              get_stringified_token(next_token.value)));
+              get_stringified_token(op_token.value)));
       return std::nullopt;
    }
-   curr_token = this->eat().value();
+   this->eat();
 
    if (this->peek_expected(TokenType::Number)) {
-      curr_token = this->eat().value();
-      if (std::holds_alternative<std::size_t>(curr_token.value)) {
-         auto num = std::get<std::size_t>(curr_token.value);
+      const auto &curr = *this->eat();
+      if (std::holds_alternative<std::size_t>(curr.value)) {
+         auto num = std::get<std::size_t>(curr.value);
          if (num != 1) {
-            this->emit_error(curr_token,
-                std::format(
-                    "Expected `1` but found `{}`", get_stringified_token(curr_token.value)));
+            this->emit_error(curr,
+                std::format("Expected `1` but found `{}`", get_stringified_token(curr.value)));
             return std::nullopt;
          }
          binary_comp.right = num;
       } else {
-         this->emit_error(curr_token,
+         this->emit_error(curr,
              std::format(
-                 "Expected a valid number, found `{}`", get_stringified_token(curr_token.value)));
+                 "Expected a valid number, found `{}`", get_stringified_token(curr.value)));
          return std::nullopt;
       }
    } else if (this->peek_expected(TokenType::Label)) {
-      auto curr = this->eat().value();
+      const auto &curr = *this->eat();
       auto dest = parse_single_dest(curr, binary_comp.end);
       if (dest.has_value()) {
          binary_comp.right = dest.value();
@@ -290,7 +364,7 @@ std::optional<std::variant<UnaryComp, BinaryComp>> Parser::parse_comp() {
          return std::nullopt;
       }
    } else {
-      next_token = this->peek();
+      const auto &next_token = this->peek();
       this->emit_error(next_token,
           std::format("Expected a valid right hand side (A, D, M or 1) but found `{}`",
               get_stringified_token(next_token.value)));
@@ -302,7 +376,7 @@ std::optional<std::variant<UnaryComp, BinaryComp>> Parser::parse_comp() {
 }
 
 std::optional<Jump> Parser::parse_jump() {
-   auto curr_token = this->curr_token();
+   const auto &curr_token = this->curr_token();
    if (curr_token.type != TokenType::Label) {
       this->emit_error(curr_token,
           std::format("expected a jump instruction but found `{}`",
@@ -310,30 +384,15 @@ std::optional<Jump> Parser::parse_jump() {
       return std::nullopt;
    }
 
-   auto label = std::get<std::string>(curr_token.value);
-   for (auto &c : label) {
-      c = std::toupper(c);
-   }
-
-   auto jump = Jump::None;
-
-   if (label == "JGT") {
-      jump = Jump::JGT;
-   } else if (label == "JEQ") {
-      jump = Jump::JEQ;
-   } else if (label == "JLT") {
-      jump = Jump::JLT;
-   } else if (label == "JGE") {
-      jump = Jump::JGE;
-   } else if (label == "JNE") {
-      jump = Jump::JNE;
-   } else if (label == "JLE") {
-      jump = Jump::JLE;
-   } else if (label == "JMP") {
-      jump = Jump::JMP;
-   }
+   const auto name = std::get<Symbol>(curr_token.value).name;
+   const auto jump = find_jump(name);
 
    if (jump == Jump::None) {
+      std::string label { name };
+      for (auto &c : label) {
+         c = std::toupper(c);
+      }
+
       this->emit_error(curr_token,
           std::format("Found invalid jump instruction `{}`, expected "
                       "one of: JGT, JEQ, JLT, JGE, JNE, JMP",
@@ -345,7 +404,7 @@ std::optional<Jump> Parser::parse_jump() {
 }
 
 std::optional<CInstr> Parser::parse_cinstr() {
-   auto curr_token = this->curr_token();
+   const auto &curr_token = this->curr_token();
    CInstr cinstr { };
    cinstr.start = curr_token.start_coord;
 
@@ -365,7 +424,7 @@ std::optional<CInstr> Parser::parse_cinstr() {
       if (dest.has_value()) {
          cinstr.dest = dest.value();
          if (!this->peek_expected(TokenType::Equal)) {
-            auto next_token = this->peek();
+            const auto &next_token = this->peek();
             this->emit_error(next_token,
                 std::format("Expected a `=`, found `{}`", get_stringified_token(next_token.value)));
             return std::nullopt;
@@ -385,9 +444,9 @@ std::optional<CInstr> Parser::parse_cinstr() {
 
    auto comp = this->parse_comp();
    if (comp.has_value()) {
-      cinstr.comp = comp.value();
+      cinstr.comp = std::move(comp.value());
    } else {
-      auto curr = this->curr_token();
+      const auto &curr = this->curr_token();
       this->emit_error(curr, "Expected a valid computation such as 0, 1 or A+1");
       return std::nullopt;
    }
@@ -396,7 +455,7 @@ std::optional<CInstr> Parser::parse_cinstr() {
    if (this->peek_expected(TokenType::Semicolon)) {
       this->eat();
       this->eat();
-      auto curr = this->curr_token();
+      const auto &curr = this->curr_token();
       auto jump_opt = this->parse_jump();
       if (!jump_opt.has_value()) {
          this->emit_error(curr, "Expected a valid jump instruction");
@@ -411,7 +470,7 @@ std::optional<CInstr> Parser::parse_cinstr() {
 }
 
 std::optional<AInstr> Parser::parse_ainstr() {
-   auto curr_token = this->curr_token();
+   const auto &curr_token = this->curr_token();
    if (curr_token.type != TokenType::AtSymbol) {
       this->emit_error(curr_token,
           std::format("Expected `@`, found `{}`", get_stringified_token(curr_token.value)));
@@ -419,19 +478,19 @@ std::optional<AInstr> Parser::parse_ainstr() {
    }
 
    if (!this->peek_expected(TokenType::Label) && !this->peek_expected(TokenType::Number)) {
-      auto next_token = this->peek();
+      const auto &next_token = this->peek();
       this->emit_error(next_token,
           std::format("Expected `@`, found `{}`", get_stringified_token(next_token.value)));
       return std::nullopt;
    }
-   auto inst_value = this->eat().value();
+   const auto &inst_value = *this->eat();
 
    AInstr ainstr { };
    ainstr.start_coord = curr_token.start_coord;
    ainstr.end_coord = inst_value.end_coord;
 
-   if (std::holds_alternative<std::string>(inst_value.value)) {
-      ainstr.value = std::get<std::string>(inst_value.value);
+   if (std::holds_alternative<Symbol>(inst_value.value)) {
+      ainstr.value = std::get<Symbol>(inst_value.value).id;
    } else if (std::holds_alternative<std::size_t>(inst_value.value)) {
       ainstr.value = std::get<std::size_t>(inst_value.value);
    }
@@ -444,8 +503,11 @@ std::optional<std::vector<Instruction>> Parser::parse() {
    std::optional<AInstr> ainstr { std::nullopt };
    std::optional<CInstr> cinstr { std::nullopt };
 
+   // most instructions take at least 3 tokens counting the newline after them
+   m_instructions.reserve(m_tokens.size() / 3);
+
    while (!this->eof()) {
-      auto token = this->curr_token();
+      const auto &token = this->curr_token();
       if (token.type == TokenType::Newline) {
          this->eat();
          continue;
@@ -455,28 +517,28 @@ std::optional<std::vector<Instruction>> Parser::parse() {
       case TokenType::OpenParen:
          label = this->parse_label();
          if (label.has_value()) {
-            m_instructions.push_back(label.value());
+            m_instructions.push_back(std::move(label.value()));
          }
          break;
 
       case TokenType::AtSymbol:
          ainstr = this->parse_ainstr();
          if (ainstr.has_value()) {
-            m_instructions.push_back(ainstr.value());
+            m_instructions.push_back(std::move(ainstr.value()));
          }
          break;
 
       default:
          cinstr = this->parse_cinstr();
          if (cinstr.has_value()) {
-            m_instructions.push_back(cinstr.value());
+            m_instructions.push_back(std::move(cinstr.value()));
          }
          break;
       }
 
       auto end_token = this->eat();
-      if (end_token.has_value() && end_token.value().type != TokenType::Newline) {
-         auto next_token = this->peek();
+      if (end_token && end_token->type != TokenType::Newline) {
+         const auto &next_token = this->peek();
          this->emit_error(next_token,
              std::format(
                  "Expected a new line, found `{}`", get_stringified_token(next_token.value)));
@@ -491,7 +553,7 @@ std::optional<std::vector<Instruction>> Parser::parse() {
       return std::nullopt;
    }
 
-   return m_instructions;
+   return std::move(m_instructions);
 }
 
 }; // namespace assembly
@@ -0,0 +1,282 @@
+#include "../report/report.hpp"
+#include "asm.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace assembly {
+
+// makes room for `inserted` elements in place of the `removed` ones at `pos`, the elements that
+// are kept in place are left as they were
+template <typename T>
+static void splice(
+    std::vector<T> &vec, std::size_t pos, std::size_t removed, std::size_t inserted) {
+   const auto at = vec.begin() + static_cast<std::ptrdiff_t>(pos);
+   if (inserted > removed) {
+      vec.insert(at + static_cast<std::ptrdiff_t>(removed), inserted - removed, T { });
+   } else if (inserted < removed) {
+      vec.erase(
+          at + static_cast<std::ptrdiff_t>(inserted), at + static_cast<std::ptrdiff_t>(removed));
+   }
+}
+
+// `source` split at its newlines, a trailing newline is followed by one last empty line
+static std::vector<std::string_view> split_lines(std::string_view source) {
+   std::vector<std::string_view> lines { };
+   std::size_t line_start = 0;
+   while (true) {
+      const auto line_end = source.find('\n', line_start);
+      if (line_end == std::string_view::npos) {
+         lines.push_back(source.substr(line_start));
+         return lines;
+      }
+      lines.push_back(source.substr(line_start, line_end - line_start));
+      line_start = line_end + 1;
+   }
+}
+
+bool AssemblySession::has_instruction(const Line &line) {
+   return line.kind == LineKind::Load || line.kind == LineKind::Word;
+}
+
+AssemblySession::AssemblySession(std::filesystem::path name)
+    : m_name { std::move(name) } { }
+
+void AssemblySession::set_extended_isa(bool enabled) { m_extended_isa = enabled; }
+
+bool AssemblySession::extended_isa() const { return m_extended_isa; }
+
+std::size_t AssemblySession::line_count() const { return m_lines.size(); }
+
+std::string_view AssemblySession::line(std::size_t index) const { return m_lines.at(index).text; }
+
+bool AssemblySession::has_errors() const { return m_error_lines != 0; }
+
+const std::vector<std::uint16_t> &AssemblySession::rom() const { return m_rom; }
+
+const Labels &AssemblySession::get_labels() const { return m_labels; }
+
+AssemblySession::Line AssemblySession::assemble_line(
+    std::string_view text, std::size_t row, std::string *error_report) {
+   Line line { .text = std::string(text) };
+
+   // the newline is kept so that the parser sees the line just as it would in a whole file
+   m_line_buf.assign(text);
+   m_line_buf += '\n';
+   const report::SourceFile source { m_line_buf, m_name, row };
+
+   Lexer lexer { source, std::move(m_symbols) };
+   auto tokens = lexer.tokenize();
+   m_symbols = std::move(lexer.symbols());
+
+   Parser parser { tokens, source };
+   auto instructions = parser.parse();
+   if (!instructions.has_value()) {
+      line.has_errors = true;
+      if (error_report) {
+         *error_report += parser.get_error_report();
+      }
+      return line;
+   }
+
+   report::Context reporter { source };
+   for (const auto &inst_variant : instructions.value()) {
+      if (std::holds_alternative<Label>(inst_variant)) {
+         line.kind = LineKind::Label;
+         line.symbol = std::get<Label>(inst_variant).value;
+         continue;
+      }
+
+      if (std::holds_alternative<AInstr>(inst_variant)) {
+         const auto &inst = std::get<AInstr>(inst_variant);
+         if (std::holds_alternative<SymbolId>(inst.value)) {
+            line.kind = LineKind::Load;
+            line.symbol = std::get<SymbolId>(inst.value);
+            line.dirty = true;
+         } else if (auto binary = compile_ainstr_constant(inst, reporter); binary.has_value()) {
+            line.kind = LineKind::Word;
+            line.word = binary.value();
+         }
+         continue;
+      }
+
+      const auto &inst = std::get<CInstr>(inst_variant);
+      if (auto binary = compile_cinstr(inst, reporter, m_extended_isa); binary.has_value()) {
+         line.kind = LineKind::Word;
+         line.word = binary.value();
+      }
+   }
+
+   if (auto report = reporter.generate_final_report(); report.has_value()) {
+      line.kind = LineKind::Empty;
+      line.has_errors = true;
+      if (error_report) {
+         *error_report += report.value();
+      }
+   }
+
+   return line;
+}
+
+void AssemblySession::load(std::string_view source) {
+   m_symbols = SymbolTable { };
+   m_lines.clear();
+   m_line_pcs.clear();
+   m_addresses.clear();
+   m_rom.clear();
+   m_labels.clear();
+   m_error_lines = 0;
+
+   const auto lines = split_lines(source);
+   this->edit(0, 0, lines);
+}
+
+void AssemblySession::update(std::string_view source) {
+   const auto lines = split_lines(source);
+
+   // edits usually touch a single region, everything around it is kept as is
+   std::size_t prefix = 0;
+   const auto common = std::min(lines.size(), m_lines.size());
+   while (prefix < common && m_lines[prefix].text == lines[prefix]) {
+      ++prefix;
+   }
+
+   std::size_t suffix = 0;
+   while (suffix < common - prefix
+       && m_lines[m_lines.size() - 1 - suffix].text == lines[lines.size() - 1 - suffix]) {
+      ++suffix;
+   }
+
+   const auto changed = std::span(lines).subspan(prefix, lines.size() - prefix - suffix);
+   this->edit(prefix, m_lines.size() - prefix - suffix, changed);
+}
+
+void AssemblySession::edit(
+    std::size_t first, std::size_t removed, std::span<const std::string_view> lines) {
+   first = std::min(first, m_lines.size());
+   removed = std::min(removed, m_lines.size() - first);
+
+   // symbols only need laying out again when a label or a load comes or goes
+   bool touches_symbols = false;
+   std::size_t removed_insts = 0;
+   for (std::size_t i = first; i < first + removed; i++) {
+      const auto &line = m_lines[i];
+      touches_symbols = touches_symbols || line.kind == LineKind::Label
+          || line.kind == LineKind::Load;
+      removed_insts += has_instruction(line);
+      m_error_lines -= line.has_errors;
+   }
+
+   std::vector<Line> new_lines { };
+   new_lines.reserve(lines.size());
+   std::size_t inserted_insts = 0;
+   for (std::size_t i = 0; i < lines.size(); i++) {
+      auto line = this->assemble_line(lines[i], first + i);
+      touches_symbols = touches_symbols || line.kind == LineKind::Label
+          || line.kind == LineKind::Load;
+      inserted_insts += has_instruction(line);
+      m_error_lines += line.has_errors;
+      new_lines.push_back(std::move(line));
+   }
+
+   // === splice in the new lines and their instructions ===
+   const auto pc = first < m_line_pcs.size() ? m_line_pcs[first] : m_rom.size();
+   splice(m_lines, first, removed, new_lines.size());
+   splice(m_line_pcs, first, removed, new_lines.size());
+   splice(m_rom, pc, removed_insts, inserted_insts);
+
+   auto line_pc = pc;
+   for (std::size_t i = 0; i < new_lines.size(); i++) {
+      m_line_pcs[first + i] = line_pc;
+      if (new_lines[i].kind == LineKind::Word) {
+         m_rom[line_pc] = new_lines[i].word;
+      }
+      line_pc += has_instruction(new_lines[i]);
+      m_lines[first + i] = std::move(new_lines[i]);
+   }
+
+   // nothing else moved and every symbol is where it was
+   if (!touches_symbols && removed_insts == inserted_insts) {
+      return;
+   }
+
+   this->resolve();
+}
+
+void AssemblySession::resolve() {
+   // symbols interned since the last time haven't been given an address yet
+   m_addresses.resize(m_symbols.size(), -1);
+
+   std::vector<std::int32_t> addresses(m_symbols.size(), -1);
+   for (std::size_t i = 0; i < PREDEFINED_SYMBOLS.size(); i++) {
+      addresses[i] = PREDEFINED_SYMBOLS[i].address;
+   }
+
+   // === labels, the first declaration wins ===
+   m_labels.clear();
+   std::size_t pc = 0;
+   for (std::size_t i = 0; i < m_lines.size(); i++) {
+      const auto &line = m_lines[i];
+      m_line_pcs[i] = pc;
+      if (line.kind == LineKind::Label) {
+         // the pc wraps around just like `CodeGen`'s
+         const auto label_pc = static_cast<std::uint16_t>(pc);
+         auto &label_addr = addresses[static_cast<std::size_t>(line.symbol)];
+         if (label_addr == -1) {
+            label_addr = label_pc;
+         }
+         m_labels.emplace(m_symbols.name(line.symbol), label_pc);
+      }
+      pc += has_instruction(line);
+   }
+
+   // === variables in order of first use, and the loads whose symbol moved ===
+   auto var_addr = VAR_START_ADDRESS;
+   for (std::size_t i = 0; i < m_lines.size(); i++) {
+      auto &line = m_lines[i];
+      if (line.kind != LineKind::Load) {
+         continue;
+      }
+
+      const auto symbol = static_cast<std::size_t>(line.symbol);
+      if (addresses[symbol] == -1) {
+         addresses[symbol] = var_addr;
+         ++var_addr;
+      }
+
+      if (line.dirty || addresses[symbol] != m_addresses[symbol]) {
+         m_rom[m_line_pcs[i]] = 0b0111111111111111 & addresses[symbol];
+         line.dirty = false;
+      }
+   }
+
+   m_addresses = std::move(addresses);
+}
+
+std::optional<std::size_t> AssemblySession::line_at(std::size_t pc) const {
+   // lines without an instruction share the pc of the next one
+   auto it = std::lower_bound(m_line_pcs.begin(), m_line_pcs.end(), pc);
+   for (; it != m_line_pcs.end() && *it == pc; ++it) {
+      const auto index = static_cast<std::size_t>(it - m_line_pcs.begin());
+      if (has_instruction(m_lines[index])) {
+         return index;
+      }
+   }
+   return std::nullopt;
+}
+
+std::string AssemblySession::get_error_report() {
+   // reports aren't kept around since rows change as lines are added and removed
+   std::string error_report { };
+   for (std::size_t i = 0; i < m_lines.size(); i++) {
+      if (m_lines[i].has_errors) {
+         const std::string text = m_lines[i].text;
+         this->assemble_line(text, i, &error_report);
+      }
+   }
+   return error_report;
+}
+
+}; // namespace assembly
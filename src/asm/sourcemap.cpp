@@ -0,0 +1,221 @@
+#include "asm.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <unordered_set>
+
+namespace assembly {
+
+void push_uint(std::string &buf, std::uint64_t value, std::size_t size) {
+   for (std::size_t i = 0; i < size; i++) {
+      buf.push_back(static_cast<char>(value >> (i * 8)));
+   }
+}
+
+ByteReader::ByteReader(std::string_view data)
+    : m_data { data } { }
+
+bool ByteReader::ok() const { return m_ok; }
+
+bool ByteReader::at_end() const { return m_pos == m_data.size(); }
+
+std::string_view ByteReader::bytes(std::size_t size) {
+   if (!m_ok || size > m_data.size() - m_pos) {
+      m_ok = false;
+      return { };
+   }
+   const auto bytes = m_data.substr(m_pos, size);
+   m_pos += size;
+   return bytes;
+}
+
+std::uint64_t ByteReader::uint(std::size_t size) {
+   std::uint64_t value = 0;
+   const auto data = this->bytes(size);
+   for (std::size_t i = 0; i < data.size(); i++) {
+      value |= std::uint64_t { static_cast<unsigned char>(data[i]) } << (i * 8);
+   }
+   return value;
+}
+
+SourceMap::SourceMap(std::vector<std::filesystem::path> files,
+    std::vector<SourceLocation> locations, std::vector<std::pair<std::string, std::uint16_t>> labels,
+    std::vector<std::string> variables)
+    : m_files { std::move(files) }
+    , m_locations { std::move(locations) }
+    , m_labels { std::move(labels) }
+    , m_variables { std::move(variables) }
+    , m_enclosing_labels(m_locations.size(), 0) {
+   // the first label declared at a PC is the one it's shown with
+   std::unordered_set<std::string_view> declared { };
+   for (std::size_t i = 0; i < m_labels.size(); i++) {
+      const auto &[name, pc] = m_labels[i];
+      if (declared.insert(name).second && pc < m_enclosing_labels.size()
+          && m_enclosing_labels[pc] == 0) {
+         m_enclosing_labels[pc] = static_cast<std::uint32_t>(i + 1);
+      }
+   }
+
+   for (std::size_t pc = 1; pc < m_enclosing_labels.size(); pc++) {
+      if (m_enclosing_labels[pc] == 0) {
+         m_enclosing_labels[pc] = m_enclosing_labels[pc - 1];
+      }
+   }
+}
+
+std::size_t SourceMap::size() const { return m_locations.size(); }
+
+const std::vector<std::filesystem::path> &SourceMap::files() const { return m_files; }
+
+void SourceMap::set_files(std::vector<std::filesystem::path> files) { m_files = std::move(files); }
+
+std::optional<SourceLocation> SourceMap::location(std::uint16_t pc) const {
+   if (pc >= m_locations.size()) {
+      return std::nullopt;
+   }
+   return m_locations[pc];
+}
+
+std::string_view SourceMap::label_at(std::uint16_t pc) const {
+   if (pc >= m_enclosing_labels.size() || m_enclosing_labels[pc] == 0) {
+      return { };
+   }
+   const auto &[name, label_pc] = m_labels[m_enclosing_labels[pc] - 1];
+   return label_pc == pc ? std::string_view(name) : std::string_view();
+}
+
+std::string_view SourceMap::variable_at(std::uint16_t address) const {
+   const std::size_t index = address - VAR_START_ADDRESS;
+   if (address < VAR_START_ADDRESS || index >= m_variables.size()) {
+      return { };
+   }
+   return m_variables[index];
+}
+
+std::string SourceMap::describe(std::uint16_t pc) const {
+   const auto loc = this->location(pc);
+   if (!loc.has_value()) {
+      return "";
+   }
+
+   const auto file = loc->file < m_files.size() ? m_files[loc->file].string() : std::string();
+   // editors count from 1
+   auto description = std::format("{}:{}:{}", file, loc->row + 1, loc->col + 1);
+   if (m_enclosing_labels[pc] != 0) {
+      const auto &[name, label_pc] = m_labels[m_enclosing_labels[pc] - 1];
+      description += pc == label_pc ? std::format(" ({})", name)
+                                    : std::format(" ({}+{})", name, pc - label_pc);
+   }
+   return description;
+}
+
+const std::vector<std::pair<std::string, std::uint16_t>> &SourceMap::declared_labels() const {
+   return m_labels;
+}
+
+Labels SourceMap::labels() const {
+   Labels labels { };
+   for (const auto &[name, pc] : m_labels) {
+      labels.emplace(name, pc);
+   }
+   return labels;
+}
+
+std::string SourceMap::serialize() const {
+   // names and paths longer than their u16 size are cut short, no real program has those
+   const auto push_string = [](std::string &buf, std::string_view str) {
+      str = str.substr(0, std::numeric_limits<std::uint16_t>::max());
+      push_uint(buf, str.size(), 2);
+      buf.append(str);
+   };
+
+   std::string data { };
+   data.reserve(32 + m_locations.size() * 8);
+   data.append(SOURCE_MAP_MAGIC.data(), SOURCE_MAP_MAGIC.size());
+   push_uint(data, SOURCE_MAP_VERSION, 1);
+
+   push_uint(data, m_files.size(), 2);
+   for (const auto &file : m_files) {
+      push_string(data, file.string());
+   }
+
+   push_uint(data, m_locations.size(), 4);
+   for (const auto &loc : m_locations) {
+      push_uint(data, loc.file, 2);
+      push_uint(data, loc.col, 2);
+      push_uint(data, loc.row, 4);
+   }
+
+   push_uint(data, m_labels.size(), 4);
+   for (const auto &[name, pc] : m_labels) {
+      push_uint(data, pc, 2);
+      push_string(data, name);
+   }
+
+   push_uint(data, m_variables.size(), 4);
+   for (const auto &name : m_variables) {
+      push_string(data, name);
+   }
+   return data;
+}
+
+std::optional<SourceMap> SourceMap::parse(std::string_view data) {
+   ByteReader reader { data };
+   const auto magic = reader.bytes(SOURCE_MAP_MAGIC.size());
+   if (magic != std::string_view(SOURCE_MAP_MAGIC.data(), SOURCE_MAP_MAGIC.size())
+       || reader.uint(1) != SOURCE_MAP_VERSION) {
+      return std::nullopt;
+   }
+
+   // counts are checked against what's left, so a corrupt one can't allocate too much
+   std::vector<std::filesystem::path> files(std::min(reader.uint(2), data.size()));
+   for (auto &file : files) {
+      file = reader.bytes(reader.uint(2));
+   }
+
+   std::vector<SourceLocation> locations(std::min(reader.uint(4), data.size() / 8));
+   for (auto &loc : locations) {
+      loc.file = static_cast<std::uint16_t>(reader.uint(2));
+      loc.col = static_cast<std::uint16_t>(reader.uint(2));
+      loc.row = static_cast<std::uint32_t>(reader.uint(4));
+   }
+
+   std::vector<std::pair<std::string, std::uint16_t>> labels(
+       std::min(reader.uint(4), data.size() / 4));
+   for (auto &[name, pc] : labels) {
+      pc = static_cast<std::uint16_t>(reader.uint(2));
+      name = reader.bytes(reader.uint(2));
+   }
+
+   std::vector<std::string> variables(std::min(reader.uint(4), data.size() / 2));
+   for (auto &name : variables) {
+      name = reader.bytes(reader.uint(2));
+   }
+
+   if (!reader.ok() || !reader.at_end()) {
+      return std::nullopt;
+   }
+   return SourceMap { std::move(files), std::move(locations), std::move(labels),
+      std::move(variables) };
+}
+
+bool SourceMap::write(const std::filesystem::path &path) const {
+   const auto data = this->serialize();
+   std::ofstream file { path, std::ios::binary };
+   file.write(data.data(), static_cast<std::streamsize>(data.size()));
+   return static_cast<bool>(file);
+}
+
+std::optional<SourceMap> SourceMap::read(const std::filesystem::path &path) {
+   std::ifstream file { path, std::ios::binary };
+   if (!file.is_open()) {
+      return std::nullopt;
+   }
+   const std::string data { std::istreambuf_iterator<char>(file), { } };
+   return SourceMap::parse(data);
+}
+
+}; // namespace assembly
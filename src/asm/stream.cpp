@@ -0,0 +1,188 @@
+#include "../report/report.hpp"
+#include "asm.hpp"
+#include <bitset>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace assembly {
+
+// the ROM holds 32K instructions, anything past it couldn't be loaded anyway
+constexpr std::size_t rom_size = 1 << 15;
+
+StreamAssembler::StreamAssembler(std::ostream &output, std::filesystem::path name)
+    : m_output { output }
+    , m_name { std::move(name) } {
+   m_states.resize(m_symbols.size());
+   for (std::size_t i = 0; i < PREDEFINED_SYMBOLS.size(); i++) {
+      m_states[i].address = PREDEFINED_SYMBOLS[i].address;
+   }
+}
+
+void StreamAssembler::set_extended_isa(bool enabled) { m_extended_isa = enabled; }
+
+std::string StreamAssembler::get_error_report() { return m_error_report; }
+
+void StreamAssembler::emit(std::uint16_t instruction) {
+   m_pending.push_back(instruction);
+   ++m_pc;
+   if (m_waiting == 0) {
+      this->flush();
+   }
+}
+
+void StreamAssembler::flush() {
+   if (!m_error_report.empty()) {
+      m_pending.clear();
+      return;
+   }
+
+   for (const auto inst : m_pending) {
+      m_output << std::bitset<16> { inst }.to_string() << '\n';
+   }
+   m_pending.clear();
+}
+
+void StreamAssembler::resolve(SymbolId symbol, std::uint16_t address) {
+   auto &state = m_states[static_cast<std::size_t>(symbol)];
+   state.address = address;
+   if (state.last_ref == -1) {
+      return;
+   }
+
+   // walk the instructions waiting on the symbol from the latest back to the first
+   const std::size_t first_pending = m_pc - m_pending.size();
+   auto ref = static_cast<std::uint16_t>(state.last_ref);
+   while (true) {
+      auto &inst = m_pending[ref - first_pending];
+      const auto prev = inst;
+      inst = 0b0111111111111111 & address;
+      if (prev == ref) {
+         break;
+      }
+      ref = prev;
+   }
+
+   state.last_ref = -1;
+   --m_waiting;
+}
+
+void StreamAssembler::feed_line(std::string_view line) {
+   // the newline is kept so that the parser sees the line just as it would in a whole file
+   m_line.assign(line);
+   m_line += '\n';
+
+   const report::SourceFile source { m_line, m_name, m_row };
+   ++m_row;
+
+   Lexer lexer { source, std::move(m_symbols) };
+   auto tokens = lexer.tokenize();
+   m_symbols = std::move(lexer.symbols());
+   m_states.resize(m_symbols.size());
+
+   Parser parser { tokens, source };
+   auto instructions = parser.parse();
+   if (!instructions.has_value()) {
+      auto error_report = parser.get_error_report();
+      // some malformed lines, e.g. `(LOOP` or a bare `@`, fail without a report. They still have
+      // to stop the output, so they get one
+      if (error_report.empty()) {
+         report::Context reporter { source };
+         const report::Coord line_start { .col = 0, .row = 0 };
+         reporter.create_report(
+             report::ReportType::Error, line_start, line_start, "Invalid instruction.");
+         error_report = reporter.generate_final_report().value_or("Invalid instruction.\n");
+      }
+      m_error_report += error_report;
+      return;
+   }
+
+   report::Context reporter { source };
+   for (const auto &inst_variant : instructions.value()) {
+      if (std::holds_alternative<Label>(inst_variant)) {
+         // the first declaration wins and predefined symbols can't be redeclared
+         const auto label = std::get<Label>(inst_variant).value;
+         if (m_states[static_cast<std::size_t>(label)].address == -1) {
+            this->resolve(label, m_pc);
+            if (m_waiting == 0) {
+               this->flush();
+            }
+         }
+         continue;
+      }
+
+      if (m_pc >= rom_size) {
+         // only reported once, the rest of the program is still checked
+         if (!m_rom_full) {
+            const report::Coord line_start { .col = 0, .row = 0 };
+            reporter.create_report(report::ReportType::Error, line_start, line_start,
+                std::format("Program doesn't fit in ROM. Only {} instructions fit.", rom_size));
+            m_rom_full = true;
+         }
+         continue;
+      }
+
+      if (std::holds_alternative<AInstr>(inst_variant)) {
+         const auto &inst = std::get<AInstr>(inst_variant);
+         if (std::holds_alternative<std::size_t>(inst.value)) {
+            if (auto binary = compile_ainstr_constant(inst, reporter); binary.has_value()) {
+               this->emit(binary.value());
+            }
+            continue;
+         }
+
+         const auto symbol = std::get<SymbolId>(inst.value);
+         auto &state = m_states[static_cast<std::size_t>(symbol)];
+         if (state.address != -1) {
+            this->emit(0b0111111111111111 & state.address);
+            continue;
+         }
+
+         // the first instruction waiting on a symbol points at itself
+         auto prev_ref = static_cast<std::uint16_t>(m_pc);
+         if (state.last_ref == -1) {
+            m_waited_on.push_back(symbol);
+            ++m_waiting;
+         } else {
+            prev_ref = state.last_ref;
+         }
+         state.last_ref = m_pc;
+         this->emit(prev_ref);
+         continue;
+      }
+
+      const auto &inst = std::get<CInstr>(inst_variant);
+      if (auto binary = compile_cinstr(inst, reporter, m_extended_isa); binary.has_value()) {
+         this->emit(binary.value());
+      }
+   }
+
+   if (auto error_report = reporter.generate_final_report(); error_report.has_value()) {
+      m_error_report += error_report.value();
+   }
+}
+
+std::optional<std::size_t> StreamAssembler::finish() {
+   auto var_addr = VAR_START_ADDRESS;
+   for (const auto symbol : m_waited_on) {
+      if (m_states[static_cast<std::size_t>(symbol)].address == -1) {
+         this->resolve(symbol, var_addr);
+         ++var_addr;
+      }
+   }
+   m_waited_on.clear();
+
+   this->flush();
+   m_output.flush();
+
+   if (!m_error_report.empty()) {
+      return std::nullopt;
+   }
+
+   return m_pc;
+}
+
+}; // namespace assembly
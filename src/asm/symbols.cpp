@@ -0,0 +1,106 @@
+#include "asm.hpp"
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+
+namespace assembly {
+
+// the table every program starts out with, the predefined symbols take the first ids in order
+constexpr std::array<SymbolTable::Slot, SymbolTable::INITIAL_SLOTS> SymbolTable::seed_slots() {
+   static_assert(PREDEFINED_SYMBOLS.size() * 2 <= INITIAL_SLOTS);
+
+   std::array<Slot, INITIAL_SLOTS> slots { };
+   for (auto &slot : slots) {
+      slot = { .hash = 0, .id = EMPTY_SLOT };
+   }
+
+   constexpr std::size_t mask = INITIAL_SLOTS - 1;
+   for (std::uint32_t id = 0; id < PREDEFINED_SYMBOLS.size(); id++) {
+      const auto hash = hash_symbol(PREDEFINED_SYMBOLS[id].name);
+      auto i = hash & mask;
+      while (slots[i].id != EMPTY_SLOT) {
+         i = (i + 1) & mask;
+      }
+      slots[i] = { .hash = hash, .id = id };
+   }
+
+   return slots;
+}
+
+SymbolTable::SymbolTable() {
+   static constexpr auto seeded_slots = seed_slots();
+   m_slots.assign(seeded_slots.begin(), seeded_slots.end());
+
+   m_names.reserve(INITIAL_SLOTS / 2);
+   // the names of the predefined symbols live in static storage, so they're never copied
+   for (const auto &symbol : PREDEFINED_SYMBOLS) {
+      m_names.push_back(symbol.name);
+   }
+}
+
+std::string_view SymbolTable::store(std::string_view name) {
+   // only the last chunk has room left, names that don't fit in it start a new one
+   if (name.size() > m_chunk_left) {
+      const auto size = std::max(CHUNK_SIZE, name.size());
+      m_chunks.push_back(std::make_unique_for_overwrite<char[]>(size));
+      m_chunk_next = m_chunks.back().get();
+      m_chunk_left = size;
+   }
+
+   std::memcpy(m_chunk_next, name.data(), name.size());
+   const std::string_view stored { m_chunk_next, name.size() };
+   m_chunk_next += name.size();
+   m_chunk_left -= name.size();
+   return stored;
+}
+
+void SymbolTable::grow() {
+   std::vector<Slot> slots(m_slots.size() * 2, Slot { .hash = 0, .id = EMPTY_SLOT });
+   const std::size_t mask = slots.size() - 1;
+   for (const auto &slot : m_slots) {
+      if (slot.id == EMPTY_SLOT) {
+         continue;
+      }
+
+      auto i = slot.hash & mask;
+      while (slots[i].id != EMPTY_SLOT) {
+         i = (i + 1) & mask;
+      }
+      slots[i] = slot;
+   }
+
+   m_slots = std::move(slots);
+}
+
+SymbolId SymbolTable::intern(std::string_view name) {
+   const auto hash = hash_symbol(name);
+   const std::size_t mask = m_slots.size() - 1;
+
+   auto i = hash & mask;
+   while (m_slots[i].id != EMPTY_SLOT) {
+      const auto &slot = m_slots[i];
+      if (slot.hash == hash && m_names[slot.id] == name) {
+         return static_cast<SymbolId>(slot.id);
+      }
+      i = (i + 1) & mask;
+   }
+
+   const auto id = static_cast<std::uint32_t>(m_names.size());
+   m_slots[i] = { .hash = hash, .id = id };
+   m_names.push_back(this->store(name));
+
+   // kept at most half full so that probe sequences stay short
+   if (m_names.size() * 2 > m_slots.size()) {
+      this->grow();
+   }
+
+   return static_cast<SymbolId>(id);
+}
+
+std::string_view SymbolTable::name(SymbolId id) const {
+   return m_names.at(static_cast<std::size_t>(id));
+}
+
+std::size_t SymbolTable::size() const { return m_names.size(); }
+
+}; // namespace assembly
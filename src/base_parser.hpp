@@ -2,50 +2,49 @@
 #define BASE_PARSER_HPP
 
 #include "report/report.hpp"
-#include <filesystem>
-#include <optional>
+#include <span>
+#include <stdexcept>
 #include <string>
-#include <vector>
 
-// Token and TokenType are the ones used by the language's lexer
+// Token and TokenType are the ones used by the language's lexer.
+// The tokens and the source they were lexed from are borrowed, they have to outlive the parser.
 template <typename Token, typename TokenType> class BaseParser {
    protected:
-   std::vector<Token> m_tokens;
+   std::span<const Token> m_tokens;
    std::size_t m_idx { 0 };
    std::string m_error_report { "" };
    report::Context m_reporter;
 
    bool eof() const;
    bool peek_expected(TokenType tt) const noexcept;
-   Token curr_token() const;
-   Token peek() const;
-   std::optional<Token> eat() noexcept;
+   // both throw `std::out_of_range` when there's no such token
+   const Token &curr_token() const;
+   const Token &peek() const;
+   // moves to the next token and returns it, nullptr once the end is reached
+   const Token *eat() noexcept;
    void emit_error(const Token &tok, std::string_view error);
 
    public:
    std::string get_error_report() const;
-   explicit BaseParser(std::vector<Token> tokens, const std::filesystem::path filepath);
-   explicit BaseParser(std::vector<Token> tokens, std::string_view contents);
+   explicit BaseParser(std::span<const Token> tokens, const report::SourceFile &source);
 };
 
 template <typename Token, typename TokenType>
 BaseParser<Token, TokenType>::BaseParser(
-    std::vector<Token> tokens, const std::filesystem::path filepath)
+    std::span<const Token> tokens, const report::SourceFile &source)
     : m_tokens { tokens }
-    , m_reporter { filepath } { }
-
-template <typename Token, typename TokenType>
-BaseParser<Token, TokenType>::BaseParser(std::vector<Token> tokens, std::string_view contents)
-    : m_tokens { tokens }
-    , m_reporter { contents } { }
+    , m_reporter { source } { }
 
 template <typename Token, typename TokenType> bool BaseParser<Token, TokenType>::eof() const {
    return m_idx >= m_tokens.size();
 }
 
 template <typename Token, typename TokenType>
-Token BaseParser<Token, TokenType>::curr_token() const {
-   return m_tokens.at(m_idx);
+const Token &BaseParser<Token, TokenType>::curr_token() const {
+   if (m_idx >= m_tokens.size()) {
+      throw std::out_of_range("no current token");
+   }
+   return m_tokens[m_idx];
 }
 
 template <typename Token, typename TokenType>
@@ -55,26 +54,29 @@ bool BaseParser<Token, TokenType>::peek_expected(TokenType tt) const noexcept {
       return false;
    }
 
-   auto next_token = m_tokens.at(next_idx);
-   if (next_token.type != tt) {
+   if (m_tokens[next_idx].type != tt) {
       return false;
    }
 
    return true;
 }
 
-template <typename Token, typename TokenType> Token BaseParser<Token, TokenType>::peek() const {
-   return m_tokens.at(m_idx + 1);
+template <typename Token, typename TokenType>
+const Token &BaseParser<Token, TokenType>::peek() const {
+   if (m_idx + 1 >= m_tokens.size()) {
+      throw std::out_of_range("no token to peek at");
+   }
+   return m_tokens[m_idx + 1];
 }
 
 template <typename Token, typename TokenType>
-std::optional<Token> BaseParser<Token, TokenType>::eat() noexcept {
+const Token *BaseParser<Token, TokenType>::eat() noexcept {
    ++m_idx;
    if (m_idx < m_tokens.size()) {
-      return m_tokens[m_idx];
+      return &m_tokens[m_idx];
    }
 
-   return std::nullopt;
+   return nullptr;
 }
 
 template <typename Token, typename TokenType>
@@ -0,0 +1,175 @@
+#include "n2t.h"
+#include "../asm/asm.hpp"
+#include "../hack/hack.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+struct n2t_hack {
+   Hack hack { };
+};
+
+static thread_local std::string last_error { };
+
+static n2t_status fail(n2t_status status, std::string_view error) {
+   last_error = error;
+   return status;
+}
+
+int n2t_api_version(void) { return N2T_API_VERSION; }
+
+const char *n2t_last_error(void) { return last_error.c_str(); }
+
+n2t_hack *n2t_hack_create(void) { return new (std::nothrow) n2t_hack { }; }
+
+void n2t_hack_destroy(n2t_hack *hack) { delete hack; }
+
+n2t_status n2t_hack_load_rom(n2t_hack *hack, const uint16_t *rom, size_t count) {
+   if (!hack || (!rom && count > 0)) {
+      return fail(N2T_ERR_INVALID_ARGUMENT, "hack and rom cannot be null");
+   }
+
+   if (!hack->hack.load_rom(std::span<const std::uint16_t> { rom, count })) {
+      return fail(N2T_ERR_ROM_TOO_LARGE, "ROM doesn't fit in instruction memory");
+   }
+
+   return N2T_OK;
+}
+
+n2t_status n2t_hack_load_rom_text(n2t_hack *hack, const char *text, size_t length) {
+   if (!hack || (!text && length > 0)) {
+      return fail(N2T_ERR_INVALID_ARGUMENT, "hack and text cannot be null");
+   }
+
+   try {
+      if (!hack->hack.load_rom(std::string_view { text, length })) {
+         return fail(N2T_ERR_INVALID_ROM, "text is not a valid Hack ROM");
+      }
+   } catch (const std::bad_alloc &) {
+      return fail(N2T_ERR_INVALID_ROM, "out of memory while reading ROM");
+   }
+
+   return N2T_OK;
+}
+
+n2t_status n2t_hack_run(n2t_hack *hack, uint64_t cycles, uint64_t *executed) {
+   if (!hack) {
+      return fail(N2T_ERR_INVALID_ARGUMENT, "hack cannot be null");
+   }
+
+   std::uint64_t i = 0;
+   n2t_status status = N2T_OK;
+   try {
+      for (; i < cycles; i++) {
+         hack->hack.tick();
+      }
+   } catch (const std::string &err) {
+      status = fail(N2T_ERR_INVALID_INSTRUCTION, err);
+   } catch (const std::out_of_range &) {
+      status = fail(N2T_ERR_INVALID_INSTRUCTION, "memory access out of range");
+   }
+
+   if (executed) {
+      *executed = i;
+   }
+   return status;
+}
+
+n2t_status n2t_hack_read_ram(const n2t_hack *hack, uint16_t address, uint16_t *value) {
+   if (!hack || !value || address >= hack->hack.data_mem.size()) {
+      return fail(N2T_ERR_INVALID_ARGUMENT, "invalid RAM read");
+   }
+
+   *value = hack->hack.data_mem[address];
+   return N2T_OK;
+}
+
+n2t_status n2t_hack_write_ram(n2t_hack *hack, uint16_t address, uint16_t value) {
+   if (!hack || address >= hack->hack.data_mem.size()) {
+      return fail(N2T_ERR_INVALID_ARGUMENT, "invalid RAM write");
+   }
+
+   hack->hack.data_mem[address] = value;
+   return N2T_OK;
+}
+
+n2t_status n2t_hack_get_register(const n2t_hack *hack, n2t_register reg, uint16_t *value) {
+   if (!hack || !value) {
+      return fail(N2T_ERR_INVALID_ARGUMENT, "hack and value cannot be null");
+   }
+
+   switch (reg) {
+   case N2T_REG_A:
+      *value = hack->hack.address_reg;
+      return N2T_OK;
+   case N2T_REG_D:
+      *value = hack->hack.data_reg;
+      return N2T_OK;
+   case N2T_REG_PC:
+      *value = hack->hack.pc;
+      return N2T_OK;
+   }
+
+   return fail(N2T_ERR_INVALID_ARGUMENT, "unknown register");
+}
+
+n2t_status n2t_hack_set_register(n2t_hack *hack, n2t_register reg, uint16_t value) {
+   if (!hack) {
+      return fail(N2T_ERR_INVALID_ARGUMENT, "hack cannot be null");
+   }
+
+   switch (reg) {
+   case N2T_REG_A:
+      hack->hack.address_reg = value;
+      return N2T_OK;
+   case N2T_REG_D:
+      hack->hack.data_reg = value;
+      return N2T_OK;
+   case N2T_REG_PC:
+      hack->hack.pc = value;
+      return N2T_OK;
+   }
+
+   return fail(N2T_ERR_INVALID_ARGUMENT, "unknown register");
+}
+
+n2t_status n2t_assemble(
+    const char *source, size_t length, uint16_t *out, size_t capacity, size_t *count) {
+   if (!source || !count || (!out && capacity > 0)) {
+      return fail(N2T_ERR_INVALID_ARGUMENT, "source and count cannot be null");
+   }
+
+   const report::SourceFile source_file { std::string_view { source, length } };
+   try {
+      assembly::Lexer lexer { source_file };
+      auto tokens = lexer.tokenize();
+
+      assembly::Parser parser { tokens, source_file };
+      auto instructions = parser.parse();
+      if (!instructions.has_value()) {
+         return fail(N2T_ERR_ASSEMBLY, parser.get_error_report());
+      }
+
+      assembly::CodeGen codegen {
+         std::move(instructions.value()), std::move(lexer.symbols()), source_file
+      };
+      auto rom = codegen.compile();
+      if (!rom.has_value()) {
+         return fail(N2T_ERR_ASSEMBLY, codegen.get_error_report());
+      }
+
+      *count = rom->size();
+      if (rom->size() > capacity) {
+         return fail(N2T_ERR_BUFFER_TOO_SMALL, "output buffer is too small");
+      }
+
+      std::copy(rom->begin(), rom->end(), out);
+   } catch (const std::bad_alloc &) {
+      return fail(N2T_ERR_ASSEMBLY, "out of memory while assembling");
+   }
+
+   return N2T_OK;
+}
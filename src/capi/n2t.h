@@ -0,0 +1,92 @@
+#ifndef N2T_H
+#define N2T_H
+
+// C interface to the Hack emulator and assembler.
+//
+// This is the stable ABI exposed by the `n2t_capi` shared library (libn2t). It doesn't depend on
+// SDL so it can be loaded in-process by other languages. Nothing in here throws, every fallible
+// call returns an `n2t_status` and a description of the last failure on the calling thread can be
+// retrieved with `n2t_last_error`.
+//
+// Note: Debug builds are instrumented with sanitizers, embed a Release build instead.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+   #define N2T_API __declspec(dllexport)
+#else
+   #define N2T_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define N2T_API_VERSION 1
+
+typedef enum n2t_status {
+   N2T_OK = 0,
+   // an argument was null or out of the valid range
+   N2T_ERR_INVALID_ARGUMENT,
+   // the ROM doesn't fit in the 32K of instruction memory
+   N2T_ERR_ROM_TOO_LARGE,
+   // the text ROM contains something other than 16-bit binary words
+   N2T_ERR_INVALID_ROM,
+   // the emulator reached an instruction it cannot execute
+   N2T_ERR_INVALID_INSTRUCTION,
+   // the assembly source contains errors, see `n2t_last_error`
+   N2T_ERR_ASSEMBLY,
+   // the caller provided buffer is too small for the output
+   N2T_ERR_BUFFER_TOO_SMALL,
+} n2t_status;
+
+typedef enum n2t_register {
+   N2T_REG_A,
+   N2T_REG_D,
+   N2T_REG_PC,
+} n2t_register;
+
+typedef struct n2t_hack n2t_hack;
+
+// returns N2T_API_VERSION of the loaded library
+N2T_API int n2t_api_version(void);
+
+// description of the last error that happened on the calling thread.
+// The pointer is valid until the next call into the library from the same thread.
+N2T_API const char *n2t_last_error(void);
+
+// ==== Emulator
+
+// returns NULL if the machine couldn't be allocated
+N2T_API n2t_hack *n2t_hack_create(void);
+N2T_API void n2t_hack_destroy(n2t_hack *hack);
+
+// loads `count` instruction words at the start of ROM and resets PC
+N2T_API n2t_status n2t_hack_load_rom(n2t_hack *hack, const uint16_t *rom, size_t count);
+// loads a `.hack` file's contents (one binary word per line) and resets PC
+N2T_API n2t_status n2t_hack_load_rom_text(n2t_hack *hack, const char *text, size_t length);
+
+// executes up to `cycles` instructions. `executed` is optional and is set to the amount of
+// cycles actually run, which is less than `cycles` only when an error stops the machine
+N2T_API n2t_status n2t_hack_run(n2t_hack *hack, uint64_t cycles, uint64_t *executed);
+
+N2T_API n2t_status n2t_hack_read_ram(const n2t_hack *hack, uint16_t address, uint16_t *value);
+N2T_API n2t_status n2t_hack_write_ram(n2t_hack *hack, uint16_t address, uint16_t value);
+
+N2T_API n2t_status n2t_hack_get_register(const n2t_hack *hack, n2t_register reg, uint16_t *value);
+N2T_API n2t_status n2t_hack_set_register(n2t_hack *hack, n2t_register reg, uint16_t value);
+
+// ==== Assembler
+
+// assembles `length` bytes of Hack assembly into `out`.
+// `count` is set to the number of words produced, when the buffer is too small it is set to the
+// required capacity and N2T_ERR_BUFFER_TOO_SMALL is returned.
+N2T_API n2t_status n2t_assemble(
+    const char *source, size_t length, uint16_t *out, size_t capacity, size_t *count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
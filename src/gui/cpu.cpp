@@ -1,12 +1,15 @@
 #include "cpu.hpp"
 #include "../asm/asm.hpp"
+#include "../hack/sdl.hpp"
 #include "gui.hpp"
 #include "imgui.h"
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <charconv>
 #include <chrono>
 #include <cmath>
+#include <format>
 #include <iostream>
 #include <thread>
 
@@ -37,29 +40,50 @@ ViewCtx::ViewCtx(gui::Context *ctx)
 
       while (!token.stop_requested()) {
          gui::start_frame();
+         apply_pending_program();
+         apply_pending_until();
+         _hack.extended_isa = _extended_isa.load(std::memory_order_relaxed);
          try {
             switch (_hack_state.load(std::memory_order_relaxed)) {
             case State::Off:
                [[fallthrough]];
             case State::Stopped:
+               update_keyboard();
                std::this_thread::sleep_for(chrono::milliseconds(30));
                break;
 
-            case State::Running: {
-               auto key = _ctx->key.load(std::memory_order_acquire);
-               auto &keyboard_mem = _hack.get_keyboard_mmap();
-               if (key.has_value()) {
-                  keyboard_mem = convert_input_to_hack(key.value());
-               } else {
-                  keyboard_mem = 0;
-               }
+            case State::Running:
+               run_with_input(static_cast<std::uint64_t>(ticks_per_frame * _hack_speed),
+                   [this](std::uint64_t cycles) {
+                      if (_fast_loops) {
+                         _idioms.run(_hack, cycles);
+                      } else {
+                         for (std::uint64_t i = 0; i < cycles; i++) {
+                            _hack.tick();
+                         }
+                      }
+                      return true;
+                   });
+               capture_screen();
+               break;
 
-               for (int i = 0; i < ticks_per_frame * _hack_speed; i++) {
-                  _hack.tick();
+            case State::RunningUntil: {
+               bool reached = false;
+               run_with_input(static_cast<std::uint64_t>(ticks_per_frame * _hack_speed),
+                   [this, &reached](std::uint64_t cycles) {
+                      reached = run_until(_hack, _until.value(), cycles).reached;
+                      return !reached;
+                   });
+               capture_screen();
+               if (reached) {
+                  _hack_state.store(State::Stopped, std::memory_order_relaxed);
+                  _logs.push(LogType::Success,
+                      std::format("Stop condition reached at PC = {}.", _hack.pc).c_str());
                }
             } break;
 
             case State::StepThrough:
+               update_keyboard();
                _hack.tick();
                _hack_state.store(State::Stopped, std::memory_order_relaxed);
                std::this_thread::sleep_for(gui::TIME_PER_FRAME);
@@ -73,6 +97,9 @@ ViewCtx::ViewCtx(gui::Context *ctx)
          } catch (std::out_of_range &) {
             _hack_state.store(State::Stopped, std::memory_order_relaxed);
             _logs.push(LogType::Error, "Failed to run. Check if you have a valid program loaded.");
+         } catch (std::string &err) {
+            _hack_state.store(State::Stopped, std::memory_order_relaxed);
+            _logs.push(LogType::Error, err.c_str());
          }
 
          gui::end_frame();
@@ -81,61 +108,391 @@ ViewCtx::ViewCtx(gui::Context *ctx)
 
    _dialog_worker = std::jthread([this](std::stop_token token) {
       while (!token.stop_requested()) {
-         if (!_ctx->dialog_ready()) {
+         std::vector<RomEdit> rom_edits { };
+         {
+            std::lock_guard lock { _program_mutex };
+            rom_edits.swap(_pending_rom_edits);
+         }
+         if (!rom_edits.empty()) {
+            auto program = apply_rom_edits(rom_edits);
+            if (program.has_value()) {
+               std::lock_guard lock { _program_mutex };
+               _pending_program = std::move(program);
+            }
+            continue;
+         }
+
+         std::optional<fs::path> file = std::nullopt;
+         bool hot_reload = _hot_reload_requested.exchange(false);
+         if (hot_reload) {
+            std::lock_guard lock { _program_mutex };
+            file = _program_path;
+         } else if (_ctx->dialog_ready()) {
+            file = _ctx->dialog_get_file();
+         } else {
             std::this_thread::sleep_for(std::chrono::milliseconds(100));
             continue;
          }
 
-         auto file = _ctx->dialog_get_file();
          if (!file.has_value()) {
             continue;
          }
 
-         fs::path filepath = file.value();
-         auto file_ext = filepath.extension();
-         if (file_ext == ".asm") {
-            assembly::Lexer lexer { filepath };
-            auto tokens = lexer.tokenize();
-            if (tokens.empty()) {
-               _logs.push(LogType::Error, "Failed to lex file.");
-               continue;
-            }
-            assembly::Parser parser { tokens, filepath };
-            auto ast = parser.parse();
-            if (!ast.has_value()) {
-               auto report = parser.get_error_report();
-               _logs.push(LogType::Error, report.data());
-               continue;
-            }
-            assembly::CodeGen codegen { ast.value(), filepath };
-            auto machine_code = codegen.compile();
-            if (!machine_code.has_value()) {
-               auto report = codegen.get_error_report();
-               _logs.push(LogType::Error, report.data());
-               continue;
-            }
+         auto program = read_program(file.value(), hot_reload);
+         if (!program.has_value()) {
+            continue;
+         }
+         program->hot_reload = hot_reload;
 
-            _hack.load_rom(machine_code.value());
-            _logs.push(LogType::Success, "ROM Loaded.");
-            _hack_state = State::Stopped;
-         } else if (file_ext == ".hack") {
-            std::ifstream filestream { filepath };
-            std::stringstream contents;
-            contents << filestream.rdbuf();
-            if (!_hack.load_rom(std::move(contents.str()))) {
-               _logs.push(LogType::Error,
-                   "Failed to load Hack ROM, please check that the file contains valid hack "
-                   "machine code.");
-            }
-            _hack_state = State::Stopped;
+         std::lock_guard lock { _program_mutex };
+         _pending_program = std::move(program);
+         _program_path = file;
+      }
+   });
+}
+
+std::optional<PendingProgram> ViewCtx::read_program(const fs::path &filepath, bool hot_reload) {
+   auto file_ext = filepath.extension();
+   if (file_ext == ".asm") {
+      // the file is being edited, it could be truncated while it's in use
+      const auto access = hot_reload ? report::FileAccess::Read : report::FileAccess::Mapped;
+      const report::SourceFile source { filepath, access };
+      const assembly::AssemblyFlags flags { .extended_isa = _extended_isa };
+      // hot reloads only reassemble the lines that changed since the program was loaded
+      if (hot_reload && _asm_session.has_value() && _asm_session->extended_isa() == _extended_isa) {
+         _asm_session->update(source.contents());
+      } else if (auto cached = _program_cache.load(source.contents(), flags); cached.has_value()) {
+         // the session is only built once the program gets edited, see `apply_rom_edits`
+         _asm_session.reset();
+         _cached_source = source.contents();
+         _asm_loaded = true;
+         return PendingProgram {
+            .rom = std::move(cached->rom),
+            .labels = std::move(cached->labels),
+            .hot_reload = false,
+         };
+      } else {
+         _asm_session.emplace(filepath);
+         _asm_session->set_extended_isa(_extended_isa);
+         _asm_session->load(source.contents());
+      }
+      _cached_source.reset();
+
+      auto program = session_program();
+      _asm_loaded = program.has_value();
+      if (program.has_value()) {
+         _program_cache.store(
+             source.contents(), flags, { .rom = program->rom, .labels = program->labels });
+      }
+      return program;
+   }
+
+   if (file_ext == ".hack") {
+      std::ifstream filestream { filepath };
+      std::stringstream contents;
+      contents << filestream.rdbuf();
+      auto rom = parse_rom(contents.str());
+      if (!rom.has_value()) {
+         _logs.push(LogType::Error,
+             "Failed to load Hack ROM, please check that the file contains valid hack "
+             "machine code.");
+         return std::nullopt;
+      }
+
+      // written by `asm -g`, it gives the ROM back its labels
+      std::shared_ptr<const assembly::SourceMap> source_map { };
+      auto map_path = filepath;
+      map_path += ".map";
+      if (fs::exists(map_path)) {
+         auto map = assembly::SourceMap::read(map_path);
+         if (map.has_value() && map->size() == rom->size()) {
+            source_map = std::make_shared<const assembly::SourceMap>(std::move(map.value()));
          } else {
-            _logs.push(LogType::Error, "File contains an invalid extension.");
+            _logs.push(LogType::Error,
+                std::format("`{}` isn't a source map of this ROM, it was ignored.",
+                    map_path.string())
+                    .c_str());
          }
       }
-   });
+
+      _asm_session.reset();
+      _cached_source.reset();
+      _asm_loaded = false;
+      return PendingProgram {
+         .rom = std::move(rom.value()),
+         .labels = source_map ? source_map->labels() : assembly::Labels { },
+         .hot_reload = false,
+         .source_map = std::move(source_map),
+      };
+   }
+
+   _logs.push(LogType::Error, "File contains an invalid extension.");
+   return std::nullopt;
+}
+
+std::optional<PendingProgram> ViewCtx::session_program() {
+   if (_asm_session->has_errors()) {
+      auto report = _asm_session->get_error_report();
+      _logs.push(LogType::Error, report.data());
+      return std::nullopt;
+   }
+
+   return PendingProgram {
+      .rom = _asm_session->rom(),
+      .labels = _asm_session->get_labels(),
+      .hot_reload = false,
+   };
+}
+
+// Replaces the source lines of the edited instructions, so that symbols resolve against the rest
+// of the program and the addresses after them shift when an edit adds or removes instructions.
+std::optional<PendingProgram> ViewCtx::apply_rom_edits(std::span<const RomEdit> edits) {
+   if (!_asm_session.has_value()) {
+      if (!_cached_source.has_value()) {
+         return std::nullopt;
+      }
+
+      std::optional<fs::path> program_path { };
+      {
+         std::lock_guard lock { _program_mutex };
+         program_path = _program_path;
+      }
+      _asm_session.emplace(program_path.value_or(fs::path { }));
+      _asm_session->set_extended_isa(_extended_isa);
+      _asm_session->load(_cached_source.value());
+      _cached_source.reset();
+   }
+
+   for (const auto &edit : edits) {
+      auto line = _asm_session->line_at(edit.pc);
+      if (!line.has_value()) {
+         _logs.push(LogType::Error,
+             std::format("No instruction at {} to edit in the program.", edit.pc).c_str());
+         continue;
+      }
+
+      const std::string old_text { _asm_session->line(line.value()) };
+      const std::string_view new_text[] { edit.text };
+      _asm_session->edit(line.value(), 1, new_text);
+      if (_asm_session->has_errors()) {
+         auto report = _asm_session->get_error_report();
+         _logs.push(LogType::Error, report.data());
+         // the line is put back so that the program keeps assembling
+         const std::string_view reverted[] { old_text };
+         _asm_session->edit(line.value(), 1, reverted);
+      }
+   }
+
+   auto program = session_program();
+   if (program.has_value()) {
+      program->hot_reload = true;
+   }
+   return program;
+}
+
+// Maps `pc` to the same offset from its closest preceding label in the new program.
+// Of the labels at that address the first one by name that's still in the new program is used.
+// When there's none `pc` is kept as is. Returns nothing if the result is past the end of the new
+// program, `new_size` instructions long.
+static std::optional<std::uint16_t> remap_pc(std::uint16_t pc, const assembly::Labels &old_labels,
+    const assembly::Labels &new_labels, std::size_t new_size) {
+   std::optional<std::uint16_t> closest_addr { };
+   for (const auto &[label, addr] : old_labels) {
+      if (addr <= pc && (!closest_addr || addr > closest_addr.value())) {
+         closest_addr = addr;
+      }
+   }
+
+   std::vector<const std::string *> candidates { };
+   if (closest_addr.has_value()) {
+      for (const auto &[label, addr] : old_labels) {
+         if (addr == closest_addr.value()) {
+            candidates.push_back(&label);
+         }
+      }
+   }
+   std::sort(candidates.begin(), candidates.end(),
+       [](const std::string *a, const std::string *b) { return *a < *b; });
+
+   std::uint64_t remapped = pc;
+   for (const auto *label : candidates) {
+      if (auto new_label = new_labels.find(*label); new_label != new_labels.end()) {
+         remapped = std::uint64_t { new_label->second } + (pc - closest_addr.value());
+         break;
+      }
+   }
+
+   if (remapped >= new_size) {
+      return std::nullopt;
+   }
+   return static_cast<std::uint16_t>(remapped);
+}
+
+void ViewCtx::apply_pending_program() {
+   std::optional<PendingProgram> program = std::nullopt;
+   {
+      std::lock_guard lock { _program_mutex };
+      program.swap(_pending_program);
+   }
+
+   if (!program.has_value()) {
+      return;
+   }
+
+   if (program->hot_reload) {
+      auto changed = _hack.patch_rom(program->rom);
+      if (!changed.has_value()) {
+         _logs.push(LogType::Error, "Failed to hot reload, program doesn't fit in ROM.");
+         return;
+      }
+
+      auto pc = remap_pc(_hack.pc, _program_labels, program->labels, program->rom.size());
+      if (pc.has_value()) {
+         _hack.pc = pc.value();
+      } else {
+         _hack_state.store(State::Stopped, std::memory_order_relaxed);
+         _logs.push(LogType::Error, "The PC is past the end of the reloaded program, stopped.");
+      }
+      _logs.push(LogType::Success,
+          std::format("ROM hot reloaded, {} words changed.", changed.value()).c_str());
+   } else {
+      if (!_hack.load_rom(program->rom)) {
+         _logs.push(LogType::Error, "Failed to load program, it doesn't fit in ROM.");
+         return;
+      }
+
+      _logs.push(LogType::Success, "ROM Loaded.");
+      _hack_state = State::Stopped;
+   }
+
+   _program_labels = std::move(program->labels);
+   {
+      std::lock_guard lock { _program_mutex };
+      _source_map = std::move(program->source_map);
+   }
+   _idioms.analyze(_hack.instruction_mem);
+
+   // labels in the stop condition may have moved or be gone
+   if (_until.has_value()) {
+      std::string error { };
+      _until = Predicate::compile(_until_expr, _program_labels, error);
+      if (!_until.has_value()) {
+         if (_hack_state.load(std::memory_order_relaxed) == State::RunningUntil) {
+            _hack_state.store(State::Stopped, std::memory_order_relaxed);
+         }
+         _logs.push(LogType::Error,
+             std::format("Stop condition no longer valid: {}.", error).c_str());
+      }
+   }
+}
+
+void ViewCtx::apply_pending_until() {
+   std::optional<std::string> expr = std::nullopt;
+   {
+      std::lock_guard lock { _program_mutex };
+      expr.swap(_pending_until);
+   }
+
+   if (!expr.has_value()) {
+      return;
+   }
+
+   std::string error { };
+   _until = Predicate::compile(expr.value(), _program_labels, error);
+   if (!_until.has_value()) {
+      _logs.push(LogType::Error, std::format("Invalid stop condition: {}.", error).c_str());
+      return;
+   }
+   _until_expr = std::move(expr.value());
+
+   _hack_state.store(State::RunningUntil, std::memory_order_relaxed);
 }
 
-ViewCtx::~ViewCtx() { glDeleteTextures(1, &_hack_screen_tex); }
+void ViewCtx::update_keyboard() {
+   auto &keyboard_mem = _hack.get_keyboard_mmap();
+   while (auto event = _ctx->key_events.try_pop()) {
+      keyboard_mem = event->key;
+   }
+}
+
+// The keys typed since the last batch are applied before any of its cycles run, so the program
+// sees them right away. When several were typed each one gets an equal slice of the batch, in
+// order, so a key that was pressed and released in between batches is still seen.
+// Each key is only taken off the queue once its slice starts, if `run` stops early the keys
+// after that point stay queued for the next batch.
+template <typename Run> void ViewCtx::run_with_input(std::uint64_t cycles, Run &&run) {
+   const std::uint64_t now = SDL_GetTicksNS();
+
+   std::size_t key_count = 0;
+   while (auto event = _ctx->key_events.peek(key_count)) {
+      // typed after this batch started, it belongs to the next one
+      if (event->timestamp > now) {
+         break;
+      }
+      ++key_count;
+   }
+
+   if (key_count == 0) {
+      run(cycles);
+      return;
+   }
+
+   auto &keyboard_mem = _hack.get_keyboard_mmap();
+   std::uint64_t done = 0;
+   for (std::size_t i = 0; i < key_count; i++) {
+      // only this thread pops, so the keys counted above are still there
+      keyboard_mem = _ctx->key_events.front()->key;
+      _ctx->key_events.pop();
+
+      const std::uint64_t slice = i + 1 == key_count ? cycles - done : cycles / key_count;
+      if (slice > 0 && !run(slice)) {
+         return;
+      }
+      done += slice;
+   }
+}
+
+void ViewCtx::capture_screen() {
+   std::lock_guard lock { _recorder_mutex };
+   if (_recorder) {
+      _recorder->capture(_hack.get_screen_mmap());
+   }
+}
+
+void ViewCtx::toggle_recording() {
+   std::lock_guard lock { _recorder_mutex };
+   if (_recorder) {
+      // waits for the queued frames to be written
+      _recorder.reset();
+      _logs.push(LogType::Success, "Recording saved.");
+      return;
+   }
+
+   const auto seconds = chrono::duration_cast<chrono::seconds>(
+       chrono::system_clock::now().time_since_epoch())
+                            .count();
+   const auto path = fs::current_path() / std::format("n2t-recording-{}.png", seconds);
+   auto recorder = std::make_unique<ScreenRecorder>(path, gui::FRAME_PER_SECOND);
+   if (!recorder->is_open()) {
+      _logs.push(LogType::Error, "Failed to create the recording file.");
+      return;
+   }
+
+   _recorder = std::move(recorder);
+   _logs.push(LogType::Success, std::format("Recording to {}.", path.string()).c_str());
+}
+
+bool ViewCtx::hack_running() const {
+   auto state = _hack_state.load(std::memory_order_relaxed);
+   return state == State::Running || state == State::RunningUntil;
+}
+
+ViewCtx::~ViewCtx() {
+   // the worker may still be capturing frames into the recording
+   _hack_worker.request_stop();
+   _hack_worker.join();
+   glDeleteTextures(1, &_hack_screen_tex);
+}
 
 std::string_view ViewCtx::view_name() const { return "CPU Simulator"; }
 
@@ -215,6 +572,10 @@ void ViewCtx::clear_hack_memory(MemoryViewType type) {
       break;
    case MemoryViewType::ROM:
       std::fill(_hack.instruction_mem.begin(), _hack.instruction_mem.end(), 0);
+      {
+         std::lock_guard lock { _program_mutex };
+         _source_map.reset();
+      }
       break;
    case MemoryViewType::Count:
       break;
@@ -382,24 +743,39 @@ void ViewCtx::show_memory_view(MemoryViewType type, int default_height) {
       ImGui::PopID();
    }
 
-   auto render_memory = [hack_mem, type](std::uint16_t idx) {
+   const bool extended_isa = _extended_isa;
+   const bool asm_loaded = _asm_loaded;
+   std::shared_ptr<const assembly::SourceMap> source_map { };
+   if (type == MemoryViewType::ROM) {
+      std::lock_guard lock { _program_mutex };
+      source_map = _source_map;
+   }
+   auto render_memory
+       = [this, hack_mem, type, extended_isa, asm_loaded, &source_map](std::uint16_t idx) {
       char input_buf[16] = { };
 
       switch (curr_view_opt[static_cast<int>(type)]) {
       case MemoryViewOption::Asm: {
-         auto inst_opt = assembly::disassemble(hack_mem[idx]);
+         auto inst_opt = assembly::disassemble(hack_mem[idx], extended_isa);
          auto inst_val = inst_opt.has_value() ? inst_opt.value() : "(invalid asm)";
          strncpy(input_buf, inst_val.c_str(), inst_val.size());
          // TODO: find out why wrong input causes program to stall
          if (ImGui::InputText("%s", input_buf, sizeof(input_buf), ImGuiInputTextFlags_EnterReturnsTrue)) {
-            auto assembled_input_opt = assembly::assemble(input_buf);
-            if (assembled_input_opt.has_value()) {
+            // the program's source is edited instead, so that its labels can be used
+            if (type == MemoryViewType::ROM && asm_loaded) {
+               std::lock_guard lock { _program_mutex };
+               _pending_rom_edits.push_back({ .pc = idx, .text = input_buf });
+            } else if (auto assembled_input_opt = assembly::assemble(input_buf, extended_isa);
+                assembled_input_opt.has_value()) {
                auto assembled_input = assembled_input_opt.value();
                if (assembled_input.size() == 1) {
                   hack_mem[idx] = assembled_input.front();
                }
             }
          }
+         if (source_map && idx < source_map->size() && ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("%s", source_map->describe(idx).c_str());
+         }
       } break;
 
       case MemoryViewOption::Bin: {
@@ -453,14 +829,14 @@ void ViewCtx::show_memory_view(MemoryViewType type, int default_height) {
    static auto prev_addr = -1;
    switch (type) {
    case MemoryViewType::ROM:
-      if (_hack_state != State::Running && prev_pc != _hack.pc) {
+      if (!hack_running() && prev_pc != _hack.pc) {
          _rom_viewer.set_scroll(_hack.pc);
          prev_pc = _hack.pc;
       }
       _rom_viewer.show("##rom-viewer", default_height, render_memory);
       break;
    case MemoryViewType::RAM:
-      if (_hack_state != State::Running && prev_addr != _hack.address_reg) {
+      if (!hack_running() && prev_addr != _hack.address_reg) {
          _ram_viewer.set_scroll(_hack.address_reg);
          prev_addr = _hack.address_reg;
       }
@@ -477,7 +853,7 @@ void ViewCtx::show_memory_view(MemoryViewType type, int default_height) {
       prev_addr = -1;
    }
 
-   if (_hack_state != State::Off && _hack_state != State::Running) {
+   if (_hack_state != State::Off && !hack_running()) {
       _rom_viewer.show_active_address = true;
       _ram_viewer.show_active_address = true;
    } else {
@@ -494,7 +870,7 @@ void ViewCtx::show_hack_registers() {
 
    if (ImGui::BeginTable("hack-registers", 3, 0, ImVec2(300, 0))) {
       ImGuiInputTextFlags input_flags = ImGuiInputTextFlags_EnterReturnsTrue;
-      if (_hack_state == State::Running) {
+      if (hack_running()) {
          input_flags |= ImGuiInputTextFlags_ReadOnly;
       }
 
@@ -531,20 +907,66 @@ void ViewCtx::show_top_bar() {
       }
    }
    ImGui::SameLine();
+   bool has_program = false;
+   {
+      std::lock_guard lock { _program_mutex };
+      has_program = _program_path.has_value();
+   }
+   ImGui::BeginDisabled(!has_program);
+   if (ImGui::Button("Hot Reload")) {
+      _hot_reload_requested = true;
+   }
+   ImGui::SetItemTooltip("Reload the program from disk while keeping RAM and registers");
+   ImGui::EndDisabled();
+   ImGui::SameLine();
    if (ImGui::Button("Single Step")) {
       _hack_state = State::StepThrough;
    }
    ImGui::SameLine();
-   if (ImGui::Button(_hack_state != State::Running ? "Run" : "Stop")) {
-      _hack_state = _hack_state == State::Running ? State::Stopped : State::Running;
+   if (ImGui::Button(!hack_running() ? "Run" : "Stop")) {
+      _hack_state = hack_running() ? State::Stopped : State::Running;
    }
    ImGui::SameLine();
+   if (ImGui::Button("Run Until")) {
+      std::lock_guard lock { _program_mutex };
+      _pending_until = _until_buf;
+   }
+   ImGui::SameLine();
+   ImGui::SetNextItemWidth(200);
+   ImGui::InputTextWithHint(
+       "##run-until", "e.g. RAM[0]==5 && PC==@END", _until_buf, sizeof(_until_buf));
+   ImGui::SameLine();
    if (ImGui::Button("Reset")) {
       _hack_state = State::Reset;
    }
    ImGui::SameLine();
+   bool recording = false;
+   {
+      std::lock_guard lock { _recorder_mutex };
+      recording = _recorder != nullptr;
+   }
+   if (ImGui::Button(recording ? "Stop Recording" : "Record")) {
+      toggle_recording();
+   }
+   ImGui::SetItemTooltip("Record the screen into an animated PNG in the working directory");
+   ImGui::SameLine();
    ImGui::Button("Load Script");
 
+   ImGui::SameLine();
+   bool fast_loops = _fast_loops;
+   if (ImGui::Checkbox("Fast Loops", &fast_loops)) {
+      _fast_loops = fast_loops;
+   }
+   ImGui::SetItemTooltip("Run common loops such as screen fills natively, Run Until isn't affected");
+
+   ImGui::SameLine();
+   bool extended_isa = _extended_isa;
+   if (ImGui::Checkbox("Extended ISA", &extended_isa)) {
+      _extended_isa = extended_isa;
+   }
+   ImGui::SetItemTooltip("Enable the non-standard D*A and D*M instructions, reload .asm programs to "
+                         "use them");
+
    ImGui::SameLine();
    ImGui::TextUnformatted("CPU Speed:");
    ImGui::SameLine();
@@ -1,12 +1,18 @@
 #ifndef N2T_GUI_CPU_HPP
 #define N2T_GUI_CPU_HPP
 
+#include "../asm/asm.hpp"
+#include "../hack/capture.hpp"
 #include "../hack/hack.hpp"
+#include "../hack/idiom.hpp"
+#include "../hack/predicate.hpp"
 #include "gui.hpp"
 #include "widget/log.hpp"
 #include "widget/memory_viewer.hpp"
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_opengl.h>
+#include <memory>
+#include <mutex>
 #include <thread>
 
 namespace gui::cpu {
@@ -38,11 +44,30 @@ enum class SearchType {
 enum class State {
    Off,
    Running,
+   // running until the stop condition holds
+   RunningUntil,
    Stopped,
    StepThrough,
    Reset,
 };
 
+// a program read from disk that's waiting to be loaded into the emulator
+struct PendingProgram {
+   std::vector<std::uint16_t> rom;
+   // empty when the program was loaded from a `.hack` file
+   assembly::Labels labels;
+   // patches the loaded ROM instead of replacing it, keeping RAM and registers intact
+   bool hot_reload;
+   // only for `.hack` files with the `.hack.map` of `asm -g` next to them
+   std::shared_ptr<const assembly::SourceMap> source_map { };
+};
+
+// an instruction typed into the ROM viewer while an `.asm` program is loaded
+struct RomEdit {
+   std::uint16_t pc;
+   std::string text;
+};
+
 class ViewCtx final : public gui::BaseView {
    gui::Context *_ctx;
    widget::Log _logs;
@@ -56,6 +81,57 @@ class ViewCtx final : public gui::BaseView {
    float _hack_speed = 1.0f;
    std::jthread _hack_worker, _dialog_worker;
 
+   // programs are only ever swapped by `_hack_worker` in between ticks
+   std::mutex _program_mutex;
+   std::optional<PendingProgram> _pending_program;
+   std::optional<fs::path> _program_path;
+   std::atomic<bool> _hot_reload_requested = false;
+   // keeps the loaded `.asm` program assembled so that hot reloads and edits in the ROM viewer
+   // only reassemble the lines that changed, only accessed by `_dialog_worker`
+   std::optional<assembly::AssemblySession> _asm_session;
+   // source of the loaded program when it was taken from `_program_cache` instead, only accessed by
+   // `_dialog_worker`
+   std::optional<std::string> _cached_source;
+   assembly::ProgramCache _program_cache;
+   // whether `_asm_session` (or `_cached_source`) holds the program that's loaded
+   std::atomic<bool> _asm_loaded = false;
+   // edits made in the ROM viewer, applied to `_asm_session` by `_dialog_worker`
+   std::vector<RomEdit> _pending_rom_edits;
+   // labels of the currently loaded program, only accessed by `_hack_worker`
+   assembly::Labels _program_labels;
+   // source map of the currently loaded program, shown by the ROM viewer
+   std::shared_ptr<const assembly::SourceMap> _source_map;
+   // loops found in the currently loaded program, only accessed by `_hack_worker`
+   IdiomEngine _idioms;
+   std::atomic<bool> _fast_loops = false;
+   // multiply extension, applied to programs assembled afterwards and to `_hack` every frame
+   std::atomic<bool> _extended_isa = false;
+   // stop condition typed by the user, it's compiled by `_hack_worker` against the program's labels
+   char _until_buf[128] = { };
+   std::optional<std::string> _pending_until;
+   std::optional<Predicate> _until;
+   // the expression `_until` was compiled from, it's compiled again whenever the labels change
+   std::string _until_expr;
+
+   // captures the screen after every frame the emulator runs
+   std::mutex _recorder_mutex;
+   std::unique_ptr<ScreenRecorder> _recorder;
+
+   std::optional<PendingProgram> read_program(const fs::path &filepath, bool hot_reload);
+   std::optional<PendingProgram> session_program();
+   std::optional<PendingProgram> apply_rom_edits(std::span<const RomEdit> edits);
+   void apply_pending_program();
+   void apply_pending_until();
+   // applies all the queued key events right away
+   void update_keyboard();
+   // runs `cycles` cycles in chunks through `run(chunk)`, applying the queued key events before
+   // the cycles they belong to. `run` returns false to stop early, the key events that weren't
+   // reached yet stay queued.
+   template <typename Run> void run_with_input(std::uint64_t cycles, Run &&run);
+   void capture_screen();
+   void toggle_recording();
+   bool hack_running() const;
+
    void show_top_bar();
    void show_hack_screen();
    void show_memory_view(MemoryViewType type, int default_height);
@@ -1,10 +1,12 @@
 #ifndef N2T_GUI_HPP
 #define N2T_GUI_HPP
 
+#include "../spsc_queue.hpp"
 #include "imgui.h"
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_opengl.h>
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <memory>
 #include <mutex>
@@ -19,6 +21,8 @@ namespace gui {
 
 constexpr int FRAME_PER_SECOND = 60;
 constexpr auto TIME_PER_FRAME = chrono::milliseconds(1000 / FRAME_PER_SECOND);
+// most key events waiting to be applied, later ones are dropped
+constexpr std::size_t KEY_EVENT_CAPACITY = 256;
 
 // begins tracking of frame time
 void start_frame();
@@ -47,6 +51,13 @@ class BaseView {
    virtual ~BaseView() = default;
 };
 
+// a key press or release, `key` is the Hack key code or 0 when the key was released
+struct KeyEvent {
+   // when it happened, on the `SDL_GetTicksNS` clock
+   std::uint64_t timestamp;
+   std::uint16_t key;
+};
+
 class Context final {
    SDL_Window *_window;
    std::vector<std::unique_ptr<BaseView>> _views;
@@ -60,8 +71,9 @@ class Context final {
    explicit Context(SDL_Window *window);
 
    ImFont *monofont = nullptr;
-   // keyboard key captured
-   std::atomic<std::optional<SDL_Keycode>> key;
+   // keyboard events in the order they happened, pushed by the main thread and consumed by the
+   // view running the emulator. Events are dropped while the queue is full.
+   SpscQueue<KeyEvent, gui::KEY_EVENT_CAPACITY> key_events;
    void set_styling();
 
    // ==== DIALOG API
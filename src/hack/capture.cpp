@@ -0,0 +1,241 @@
+#include "capture.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+constexpr std::uint32_t SCREEN_WIDTH = 512, SCREEN_HEIGHT = 256;
+// every row starts with the PNG filter type followed by 1 bit per pixel
+constexpr std::size_t ROW_SIZE = 1 + SCREEN_WIDTH / 8;
+constexpr std::size_t IMAGE_SIZE = ROW_SIZE * SCREEN_HEIGHT;
+static_assert(IMAGE_SIZE <= 0xFFFF, "a frame has to fit in a single stored deflate block");
+
+constexpr std::array<std::uint32_t, 256> crc_table = [] {
+   std::array<std::uint32_t, 256> table { };
+   for (std::uint32_t i = 0; i < table.size(); i++) {
+      std::uint32_t crc = i;
+      for (int bit = 0; bit < 8; bit++) {
+         crc = crc & 1 ? 0xEDB88320 ^ (crc >> 1) : crc >> 1;
+      }
+      table[i] = crc;
+   }
+   return table;
+}();
+
+// Hack pixels go from the least to the most significant bit while PNG goes the other way around
+constexpr std::array<std::uint8_t, 256> reversed_bits = [] {
+   std::array<std::uint8_t, 256> table { };
+   for (std::size_t i = 0; i < table.size(); i++) {
+      std::uint8_t reversed = 0;
+      for (int bit = 0; bit < 8; bit++) {
+         if (i & (1 << bit)) {
+            reversed |= 1 << (7 - bit);
+         }
+      }
+      table[i] = reversed;
+   }
+   return table;
+}();
+
+static std::uint32_t crc32(std::uint32_t crc, std::span<const std::uint8_t> data) {
+   for (auto byte : data) {
+      crc = crc_table[(crc ^ byte) & 0xFF] ^ (crc >> 8);
+   }
+   return crc;
+}
+
+static void push_u32(std::vector<std::uint8_t> &buf, std::uint32_t value) {
+   buf.push_back(value >> 24);
+   buf.push_back(value >> 16);
+   buf.push_back(value >> 8);
+   buf.push_back(value);
+}
+
+static void push_u16(std::vector<std::uint8_t> &buf, std::uint16_t value) {
+   buf.push_back(value >> 8);
+   buf.push_back(value);
+}
+
+ScreenRecorder::ScreenRecorder(const std::filesystem::path &path, std::uint16_t fps)
+    : m_file { path, std::ios::binary }
+    , m_fps { fps } {
+   m_open = m_file.is_open();
+   if (!m_open) {
+      return;
+   }
+
+   write_header();
+   m_writer = std::jthread([this] { write_loop(); });
+}
+
+ScreenRecorder::~ScreenRecorder() { finish(); }
+
+bool ScreenRecorder::is_open() const { return m_open; }
+
+void ScreenRecorder::capture(std::span<const std::uint16_t, 8192> screen) {
+   if (!m_writer.joinable()) {
+      return;
+   }
+
+   {
+      std::lock_guard lock { m_queue_mutex };
+      if (m_finished) {
+         return;
+      }
+      auto &frame = m_queue.emplace_back();
+      std::copy(screen.begin(), screen.end(), frame.begin());
+   }
+   m_queue_cv.notify_one();
+}
+
+void ScreenRecorder::finish() {
+   {
+      std::lock_guard lock { m_queue_mutex };
+      m_finished = true;
+   }
+   m_queue_cv.notify_one();
+
+   if (m_writer.joinable()) {
+      m_writer.join();
+   }
+}
+
+void ScreenRecorder::write_loop() {
+   bool has_frame = false;
+   std::deque<ScreenFrame> frames { };
+
+   for (;;) {
+      {
+         std::unique_lock lock { m_queue_mutex };
+         m_queue_cv.wait(lock, [this] { return !m_queue.empty() || m_finished; });
+         if (m_queue.empty()) {
+            break;
+         }
+         frames.swap(m_queue);
+      }
+
+      for (const auto &frame : frames) {
+         if (has_frame && frame == m_last_frame && m_last_frame_repeats < 0xFFFF) {
+            ++m_last_frame_repeats;
+            continue;
+         }
+
+         if (has_frame) {
+            write_frame(m_last_frame, m_last_frame_repeats);
+         }
+         m_last_frame = frame;
+         m_last_frame_repeats = 1;
+         has_frame = true;
+      }
+      frames.clear();
+   }
+
+   // an APNG needs at least one frame to be valid
+   write_frame(m_last_frame, std::max<std::uint32_t>(m_last_frame_repeats, 1));
+   write_trailer();
+}
+
+void ScreenRecorder::write_chunk(std::string_view type, std::span<const std::uint8_t> data) {
+   std::vector<std::uint8_t> header { };
+   push_u32(header, data.size());
+   header.insert(header.end(), type.begin(), type.end());
+
+   std::uint32_t crc = crc32(0xFFFFFFFF, std::span(header).subspan(4));
+   crc = crc32(crc, data) ^ 0xFFFFFFFF;
+
+   std::vector<std::uint8_t> footer { };
+   push_u32(footer, crc);
+
+   m_file.write(reinterpret_cast<const char *>(header.data()), header.size());
+   m_file.write(reinterpret_cast<const char *>(data.data()), data.size());
+   m_file.write(reinterpret_cast<const char *>(footer.data()), footer.size());
+}
+
+static std::vector<std::uint8_t> animation_control(std::uint32_t frame_count) {
+   std::vector<std::uint8_t> actl { };
+   push_u32(actl, frame_count);
+   // loop forever
+   push_u32(actl, 0);
+   return actl;
+}
+
+void ScreenRecorder::write_header() {
+   constexpr std::array<std::uint8_t, 8> signature { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+   m_file.write(reinterpret_cast<const char *>(signature.data()), signature.size());
+
+   std::vector<std::uint8_t> ihdr { };
+   push_u32(ihdr, SCREEN_WIDTH);
+   push_u32(ihdr, SCREEN_HEIGHT);
+   ihdr.push_back(1); // bit depth
+   ihdr.push_back(0); // grayscale
+   ihdr.push_back(0); // deflate
+   ihdr.push_back(0); // adaptive filtering
+   ihdr.push_back(0); // no interlacing
+   write_chunk("IHDR", ihdr);
+
+   // the frame count is only known once recording finishes
+   m_actl_pos = m_file.tellp();
+   write_chunk("acTL", animation_control(0));
+}
+
+void ScreenRecorder::write_frame(const ScreenFrame &frame, std::uint16_t duration) {
+   std::vector<std::uint8_t> fctl { };
+   push_u32(fctl, m_sequence++);
+   push_u32(fctl, SCREEN_WIDTH);
+   push_u32(fctl, SCREEN_HEIGHT);
+   push_u32(fctl, 0); // x offset
+   push_u32(fctl, 0); // y offset
+   push_u16(fctl, duration);
+   push_u16(fctl, m_fps);
+   fctl.push_back(0); // dispose op: none
+   fctl.push_back(0); // blend op: source
+   write_chunk("fcTL", fctl);
+
+   std::vector<std::uint8_t> data { };
+   data.reserve(4 + 2 + 5 + IMAGE_SIZE + 4);
+   if (m_frame_count > 0) {
+      push_u32(data, m_sequence++);
+   }
+   const std::size_t zlib_start = data.size();
+
+   // zlib header without compression followed by a single final stored block
+   data.push_back(0x78);
+   data.push_back(0x01);
+   data.push_back(0x01);
+   data.push_back(IMAGE_SIZE & 0xFF);
+   data.push_back(IMAGE_SIZE >> 8);
+   data.push_back(~IMAGE_SIZE & 0xFF);
+   data.push_back((~IMAGE_SIZE >> 8) & 0xFF);
+
+   const std::size_t image_start = data.size();
+   for (std::size_t y = 0; y < SCREEN_HEIGHT; y++) {
+      data.push_back(0); // filter: none
+      for (std::size_t x_chunk = 0; x_chunk < SCREEN_WIDTH / 16; x_chunk++) {
+         std::uint16_t chunk = frame[y * 32 + x_chunk];
+         data.push_back(reversed_bits[chunk & 0xFF]);
+         data.push_back(reversed_bits[chunk >> 8]);
+      }
+   }
+
+   std::uint32_t a = 1, b = 0;
+   for (std::size_t i = image_start; i < data.size(); i++) {
+      a = (a + data[i]) % 65521;
+      b = (b + a) % 65521;
+   }
+   push_u32(data, (b << 16) | a);
+
+   if (m_frame_count == 0) {
+      write_chunk("IDAT", std::span(data).subspan(zlib_start));
+   } else {
+      write_chunk("fdAT", data);
+   }
+   ++m_frame_count;
+}
+
+void ScreenRecorder::write_trailer() {
+   write_chunk("IEND", { });
+
+   m_file.seekp(m_actl_pos);
+   write_chunk("acTL", animation_control(m_frame_count));
+   m_file.close();
+}
@@ -0,0 +1,64 @@
+#ifndef HACK_CAPTURE_HPP
+#define HACK_CAPTURE_HPP
+
+#include "hack.hpp"
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <span>
+#include <thread>
+
+using ScreenFrame = std::array<std::uint16_t, 8192>;
+
+// Records the Hack screen into an animated PNG.
+//
+// Frames are stored as 1-bit grayscale images in uncompressed deflate blocks, around 16KB each.
+// A frame identical to the previous one isn't written again, instead the previous frame is shown
+// for longer, so static screens cost nothing.
+// `capture` only copies the screen into a queue, encoding and writing happen on a background thread.
+class ScreenRecorder final {
+   std::ofstream m_file;
+   const std::uint16_t m_fps;
+   bool m_open { false };
+
+   std::mutex m_queue_mutex;
+   std::condition_variable m_queue_cv;
+   std::deque<ScreenFrame> m_queue { };
+   bool m_finished { false };
+
+   // only accessed by the writer thread
+   ScreenFrame m_last_frame { };
+   std::uint32_t m_last_frame_repeats { 0 };
+   std::uint32_t m_frame_count { 0 }, m_sequence { 0 };
+   std::streampos m_actl_pos { };
+
+   std::jthread m_writer;
+
+   void write_loop();
+   void write_header();
+   void write_frame(const ScreenFrame &frame, std::uint16_t duration);
+   void write_chunk(std::string_view type, std::span<const std::uint8_t> data);
+   void write_trailer();
+
+   public:
+   // `fps` is the rate at which `capture` is going to be called
+   explicit ScreenRecorder(const std::filesystem::path &path, std::uint16_t fps = 60);
+   ~ScreenRecorder();
+
+   ScreenRecorder(const ScreenRecorder &) = delete;
+   ScreenRecorder &operator=(const ScreenRecorder &) = delete;
+
+   bool is_open() const;
+
+   // queues a snapshot of `screen` as the next frame
+   void capture(std::span<const std::uint16_t, 8192> screen);
+
+   // writes the remaining frames and closes the file, capturing afterwards does nothing
+   void finish();
+};
+
+#endif
@@ -1,5 +1,5 @@
+#include "../isa.hpp"
 #include "hack.hpp"
-#include <SDL3/SDL.h>
 #include <algorithm>
 #include <array>
 #include <cstdint>
@@ -8,168 +8,20 @@
 #include <string>
 #include <vector>
 
-std::uint16_t convert_input_to_hack(SDL_Keycode key) {
-   switch (key) {
-   case SDLK_SPACE:
-      return 32;
-   case SDLK_0:
-      return 48;
-   case SDLK_1:
-      return 49;
-   case SDLK_2:
-      return 50;
-   case SDLK_3:
-      return 51;
-   case SDLK_4:
-      return 52;
-   case SDLK_5:
-      return 53;
-   case SDLK_6:
-      return 54;
-   case SDLK_7:
-      return 55;
-   case SDLK_8:
-      return 56;
-   case SDLK_9:
-      return 57;
-   case SDLK_A:
-      return 65;
-   case SDLK_B:
-      return 66;
-   case SDLK_C:
-      return 67;
-   case SDLK_D:
-      return 68;
-   case SDLK_E:
-      return 69;
-   case SDLK_F:
-      return 70;
-   case SDLK_G:
-      return 71;
-   case SDLK_H:
-      return 72;
-   case SDLK_I:
-      return 73;
-   case SDLK_J:
-      return 74;
-   case SDLK_K:
-      return 75;
-   case SDLK_L:
-      return 76;
-   case SDLK_M:
-      return 77;
-   case SDLK_N:
-      return 78;
-   case SDLK_O:
-      return 79;
-   case SDLK_P:
-      return 80;
-   case SDLK_Q:
-      return 81;
-   case SDLK_R:
-      return 82;
-   case SDLK_S:
-      return 83;
-   case SDLK_T:
-      return 84;
-   case SDLK_U:
-      return 85;
-   case SDLK_V:
-      return 86;
-   case SDLK_W:
-      return 87;
-   case SDLK_X:
-      return 88;
-   case SDLK_Y:
-      return 89;
-   case SDLK_Z:
-      return 90;
-
-   case SDLK_RETURN:
-      return 128;
-   case SDLK_BACKSPACE:
-      return 129;
-   case SDLK_LEFT:
-      return 130;
-   case SDLK_UP:
-      return 131;
-   case SDLK_RIGHT:
-      return 132;
-   case SDLK_DOWN:
-      return 133;
-   case SDLK_HOME:
-      return 134;
-   case SDLK_END:
-      return 135;
-   case SDLK_PAGEUP:
-      return 136;
-   case SDLK_PAGEDOWN:
-      return 137;
-   case SDLK_INSERT:
-      return 138;
-   case SDLK_DELETE:
-      return 139;
-   case SDLK_ESCAPE:
-      return 140;
-   case SDLK_F1:
-      return 141;
-   case SDLK_F2:
-      return 142;
-   case SDLK_F3:
-      return 143;
-   case SDLK_F4:
-      return 144;
-   case SDLK_F5:
-      return 145;
-   case SDLK_F6:
-      return 146;
-   case SDLK_F7:
-      return 147;
-   case SDLK_F8:
-      return 148;
-   case SDLK_F9:
-      return 149;
-   case SDLK_F10:
-      return 150;
-   case SDLK_F11:
-      return 151;
-   case SDLK_F12:
-      return 152;
-
-   default:
-      return 0;
-   }
+static void panic_on_invalid_instruction(std::uint16_t pc, std::uint16_t instruction) {
+   auto inst_str = std::to_string(instruction);
+   throw std::format("Invalid instruction reached at pc = {} with value: `{}`", pc, inst_str);
 }
 
-void Hack::draw_screen(SDL_Renderer *renderer, SDL_Texture *texture) {
-   auto screen = get_screen_mmap();
-
-   std::array<Uint32, 512 * 256> pixels;
-   std::fill(pixels.begin(), pixels.end(), 0x000000FF);
-
-   for (std::size_t y = 0; y < 256; ++y) {
-      for (std::size_t x_chunk = 0; x_chunk < 32; ++x_chunk) {
-         std::uint16_t chunk = screen[y * 32 + x_chunk];
-         for (std::size_t i = 0; i < 16; ++i) {
-            if (chunk & (1 << i)) {
-               pixels.at(y * 512 + (x_chunk * 16 + i)) = 0xFFFFFFFF;
-            }
-         }
-      }
-   }
-
-   SDL_UpdateTexture(texture, nullptr, pixels.data(), 512 * sizeof(Uint32));
-   SDL_RenderClear(renderer);
-   SDL_RenderTexture(renderer, texture, nullptr, nullptr);
-   SDL_RenderPresent(renderer);
+static void panic_on_out_of_range_access(std::uint16_t pc, std::uint16_t address) {
+   throw std::format("Out of range memory access at pc = {} with A = {}", pc, address);
 }
 
-static void panic_on_invalid_instruction(std::uint16_t pc, std::uint16_t instruction) {
-   auto inst_str = std::to_string(instruction);
-   throw std::format("Invalid instruction reached at pc = {} with value: `{}`", pc, inst_str);
+static void panic_on_out_of_range_pc(std::uint16_t pc) {
+   throw std::format("Out of range instruction fetch at pc = {}, past the end of ROM", pc);
 }
 
-bool Hack::load_rom(std::vector<uint16_t> &instructions) {
+bool Hack::load_rom(std::span<const std::uint16_t> instructions) {
    if (instructions.size() > instruction_mem.size()) {
       return false;
    }
@@ -179,13 +31,30 @@ bool Hack::load_rom(std::vector<uint16_t> &instructions) {
    return true;
 }
 
+std::optional<std::size_t> Hack::patch_rom(std::span<const std::uint16_t> instructions) {
+   if (instructions.size() > instruction_mem.size()) {
+      return std::nullopt;
+   }
+
+   std::size_t changed = 0;
+   for (std::size_t i = 0; i < instruction_mem.size(); i++) {
+      std::uint16_t inst = i < instructions.size() ? instructions[i] : 0;
+      if (instruction_mem[i] != inst) {
+         instruction_mem[i] = inst;
+         ++changed;
+      }
+   }
+
+   return changed;
+}
+
 // retrieves a span of the memory mapped screen buffer
 ScreenSpan Hack::get_screen_mmap() {
    ScreenSpan mmap { &data_mem.at(16384), 8192 };
    return mmap;
 }
 
-bool Hack::load_rom(std::string_view instructions) {
+std::optional<std::vector<std::uint16_t>> parse_rom(std::string_view instructions) {
    std::vector<std::uint16_t> bin_insts { };
    std::stringstream inststream { std::string(instructions) };
 
@@ -195,303 +64,236 @@ bool Hack::load_rom(std::string_view instructions) {
          auto inst = std::stoull(tmp, nullptr, 2);
          bin_insts.push_back(inst);
       } catch (...) {
-         return false;
+         return std::nullopt;
       }
    }
 
-   return this->load_rom(bin_insts);
+   return bin_insts;
+}
+
+bool Hack::load_rom(std::string_view instructions) {
+   auto bin_insts = parse_rom(instructions);
+   if (!bin_insts.has_value()) {
+      return false;
+   }
+
+   return this->load_rom(bin_insts.value());
 }
 
 std::uint16_t &Hack::get_keyboard_mmap() { return data_mem.at(24576); }
 
-// Throws an exception if an invalid instruction is ever reached
-void Hack::tick() {
-   auto inst = instruction_mem.at(pc);
-   ++pc;
+bool Hack::attach_device(std::uint16_t start, std::uint16_t end, Device &device) {
+   if (start > end || end >= data_mem.size()) {
+      return false;
+   }
 
-   bool is_a_instruction = (inst & (1 << 15)) == 0;
-   std::uint16_t a_inst_mask = 0b0111111111111111;
-   std::uint16_t c_inst_mask = 0b0001111111111111;
+   for (const auto &mapped : devices) {
+      if (start <= mapped.end && mapped.start <= end) {
+         return false;
+      }
+   }
 
-   if (is_a_instruction) {
-      address_reg = inst & a_inst_mask;
-      return;
+   devices.push_back({ .start = start, .end = end, .device = &device });
+   for (std::size_t page = start / DEVICE_PAGE_SIZE; page <= end / DEVICE_PAGE_SIZE; page++) {
+      device_pages[page] = true;
    }
 
-   inst &= c_inst_mask;
-   std::uint16_t a = (inst >> 12) & 1;
-   std::uint16_t comp = (inst >> 6) & 0b111111;
-   std::uint16_t dest = (inst >> 3) & 0b111;
-   std::uint16_t jump = inst & 0b111;
+   return true;
+}
 
-   std::uint16_t comp_result = 0;
-   switch (comp) {
-      // 0
-   case 0b101010:
-      if (!a) {
-         comp_result = 0;
-      } else {
-         panic_on_invalid_instruction(pc, inst);
-      }
-      break;
+void Hack::detach_device(Device &device) {
+   std::erase_if(devices, [&device](const MappedDevice &mapped) { return mapped.device == &device; });
 
-      // 1
-   case 0b111111:
-      if (!a) {
-         comp_result = 1;
-      } else {
-         panic_on_invalid_instruction(pc, inst);
+   std::fill(device_pages.begin(), device_pages.end(), false);
+   for (const auto &mapped : devices) {
+      for (std::size_t page = mapped.start / DEVICE_PAGE_SIZE; page <= mapped.end / DEVICE_PAGE_SIZE;
+           page++) {
+         device_pages[page] = true;
       }
-      break;
+   }
+}
 
-      // -1
-   case 0b111010:
-      if (!a) {
-         comp_result = -1;
-      } else {
-         panic_on_invalid_instruction(pc, inst);
+static Device *find_device(std::span<const MappedDevice> devices, std::uint16_t address) {
+   for (const auto &mapped : devices) {
+      if (mapped.start <= address && address <= mapped.end) {
+         return mapped.device;
       }
-      break;
+   }
 
-      // D
-   case 0b001100:
-      if (!a) {
-         comp_result = data_reg;
-      } else {
-         panic_on_invalid_instruction(pc, inst);
-      }
-      break;
+   return nullptr;
+}
 
-      // A or M
-   case 0b110000:
-      if (a) {
-         comp_result = data_mem.at(address_reg);
-      } else {
-         comp_result = address_reg;
-      }
-      break;
+template <MemoryPolicy Policy> std::uint16_t &Hack::memory_cell(std::uint16_t address) {
+   if constexpr (Policy == MemoryPolicy::Masked) {
+      return data_mem[address & 0x7FFF];
+   } else if constexpr (Policy == MemoryPolicy::Unchecked) {
+      // the top bit of the address picks the guard region instead of branching on it
+      std::array<std::uint16_t *, 2> banks { data_mem.data(), guard_mem.data() };
+      return banks[address >> 15][address & 0x7FFF];
+   } else {
+      return data_mem.at(address);
+   }
+}
 
-   // !D
-   case 0b001101:
-      if (!a) {
-         comp_result = ~data_reg;
-      } else {
-         panic_on_invalid_instruction(pc, inst);
-      }
-      break;
+template <MemoryPolicy Policy> std::uint16_t Hack::read_memory(std::uint16_t address) {
+   if constexpr (Policy == MemoryPolicy::Masked) {
+      address &= 0x7FFF;
+   }
 
-   // !A or !M
-   case 0b110001:
-      if (a) {
-         comp_result = ~data_mem.at(address_reg);
-      } else {
-         comp_result = ~address_reg;
+   if (device_pages[address / DEVICE_PAGE_SIZE]) [[unlikely]] {
+      if (auto device = find_device(devices, address)) {
+         return device->read(address);
       }
-      break;
+   }
 
-   // -D
-   case 0b001111:
-      if (!a) {
-         comp_result = -data_reg;
-      } else {
-         panic_on_invalid_instruction(pc, inst);
-      }
-      break;
+   return memory_cell<Policy>(address);
+}
 
-   // -A or -M
-   case 0b110011:
-      if (a) {
-         comp_result = -data_mem.at(address_reg);
-      } else {
-         comp_result = -address_reg;
-      }
-      break;
+template <MemoryPolicy Policy>
+void Hack::write_memory(std::uint16_t address, std::uint16_t value) {
+   if constexpr (Policy == MemoryPolicy::Masked) {
+      address &= 0x7FFF;
+   }
 
-   // D+1
-   case 0b011111:
-      if (!a) {
-         comp_result = data_reg + 1;
-      } else {
-         panic_on_invalid_instruction(pc, inst);
+   if (device_pages[address / DEVICE_PAGE_SIZE]) [[unlikely]] {
+      if (auto device = find_device(devices, address)) {
+         device->write(address, value);
+         return;
       }
-      break;
+   }
 
-   // A+1 or M+1
-   case 0b110111:
-      if (a) {
-         comp_result = data_mem.at(address_reg) + 1;
-      } else {
-         comp_result = address_reg + 1;
-      }
-      break;
+   memory_cell<Policy>(address) = value;
+}
 
-   // D-1
-   case 0b001110:
-      if (!a) {
-         comp_result = data_reg - 1;
-      } else {
-         panic_on_invalid_instruction(pc, inst);
+// Throws an exception if an invalid instruction is ever reached
+template <MemoryPolicy Policy> void Hack::tick() {
+   std::uint16_t inst;
+   if constexpr (Policy == MemoryPolicy::Checked) {
+      if (pc >= instruction_mem.size()) [[unlikely]] {
+         panic_on_out_of_range_pc(pc);
       }
-      break;
+      inst = instruction_mem[pc];
+   } else {
+      inst = instruction_mem[pc & 0x7FFF];
+   }
+   ++pc;
 
-   // A-1 or M-1
-   case 0b110010:
-      if (a) {
-         comp_result = data_mem.at(address_reg) - 1;
-      } else {
-         comp_result = address_reg - 1;
-      }
-      break;
+   bool is_a_instruction = (inst & (1 << 15)) == 0;
+   std::uint16_t a_inst_mask = 0b0111111111111111;
+   std::uint16_t c_inst_mask = 0b0001111111111111;
 
-   // D+A or D+M
-   case 0b000010:
-      if (a) {
-         comp_result = data_reg + data_mem.at(address_reg);
-      } else {
-         comp_result = data_reg + address_reg;
-      }
-      break;
+   if (is_a_instruction) {
+      address_reg = inst & a_inst_mask;
+      return;
+   }
 
-   // D-A or D-M
-   case 0b010011:
-      if (a) {
-         comp_result = data_reg - data_mem.at(address_reg);
-      } else {
-         comp_result = data_reg - address_reg;
-      }
-      break;
+   inst &= c_inst_mask;
+   std::uint16_t a = (inst >> 12) & 1;
+   std::uint16_t dest = (inst >> 3) & 0b111;
+   std::uint16_t jump = inst & 0b111;
 
-   // A-D or M-D
-   case 0b000111:
-      if (a) {
-         comp_result = data_mem.at(address_reg) - data_reg;
-      } else {
-         comp_result = address_reg - data_reg;
+   if constexpr (Policy == MemoryPolicy::Checked) {
+      bool uses_memory = a || (dest & 0b001);
+      if (uses_memory && address_reg >= data_mem.size()) [[unlikely]] {
+         panic_on_out_of_range_access(pc - 1, address_reg);
       }
-      break;
+   }
 
-   // D&A or D&M
-   case 0b000000:
-      if (a) {
-         comp_result = data_reg & data_mem.at(address_reg);
-      } else {
-         comp_result = data_reg & address_reg;
-      }
-      break;
+   // Y is only read when the computation uses it, reading M can have side effects on devices
+   const auto y = [&]() -> std::uint16_t {
+      return a ? read_memory<Policy>(address_reg) : address_reg;
+   };
 
-   // D|A or D|M
-   case 0b010101:
-      if (a) {
-         comp_result = data_reg | data_mem.at(address_reg);
-      } else {
-         comp_result = data_reg | address_reg;
-      }
+   std::uint16_t comp_result = 0;
+   switch (isa::ALU_OPS[(inst >> 6) & 0b1111111]) {
+   case isa::AluOp::Zero:
+      comp_result = 0;
       break;
-
-   default:
-      panic_on_invalid_instruction(pc, inst);
+   case isa::AluOp::One:
+      comp_result = 1;
       break;
-   }
-
-   switch (dest) {
-   // NULL
-   case 0b000:
+   case isa::AluOp::MinusOne:
+      comp_result = -1;
       break;
-
-   // M
-   case 0b001:
-      data_mem.at(address_reg) = comp_result;
+   case isa::AluOp::X:
+      comp_result = data_reg;
       break;
-
-   // D
-   case 0b010:
-      data_reg = comp_result;
+   case isa::AluOp::Y:
+      comp_result = y();
       break;
-
-   // MD
-   case 0b011:
-      data_mem.at(address_reg) = comp_result;
-      data_reg = comp_result;
+   case isa::AluOp::NotX:
+      comp_result = ~data_reg;
       break;
-
-   // A
-   case 0b100:
-      address_reg = comp_result;
+   case isa::AluOp::NotY:
+      comp_result = ~y();
       break;
-
-   // AM
-   case 0b101:
-      data_mem.at(address_reg) = comp_result;
-      address_reg = comp_result;
+   case isa::AluOp::NegX:
+      comp_result = -data_reg;
       break;
-
-   // AD
-   case 0b110:
-      address_reg = comp_result;
-      data_reg = comp_result;
+   case isa::AluOp::NegY:
+      comp_result = -y();
       break;
-
-   // AMD
-   case 0b111:
-      data_mem.at(address_reg) = comp_result;
-      address_reg = comp_result;
-      data_reg = comp_result;
+   case isa::AluOp::IncX:
+      comp_result = data_reg + 1;
       break;
-   }
-
-   // the negative bit is on the penultimate bit because the last bit
-   // is used to indicate whether a 16-bit number is an A-instruction
-   std::uint16_t is_negative = comp_result & (1 << 15);
-   switch (jump) {
-   // NULL
-   case 0b000:
+   case isa::AluOp::IncY:
+      comp_result = y() + 1;
       break;
-
-   // JEQ
-   case 0b010:
-      if (comp_result == 0) {
-         pc = address_reg;
-      }
+   case isa::AluOp::DecX:
+      comp_result = data_reg - 1;
       break;
-
-   // JGT
-   case 0b001:
-      if (comp_result != 0 && !is_negative) {
-         pc = address_reg;
-      }
+   case isa::AluOp::DecY:
+      comp_result = y() - 1;
       break;
-
-   // JGE
-   case 0b011:
-      if (comp_result == 0 || !is_negative) {
-         pc = address_reg;
-      }
+   case isa::AluOp::XPlusY:
+      comp_result = data_reg + y();
       break;
-
-   // JLT
-   case 0b100:
-      if (comp_result != 0 && is_negative) {
-         pc = address_reg;
-      }
+   case isa::AluOp::XMinusY:
+      comp_result = data_reg - y();
       break;
-
-   // JNE
-   case 0b101:
-      if (comp_result != 0) {
-         pc = address_reg;
-      }
+   case isa::AluOp::YMinusX:
+      comp_result = y() - data_reg;
       break;
-
-   // JLE
-   case 0b110:
-      if (comp_result == 0 || is_negative) {
-         pc = address_reg;
+   case isa::AluOp::XAndY:
+      comp_result = data_reg & y();
+      break;
+   case isa::AluOp::XOrY:
+      comp_result = data_reg | y();
+      break;
+   case isa::AluOp::XTimesY:
+      if (!extended_isa) {
+         panic_on_invalid_instruction(pc, inst);
       }
+      // widened first, the promoted int product of two u16 can overflow
+      comp_result = std::uint32_t { data_reg } * y();
+      break;
+   case isa::AluOp::Invalid:
+      panic_on_invalid_instruction(pc, inst);
       break;
+   }
 
-   // JMP
-   case 0b111:
+   // M is written first, while A still holds the address it refers to
+   if (dest & isa::DEST_M) {
+      write_memory<Policy>(address_reg, comp_result);
+   }
+   if (dest & isa::DEST_A) {
+      address_reg = comp_result;
+   }
+   if (dest & isa::DEST_D) {
+      data_reg = comp_result;
+   }
+
+   if (jump & isa::jump_condition(comp_result)) {
       pc = address_reg;
-      break;
    }
 }
+
+template std::uint16_t Hack::read_memory<MemoryPolicy::Checked>(std::uint16_t);
+template std::uint16_t Hack::read_memory<MemoryPolicy::Masked>(std::uint16_t);
+template std::uint16_t Hack::read_memory<MemoryPolicy::Unchecked>(std::uint16_t);
+template void Hack::write_memory<MemoryPolicy::Checked>(std::uint16_t, std::uint16_t);
+template void Hack::write_memory<MemoryPolicy::Masked>(std::uint16_t, std::uint16_t);
+template void Hack::write_memory<MemoryPolicy::Unchecked>(std::uint16_t, std::uint16_t);
+template void Hack::tick<MemoryPolicy::Checked>();
+template void Hack::tick<MemoryPolicy::Masked>();
+template void Hack::tick<MemoryPolicy::Unchecked>();
@@ -1,16 +1,45 @@
 #ifndef HACK_HPP
 #define HACK_HPP
 
-#include <SDL3/SDL.h>
 #include <array>
 #include <cstdint>
+#include <optional>
 #include <span>
 #include <string_view>
 #include <vector>
 
 using ScreenSpan = std::span<std::uint16_t, 8192>;
 
-std::uint16_t convert_input_to_hack(SDL_Keycode key);
+// parses the contents of a `.hack` file, one binary instruction per line
+std::optional<std::vector<std::uint16_t>> parse_rom(std::string_view instructions);
+
+// A memory mapped peripheral.
+// Reads and writes to the addresses a device is attached to are sent to the device instead of RAM.
+class Device {
+   public:
+   virtual std::uint16_t read(std::uint16_t address) = 0;
+   virtual void write(std::uint16_t address, std::uint16_t value) = 0;
+   virtual ~Device() = default;
+};
+
+struct MappedDevice {
+   std::uint16_t start, end;
+   Device *device;
+};
+
+// devices are looked up per page so that accesses to plain RAM never have to go through them
+constexpr std::size_t DEVICE_PAGE_SIZE = 256;
+
+// How the CPU handles A pointing past the end of RAM (A > 32767) when reading or writing M.
+// The policy is a template parameter of `Hack::tick` so the unused checks aren't compiled in.
+enum class MemoryPolicy : std::uint8_t {
+   // throws an error with the PC of the faulting instruction
+   Checked,
+   // wraps the address to 15 bits like the real hardware
+   Masked,
+   // sends the access to a guard region instead of RAM, without checking or branching
+   Unchecked,
+};
 
 struct Hack {
    // instruction memory
@@ -22,21 +51,61 @@ struct Hack {
    // Screen Buffer MMAP: 0x4000-0x5FFF
    // Keyboard MMAP:      0x6000
    std::array<std::uint16_t, 32768> data_mem { 0 };
+   // receives the out of range accesses made with `MemoryPolicy::Unchecked`
+   std::array<std::uint16_t, 32768> guard_mem { 0 };
 
    std::uint16_t pc { 0 };
    std::uint16_t address_reg { 0 }, data_reg { 0 };
 
-   bool load_rom(std::vector<uint16_t> &instructions);
+   // Enables the multiply extension, which isn't part of the standard Hack CPU.
+   // It takes the otherwise invalid comp bits `000001` for D*A (a = 0) and D*M (a = 1), keeping
+   // the low 16 bits of the product. When disabled those instructions are invalid as usual.
+   bool extended_isa { false };
+
+   // pages that have at least one device attached to them.
+   // Covers the whole 16-bit address space so any value of A can index it.
+   std::array<bool, 65536 / DEVICE_PAGE_SIZE> device_pages { };
+   std::vector<MappedDevice> devices { };
+
+   bool load_rom(std::span<const std::uint16_t> instructions);
    bool load_rom(std::string_view instructions);
+   // replaces the ROM in place, only writing the words that differ from the loaded program.
+   // Unlike `load_rom` the registers and RAM are left untouched.
+   // Returns the number of words that changed or nothing if the program doesn't fit in ROM.
+   std::optional<std::size_t> patch_rom(std::span<const std::uint16_t> instructions);
 
    // retrieves a span of the memory mapped screen buffer
    ScreenSpan get_screen_mmap();
 
    std::uint16_t &get_keyboard_mmap();
 
-   // Throws an exception if an invalid instruction is ever reached
-   void tick();
-   void draw_screen(SDL_Renderer *renderer, SDL_Texture *texture);
+   // maps the data memory addresses [start, end] to `device`.
+   // Fails if the range is outside of data memory or overlaps with another device.
+   bool attach_device(std::uint16_t start, std::uint16_t end, Device &device);
+   void detach_device(Device &device);
+
+   template <MemoryPolicy Policy = MemoryPolicy::Checked>
+   std::uint16_t read_memory(std::uint16_t address);
+   template <MemoryPolicy Policy = MemoryPolicy::Checked>
+   void write_memory(std::uint16_t address, std::uint16_t value);
+
+   // Throws an exception with the PC if an invalid instruction is ever reached, or when `Policy` is
+   // checked and the PC runs past the end of ROM. Otherwise the PC is wrapped to 15 bits.
+   template <MemoryPolicy Policy = MemoryPolicy::Checked> void tick();
+
+   private:
+   template <MemoryPolicy Policy> std::uint16_t &memory_cell(std::uint16_t address);
 };
 
+// instantiated in hack.cpp
+extern template std::uint16_t Hack::read_memory<MemoryPolicy::Checked>(std::uint16_t);
+extern template std::uint16_t Hack::read_memory<MemoryPolicy::Masked>(std::uint16_t);
+extern template std::uint16_t Hack::read_memory<MemoryPolicy::Unchecked>(std::uint16_t);
+extern template void Hack::write_memory<MemoryPolicy::Checked>(std::uint16_t, std::uint16_t);
+extern template void Hack::write_memory<MemoryPolicy::Masked>(std::uint16_t, std::uint16_t);
+extern template void Hack::write_memory<MemoryPolicy::Unchecked>(std::uint16_t, std::uint16_t);
+extern template void Hack::tick<MemoryPolicy::Checked>();
+extern template void Hack::tick<MemoryPolicy::Masked>();
+extern template void Hack::tick<MemoryPolicy::Unchecked>();
+
 #endif
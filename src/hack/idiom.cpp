@@ -0,0 +1,616 @@
+#include "idiom.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+
+// comp bits, including the `a` bit, of the instructions used by the loops
+constexpr std::uint16_t COMP_ZERO = 0b0101010;
+constexpr std::uint16_t COMP_ONE = 0b0111111;
+constexpr std::uint16_t COMP_NEG_ONE = 0b0111010;
+constexpr std::uint16_t COMP_D = 0b0001100;
+constexpr std::uint16_t COMP_M = 0b1110000;
+constexpr std::uint16_t COMP_M_PLUS_ONE = 0b1110111;
+constexpr std::uint16_t COMP_M_MINUS_ONE = 0b1110010;
+constexpr std::uint16_t COMP_D_PLUS_M = 0b1000010;
+constexpr std::uint16_t COMP_D_MINUS_A = 0b0010011;
+constexpr std::uint16_t COMP_D_MINUS_M = 0b1010011;
+
+constexpr std::uint16_t DEST_NONE = 0b000;
+constexpr std::uint16_t DEST_M = 0b001;
+constexpr std::uint16_t DEST_D = 0b010;
+constexpr std::uint16_t DEST_MD = 0b011;
+constexpr std::uint16_t DEST_A = 0b100;
+
+constexpr std::uint16_t JUMP_NONE = 0b000;
+constexpr std::uint16_t JUMP_ALWAYS = 0b111;
+
+constexpr std::uint16_t c_inst(std::uint16_t comp, std::uint16_t dest, std::uint16_t jump) {
+   return 0b111 << 13 | comp << 6 | dest << 3 | jump;
+}
+
+// argument layout of each kind
+constexpr std::size_t FILL_PTR = 0, FILL_VALUE = 1, FILL_LIMIT = 2;
+constexpr std::size_t COPY_SRC = 0, COPY_DST = 1, COPY_COUNT = 2;
+constexpr std::size_t MUL_COUNTER = 0, MUL_LIMIT = 1, MUL_ADDEND = 2, MUL_ACC = 3;
+
+// Walks over the ROM checking the instructions one by one
+class RomMatcher final {
+   std::span<const std::uint16_t> m_rom;
+   std::size_t m_idx;
+   bool m_matched { true };
+
+   std::optional<std::uint16_t> next() {
+      if (!m_matched || m_idx >= m_rom.size()) {
+         m_matched = false;
+         return std::nullopt;
+      }
+      return m_rom[m_idx++];
+   }
+
+   public:
+   RomMatcher(std::span<const std::uint16_t> rom, std::size_t start)
+       : m_rom { rom }
+       , m_idx { start } { }
+
+   bool matched() const { return m_matched; }
+   std::size_t position() const { return m_idx; }
+
+   // matches any A-instruction, storing its value in `value`
+   RomMatcher &load(std::uint16_t &value) {
+      auto inst = next();
+      if (inst.has_value() && (inst.value() & (1 << 15)) == 0) {
+         value = inst.value();
+      } else {
+         m_matched = false;
+      }
+      return *this;
+   }
+
+   // matches an A-instruction loading the same value as a previous `load`
+   RomMatcher &load_same(std::uint16_t value) {
+      auto inst = next();
+      m_matched = m_matched && inst == value;
+      return *this;
+   }
+
+   RomMatcher &inst(std::uint16_t comp, std::uint16_t dest, std::uint16_t jump = JUMP_NONE) {
+      auto inst = next();
+      // the two unused bits of C-instructions are ignored by the CPU
+      m_matched = m_matched && (inst.value() & (1 << 15))
+          && (inst.value() | 0b11 << 13) == c_inst(comp, dest, jump);
+      return *this;
+   }
+
+   // matches `D;JXX` with any conditional jump
+   RomMatcher &jump_on_d(std::uint16_t &jump) {
+      auto inst = next();
+      if (!inst.has_value() || (inst.value() & (1 << 15)) == 0) {
+         m_matched = false;
+         return *this;
+      }
+
+      jump = inst.value() & 0b111;
+      m_matched = jump != JUMP_NONE && jump != JUMP_ALWAYS
+          && (inst.value() | 0b11 << 13) == c_inst(COMP_D, DEST_NONE, jump);
+      return *this;
+   }
+};
+
+// [@value D=M] @ptr A=M M=0|1|-1|D @ptr M=M+1 D=M @limit D=D-A|D=D-M @start D;JXX
+static std::optional<Idiom> match_fill(std::span<const std::uint16_t> rom, std::uint16_t start) {
+   Idiom idiom { .kind = IdiomKind::Fill, .start = start };
+   auto &args = idiom.args;
+
+   RomMatcher value_load { rom, start };
+   value_load.load(args[FILL_VALUE]).inst(COMP_M, DEST_D);
+   idiom.value_in_ram = value_load.matched();
+
+   RomMatcher m { rom, idiom.value_in_ram ? value_load.position() : start };
+   m.load(args[FILL_PTR]).inst(COMP_M, DEST_A);
+   if (!m.matched()) {
+      return std::nullopt;
+   }
+
+   if (idiom.value_in_ram) {
+      m.inst(COMP_D, DEST_M);
+   } else {
+      constexpr std::array<std::pair<std::uint16_t, std::uint16_t>, 3> constants { {
+          { COMP_ZERO, 0 },
+          { COMP_ONE, 1 },
+          { COMP_NEG_ONE, 0xFFFF },
+      } };
+
+      bool found = false;
+      for (auto [comp, value] : constants) {
+         RomMatcher store = m;
+         if (store.inst(comp, DEST_M).matched()) {
+            m = store;
+            args[FILL_VALUE] = value;
+            found = true;
+            break;
+         }
+      }
+      if (!found) {
+         return std::nullopt;
+      }
+   }
+
+   m.load_same(args[FILL_PTR]).inst(COMP_M_PLUS_ONE, DEST_M).inst(COMP_M, DEST_D);
+   m.load(args[FILL_LIMIT]);
+   if (!m.matched()) {
+      return std::nullopt;
+   }
+
+   RomMatcher limit_const = m;
+   limit_const.inst(COMP_D_MINUS_A, DEST_D);
+   idiom.limit_in_ram = !limit_const.matched();
+   if (idiom.limit_in_ram) {
+      m.inst(COMP_D_MINUS_M, DEST_D);
+   } else {
+      m = limit_const;
+   }
+
+   m.load_same(start).jump_on_d(idiom.jump);
+   if (!m.matched()) {
+      return std::nullopt;
+   }
+
+   idiom.exit = m.position();
+   idiom.loop_cycles = idiom.exit_cycles = idiom.exit - start;
+   return idiom;
+}
+
+// @src A=M D=M @dst A=M M=D @src M=M+1 @dst M=M+1 @count MD=M-1 @start D;JXX
+static std::optional<Idiom> match_copy(std::span<const std::uint16_t> rom, std::uint16_t start) {
+   Idiom idiom { .kind = IdiomKind::Copy, .start = start };
+   auto &args = idiom.args;
+
+   RomMatcher m { rom, start };
+   m.load(args[COPY_SRC]).inst(COMP_M, DEST_A).inst(COMP_M, DEST_D);
+   m.load(args[COPY_DST]).inst(COMP_M, DEST_A).inst(COMP_D, DEST_M);
+   m.load_same(args[COPY_SRC]).inst(COMP_M_PLUS_ONE, DEST_M);
+   m.load_same(args[COPY_DST]).inst(COMP_M_PLUS_ONE, DEST_M);
+   m.load(args[COPY_COUNT]).inst(COMP_M_MINUS_ONE, DEST_MD);
+   m.load_same(start).jump_on_d(idiom.jump);
+   if (!m.matched()) {
+      return std::nullopt;
+   }
+
+   idiom.exit = m.position();
+   idiom.loop_cycles = idiom.exit_cycles = idiom.exit - start;
+   return idiom;
+}
+
+// @counter D=M @limit D=D-M @exit D;JXX @addend D=M @acc M=D+M @counter M=M+1 @start 0;JMP
+static std::optional<Idiom> match_multiply_up(
+    std::span<const std::uint16_t> rom, std::uint16_t start) {
+   Idiom idiom { .kind = IdiomKind::MultiplyUp, .start = start };
+   auto &args = idiom.args;
+
+   RomMatcher m { rom, start };
+   m.load(args[MUL_COUNTER]).inst(COMP_M, DEST_D);
+   m.load(args[MUL_LIMIT]).inst(COMP_D_MINUS_M, DEST_D);
+   m.load(idiom.exit).jump_on_d(idiom.jump);
+   idiom.exit_cycles = m.position() - start;
+   m.load(args[MUL_ADDEND]).inst(COMP_M, DEST_D);
+   m.load(args[MUL_ACC]).inst(COMP_D_PLUS_M, DEST_M);
+   m.load_same(args[MUL_COUNTER]).inst(COMP_M_PLUS_ONE, DEST_M);
+   m.load_same(start).inst(COMP_ZERO, DEST_NONE, JUMP_ALWAYS);
+   if (!m.matched()) {
+      return std::nullopt;
+   }
+
+   idiom.loop_cycles = m.position() - start;
+   return idiom;
+}
+
+// @counter D=M @exit D;JXX @addend D=M @acc M=D+M @counter M=M-1 @start 0;JMP
+static std::optional<Idiom> match_multiply_down(
+    std::span<const std::uint16_t> rom, std::uint16_t start) {
+   Idiom idiom { .kind = IdiomKind::MultiplyDown, .start = start };
+   auto &args = idiom.args;
+
+   RomMatcher m { rom, start };
+   m.load(args[MUL_COUNTER]).inst(COMP_M, DEST_D);
+   m.load(idiom.exit).jump_on_d(idiom.jump);
+   idiom.exit_cycles = m.position() - start;
+   m.load(args[MUL_ADDEND]).inst(COMP_M, DEST_D);
+   m.load(args[MUL_ACC]).inst(COMP_D_PLUS_M, DEST_M);
+   m.load_same(args[MUL_COUNTER]).inst(COMP_M_MINUS_ONE, DEST_M);
+   m.load_same(start).inst(COMP_ZERO, DEST_NONE, JUMP_ALWAYS);
+   if (!m.matched()) {
+      return std::nullopt;
+   }
+
+   idiom.loop_cycles = m.position() - start;
+   return idiom;
+}
+
+// @start 0;JMP
+static std::optional<Idiom> match_halt(std::span<const std::uint16_t> rom, std::uint16_t start) {
+   Idiom idiom { .kind = IdiomKind::Halt, .start = start, .exit = start, .jump = JUMP_ALWAYS };
+
+   RomMatcher m { rom, start };
+   m.load_same(start).inst(COMP_ZERO, DEST_NONE, JUMP_ALWAYS);
+   if (!m.matched()) {
+      return std::nullopt;
+   }
+
+   idiom.loop_cycles = idiom.exit_cycles = m.position() - start;
+   return idiom;
+}
+
+void IdiomEngine::analyze(std::span<const std::uint16_t> rom) {
+   m_idioms.clear();
+   m_idiom_at.assign(rom.size(), 0);
+
+   constexpr std::array matchers {
+      match_fill, match_copy, match_multiply_up, match_multiply_down, match_halt
+   };
+   for (std::size_t start = 0; start < rom.size(); start++) {
+      for (auto matcher : matchers) {
+         if (auto idiom = matcher(rom, start)) {
+            m_idioms.push_back(idiom.value());
+            m_idiom_at[start] = m_idioms.size();
+            break;
+         }
+      }
+   }
+}
+
+std::size_t IdiomEngine::size() const { return m_idioms.size(); }
+
+// same conditions as `Hack::tick`
+static bool jumps(std::uint16_t value, std::uint16_t jump) {
+   bool is_zero = value == 0;
+   bool is_negative = value & (1 << 15);
+   switch (jump) {
+   case 0b001:
+      return !is_zero && !is_negative;
+   case 0b010:
+      return is_zero;
+   case 0b011:
+      return is_zero || !is_negative;
+   case 0b100:
+      return !is_zero && is_negative;
+   case 0b101:
+      return !is_zero;
+   case 0b110:
+      return is_zero || is_negative;
+   case 0b111:
+      return true;
+   }
+   return false;
+}
+
+// loop variables are accessed directly so they can't be mapped to a device
+static bool is_plain_ram(const Hack &hack, std::uint16_t address) {
+   return address < hack.data_mem.size() && !hack.device_pages[address / DEVICE_PAGE_SIZE];
+}
+
+// how many of the `count` addresses from `start` on are plain RAM, stopping at the first device
+static std::uint64_t plain_ram_run(const Hack &hack, std::uint16_t start, std::uint64_t count) {
+   if (start >= hack.data_mem.size()) {
+      return 0;
+   }
+
+   const std::uint64_t limit = std::min<std::uint64_t>(start + count, hack.data_mem.size());
+   std::uint64_t end = start;
+   while (end < limit && !hack.device_pages[end / DEVICE_PAGE_SIZE]) {
+      end = (end / DEVICE_PAGE_SIZE + 1) * DEVICE_PAGE_SIZE;
+   }
+   return std::min(end, limit) - start;
+}
+
+// Number of values in a row, starting at `first` and moving by `step` (1 or -1), for which
+// `jumps` gives `taken`, up to all 65536 of them.
+// The jump conditions only look at the sign and zero, so the run ends where the values enter the
+// first of zero, positive or negative that gives the other answer.
+static std::uint64_t run_length(
+    std::uint16_t first, std::int16_t step, std::uint16_t jump, bool taken) {
+   if (jumps(first, jump) != taken) {
+      return 0;
+   }
+
+   // where the values enter zero, positive and negative, going up they're in that region too
+   constexpr std::array<std::uint16_t, 3> entries_up { 0, 1, 0x8000 };
+   constexpr std::array<std::uint16_t, 3> entries_down { 0, 0x7FFF, 0xFFFF };
+   const auto &entries = step > 0 ? entries_up : entries_down;
+
+   std::uint64_t length = 65536;
+   for (std::size_t i = 0; i < entries.size(); i++) {
+      if (jumps(entries_up[i], jump) != taken) {
+         const auto distance
+             = static_cast<std::uint16_t>(step > 0 ? entries[i] - first : first - entries[i]);
+         length = std::min<std::uint64_t>(length, distance);
+      }
+   }
+   return length;
+}
+
+// stops `passes` short of the first address in [start, start + passes) in `addresses`
+static std::uint64_t before_any(std::uint64_t passes, std::uint16_t start,
+    std::initializer_list<std::uint16_t> addresses) {
+   for (auto address : addresses) {
+      if (address >= start && static_cast<std::uint64_t>(address - start) < passes) {
+         passes = address - start;
+      }
+   }
+   return passes;
+}
+
+// Each of the `_passes` functions runs as many passes as it can at once, up to `max_passes`, and
+// returns the number of cycles they took. Memory is accessed directly, so they give up (returning
+// 0) when a pass could touch a device or overwrite the loop's own variables, the `_pass` functions
+// are used then.
+
+static std::uint64_t fill_passes(Hack &hack, const Idiom &idiom, std::uint64_t max_passes) {
+   const auto &args = idiom.args;
+   if (!is_plain_ram(hack, args[FILL_PTR])
+       || (idiom.value_in_ram && !is_plain_ram(hack, args[FILL_VALUE]))
+       || (idiom.limit_in_ram && !is_plain_ram(hack, args[FILL_LIMIT]))) {
+      return 0;
+   }
+
+   // the pointer has to be the only variable a pass changes
+   if ((idiom.value_in_ram && args[FILL_VALUE] == args[FILL_PTR])
+       || (idiom.limit_in_ram && args[FILL_LIMIT] == args[FILL_PTR])) {
+      return 0;
+   }
+
+   auto &mem = hack.data_mem;
+   const std::uint16_t target = mem[args[FILL_PTR]];
+   const std::uint16_t value = idiom.value_in_ram ? mem[args[FILL_VALUE]] : args[FILL_VALUE];
+   const std::uint16_t limit = idiom.limit_in_ram ? mem[args[FILL_LIMIT]] : args[FILL_LIMIT];
+
+   // the pass that leaves the loop is run too
+   const auto first = static_cast<std::uint16_t>(target + 1 - limit);
+   auto passes = std::min(max_passes, run_length(first, 1, idiom.jump, true) + 1);
+   passes = plain_ram_run(hack, target, passes);
+   passes = before_any(passes, target, { args[FILL_PTR] });
+   if (idiom.value_in_ram) {
+      passes = before_any(passes, target, { args[FILL_VALUE] });
+   }
+   if (idiom.limit_in_ram) {
+      passes = before_any(passes, target, { args[FILL_LIMIT] });
+   }
+   if (passes == 0) {
+      return 0;
+   }
+
+   std::fill_n(mem.begin() + target, passes, value);
+   mem[args[FILL_PTR]] = static_cast<std::uint16_t>(target + passes);
+
+   const auto data = static_cast<std::uint16_t>(mem[args[FILL_PTR]] - limit);
+   hack.data_reg = data;
+   hack.address_reg = idiom.start;
+   hack.pc = jumps(data, idiom.jump) ? idiom.start : idiom.exit;
+   return passes * idiom.loop_cycles;
+}
+
+static std::uint64_t copy_passes(Hack &hack, const Idiom &idiom, std::uint64_t max_passes) {
+   const auto &args = idiom.args;
+   if (!is_plain_ram(hack, args[COPY_SRC]) || !is_plain_ram(hack, args[COPY_DST])
+       || !is_plain_ram(hack, args[COPY_COUNT])) {
+      return 0;
+   }
+
+   // each pass has to move both pointers and the count by one
+   if (args[COPY_SRC] == args[COPY_DST] || args[COPY_SRC] == args[COPY_COUNT]
+       || args[COPY_DST] == args[COPY_COUNT]) {
+      return 0;
+   }
+
+   auto &mem = hack.data_mem;
+   const std::uint16_t src = mem[args[COPY_SRC]], dst = mem[args[COPY_DST]];
+   const std::uint16_t count = mem[args[COPY_COUNT]];
+
+   const auto first = static_cast<std::uint16_t>(count - 1);
+   auto passes = std::min(max_passes, run_length(first, -1, idiom.jump, true) + 1);
+   passes = plain_ram_run(hack, src, passes);
+   passes = plain_ram_run(hack, dst, passes);
+   for (auto start : { src, dst }) {
+      passes = before_any(passes, start, { args[COPY_SRC], args[COPY_DST], args[COPY_COUNT] });
+   }
+   if (passes == 0) {
+      return 0;
+   }
+
+   // word by word, overlapping ranges are copied the same way the loop would
+   for (std::uint64_t i = 0; i < passes; i++) {
+      mem[dst + i] = mem[src + i];
+   }
+   mem[args[COPY_SRC]] = static_cast<std::uint16_t>(src + passes);
+   mem[args[COPY_DST]] = static_cast<std::uint16_t>(dst + passes);
+   mem[args[COPY_COUNT]] = static_cast<std::uint16_t>(count - passes);
+
+   hack.data_reg = mem[args[COPY_COUNT]];
+   hack.address_reg = idiom.start;
+   hack.pc = jumps(hack.data_reg, idiom.jump) ? idiom.start : idiom.exit;
+   return passes * idiom.loop_cycles;
+}
+
+// only runs the passes that loop back, the one leaving the loop is left to `multiply_pass`
+static std::uint64_t multiply_passes(Hack &hack, const Idiom &idiom, std::uint64_t max_passes) {
+   const auto &args = idiom.args;
+   const bool counts_up = idiom.kind == IdiomKind::MultiplyUp;
+   if (!is_plain_ram(hack, args[MUL_COUNTER]) || !is_plain_ram(hack, args[MUL_ADDEND])
+       || !is_plain_ram(hack, args[MUL_ACC])
+       || (counts_up && !is_plain_ram(hack, args[MUL_LIMIT]))) {
+      return 0;
+   }
+
+   // every pass has to change the counter and the accumulator and nothing else
+   const auto counter = args[MUL_COUNTER], addend = args[MUL_ADDEND], acc = args[MUL_ACC];
+   if (counter == addend || counter == acc || addend == acc
+       || (counts_up && (args[MUL_LIMIT] == counter || args[MUL_LIMIT] == acc))) {
+      return 0;
+   }
+
+   auto &mem = hack.data_mem;
+   std::uint16_t data = mem[counter];
+   if (counts_up) {
+      data -= mem[args[MUL_LIMIT]];
+   }
+
+   const std::int16_t step = counts_up ? 1 : -1;
+   const auto passes = std::min(max_passes, run_length(data, step, idiom.jump, false));
+   if (passes == 0) {
+      return 0;
+   }
+
+   // the accumulator wraps around, so only the passes modulo 2^16 matter
+   const auto wrapped = static_cast<std::uint16_t>(passes);
+   mem[acc] = static_cast<std::uint16_t>(mem[acc] + std::uint32_t { mem[addend] } * wrapped);
+   mem[counter] = static_cast<std::uint16_t>(mem[counter] + step * wrapped);
+
+   hack.data_reg = mem[addend];
+   hack.address_reg = idiom.start;
+   hack.pc = idiom.start;
+   return passes * idiom.loop_cycles;
+}
+
+static std::uint64_t fill_pass(Hack &hack, const Idiom &idiom) {
+   const auto &args = idiom.args;
+   if (!is_plain_ram(hack, args[FILL_PTR])
+       || (idiom.value_in_ram && !is_plain_ram(hack, args[FILL_VALUE]))
+       || (idiom.limit_in_ram && !is_plain_ram(hack, args[FILL_LIMIT]))) {
+      return 0;
+   }
+
+   auto &mem = hack.data_mem;
+   const std::uint16_t target = mem[args[FILL_PTR]];
+   if (target >= mem.size()) {
+      return 0;
+   }
+
+   const std::uint16_t value = idiom.value_in_ram ? mem[args[FILL_VALUE]] : args[FILL_VALUE];
+   hack.write_memory(target, value);
+   mem[args[FILL_PTR]] += 1;
+
+   std::uint16_t data = mem[args[FILL_PTR]];
+   data -= idiom.limit_in_ram ? mem[args[FILL_LIMIT]] : args[FILL_LIMIT];
+
+   hack.data_reg = data;
+   hack.address_reg = idiom.start;
+   hack.pc = jumps(data, idiom.jump) ? idiom.start : idiom.exit;
+   return idiom.loop_cycles;
+}
+
+static std::uint64_t copy_pass(Hack &hack, const Idiom &idiom) {
+   const auto &args = idiom.args;
+   if (!is_plain_ram(hack, args[COPY_SRC]) || !is_plain_ram(hack, args[COPY_DST])
+       || !is_plain_ram(hack, args[COPY_COUNT])) {
+      return 0;
+   }
+
+   auto &mem = hack.data_mem;
+   if (mem[args[COPY_SRC]] >= mem.size() || mem[args[COPY_DST]] >= mem.size()) {
+      return 0;
+   }
+
+   const std::uint16_t word = hack.read_memory(mem[args[COPY_SRC]]);
+   hack.write_memory(mem[args[COPY_DST]], word);
+   mem[args[COPY_SRC]] += 1;
+   mem[args[COPY_DST]] += 1;
+   const std::uint16_t count = mem[args[COPY_COUNT]] - 1;
+   mem[args[COPY_COUNT]] = count;
+
+   hack.data_reg = count;
+   hack.address_reg = idiom.start;
+   hack.pc = jumps(count, idiom.jump) ? idiom.start : idiom.exit;
+   return idiom.loop_cycles;
+}
+
+static std::uint64_t multiply_pass(Hack &hack, const Idiom &idiom) {
+   const auto &args = idiom.args;
+   const bool counts_up = idiom.kind == IdiomKind::MultiplyUp;
+   if (!is_plain_ram(hack, args[MUL_COUNTER]) || !is_plain_ram(hack, args[MUL_ADDEND])
+       || !is_plain_ram(hack, args[MUL_ACC])
+       || (counts_up && !is_plain_ram(hack, args[MUL_LIMIT]))) {
+      return 0;
+   }
+
+   auto &mem = hack.data_mem;
+   std::uint16_t data = mem[args[MUL_COUNTER]];
+   if (counts_up) {
+      data -= mem[args[MUL_LIMIT]];
+   }
+
+   if (jumps(data, idiom.jump)) {
+      hack.data_reg = data;
+      hack.address_reg = idiom.exit;
+      hack.pc = idiom.exit;
+      return idiom.exit_cycles;
+   }
+
+   data = mem[args[MUL_ADDEND]];
+   mem[args[MUL_ACC]] += data;
+   mem[args[MUL_COUNTER]] += counts_up ? 1 : -1;
+
+   hack.data_reg = data;
+   hack.address_reg = idiom.start;
+   hack.pc = idiom.start;
+   return idiom.loop_cycles;
+}
+
+void IdiomEngine::run(Hack &hack, std::uint64_t max_cycles) const {
+   if (m_idioms.empty()) {
+      for (std::uint64_t i = 0; i < max_cycles; i++) {
+         hack.tick();
+      }
+      return;
+   }
+
+   const auto idiom_at = std::span(m_idiom_at);
+   std::uint64_t cycles = 0;
+   while (cycles < max_cycles) {
+      if (hack.pc >= idiom_at.size() || idiom_at[hack.pc] == 0) [[likely]] {
+         hack.tick();
+         ++cycles;
+         continue;
+      }
+
+      const auto &idiom = m_idioms[idiom_at[hack.pc] - 1];
+      const auto remaining = max_cycles - cycles;
+
+      // a pass can't be split, so it only runs if it fits in the remaining cycles
+      std::uint64_t ran = 0;
+      if (remaining >= std::max(idiom.loop_cycles, idiom.exit_cycles)) {
+         const auto max_passes = remaining / idiom.loop_cycles;
+         switch (idiom.kind) {
+         case IdiomKind::Fill:
+            ran = fill_passes(hack, idiom, max_passes);
+            if (ran == 0) {
+               ran = fill_pass(hack, idiom);
+            }
+            break;
+         case IdiomKind::Copy:
+            ran = copy_passes(hack, idiom, max_passes);
+            if (ran == 0) {
+               ran = copy_pass(hack, idiom);
+            }
+            break;
+         case IdiomKind::MultiplyUp:
+         case IdiomKind::MultiplyDown:
+            ran = multiply_passes(hack, idiom, max_passes);
+            if (ran == 0) {
+               ran = multiply_pass(hack, idiom);
+            }
+            break;
+         case IdiomKind::Halt:
+            // nothing changes in between passes so they can all be run at once
+            hack.address_reg = idiom.start;
+            ran = remaining - remaining % idiom.loop_cycles;
+            break;
+         }
+      }
+
+      if (ran == 0) {
+         hack.tick();
+         ran = 1;
+      }
+      cycles += ran;
+   }
+}
@@ -0,0 +1,64 @@
+#ifndef HACK_IDIOM_HPP
+#define HACK_IDIOM_HPP
+
+#include "hack.hpp"
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Fast-forwarding of common loops.
+//
+// The ROM is scanned for a few loop shapes that real programs spend most of their time in:
+// filling memory through a pointer (e.g. clearing the screen), copying memory between two
+// pointers, multiplying through repeated addition and jumping in place once the program is done. Whenever the PC reaches the start of one,
+// whole passes through the loop are run natively instead of one instruction at a time. When the
+// memory the loop goes over has no devices, its trip count is worked out up front and every pass
+// left is run at once, e.g. a screen fill is a single `std::fill_n`.
+//
+// A pass reads and writes memory in the same order the instructions would and leaves A, D and PC
+// as the last instruction of the pass would, so the result and the cycle count are identical to
+// ticking. Passes are skipped whenever they could behave differently, e.g. a pointer that's out
+// of range or a loop variable that's mapped to a device.
+
+enum class IdiomKind : std::uint8_t {
+   Fill,
+   Copy,
+   MultiplyUp,
+   MultiplyDown,
+   // `(END) @END 0;JMP`, how programs usually stop
+   Halt,
+};
+
+struct Idiom {
+   IdiomKind kind { IdiomKind::Fill };
+   // ROM address of the first instruction of the loop and where the loop leaves to
+   std::uint16_t start { 0 }, exit { 0 };
+   // jump bits of the loop's conditional jump
+   std::uint16_t jump { 0 };
+   // addresses of the loop's variables and constants, the layout depends on the kind
+   std::array<std::uint16_t, 4> args { };
+   // whether the fill value and loop limit are read from RAM instead of being constants
+   bool value_in_ram { false }, limit_in_ram { false };
+   // cycles taken by a pass that loops back and by one that leaves the loop
+   std::uint8_t loop_cycles { 0 }, exit_cycles { 0 };
+};
+
+class IdiomEngine final {
+   std::vector<Idiom> m_idioms { };
+   // index + 1 of the idiom starting at each ROM address, 0 if there's none
+   std::vector<std::uint16_t> m_idiom_at { };
+
+   public:
+   // finds the loops in `rom`, has to be called again whenever the ROM changes
+   void analyze(std::span<const std::uint16_t> rom);
+
+   // number of loops found by `analyze`
+   std::size_t size() const;
+
+   // runs exactly `max_cycles` cycles, fast-forwarding the loops it comes across.
+   // Throws the same exceptions as `Hack::tick`.
+   void run(Hack &hack, std::uint64_t max_cycles) const;
+};
+
+#endif
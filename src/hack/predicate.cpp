@@ -0,0 +1,380 @@
+#include "predicate.hpp"
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <format>
+#include <string>
+
+class PredicateCompiler final {
+   std::string_view m_expr;
+   std::size_t m_idx { 0 };
+   const std::unordered_map<std::string, std::uint16_t> &m_labels;
+   Predicate m_pred { };
+   std::size_t m_depth { 0 }, m_max_depth { 0 };
+   std::string m_error { };
+
+   struct Term {
+      // set when the term is exactly `PC == constant`
+      std::optional<std::uint16_t> pc_eq;
+   };
+
+   void skip_space() {
+      while (m_idx < m_expr.size() && std::isspace(m_expr[m_idx])) {
+         ++m_idx;
+      }
+   }
+
+   bool eat(std::string_view token) {
+      skip_space();
+      if (m_expr.substr(m_idx).starts_with(token)) {
+         m_idx += token.size();
+         return true;
+      }
+      return false;
+   }
+
+   void fail(std::string_view msg) {
+      if (m_error.empty()) {
+         m_error = std::format("{} at column {}", msg, m_idx + 1);
+      }
+   }
+
+   void emit(PredicateOp op, std::int32_t arg = 0) {
+      switch (op) {
+      case PredicateOp::Const:
+      case PredicateOp::A:
+      case PredicateOp::D:
+      case PredicateOp::M:
+      case PredicateOp::PC:
+      case PredicateOp::Ram:
+         ++m_depth;
+         break;
+      case PredicateOp::Not:
+         break;
+      default:
+         --m_depth;
+         break;
+      }
+      m_max_depth = std::max(m_max_depth, m_depth);
+      m_pred.m_code.push_back({ .op = op, .arg = arg });
+   }
+
+   std::optional<std::int32_t> number() {
+      skip_space();
+      std::uint32_t num = 0;
+      auto res = std::from_chars(m_expr.data() + m_idx, m_expr.data() + m_expr.size(), num);
+      if (res.ec != std::errc() || num > 0xFFFF) {
+         fail("Expected a 16-bit number");
+         return std::nullopt;
+      }
+      m_idx = res.ptr - m_expr.data();
+      return static_cast<std::int16_t>(num);
+   }
+
+   std::string_view identifier() {
+      skip_space();
+      auto start = m_idx;
+      while (m_idx < m_expr.size()
+          && (std::isalnum(m_expr[m_idx]) || m_expr[m_idx] == '_' || m_expr[m_idx] == '.'
+              || m_expr[m_idx] == '$')) {
+         ++m_idx;
+      }
+      return m_expr.substr(start, m_idx - start);
+   }
+
+   // returns the constant pushed by the operand if it's one
+   std::optional<std::int32_t> operand(bool &is_pc) {
+      is_pc = false;
+      skip_space();
+      if (m_idx >= m_expr.size()) {
+         fail("Unexpected end of expression");
+         return std::nullopt;
+      }
+
+      if (eat("(")) {
+         expr(false);
+         if (!eat(")")) {
+            fail("Expected `)`");
+         }
+         return std::nullopt;
+      }
+
+      if (eat("!")) {
+         bool unused;
+         operand(unused);
+         emit(PredicateOp::Not);
+         return std::nullopt;
+      }
+
+      if (eat("-")) {
+         auto num = number();
+         if (num.has_value()) {
+            std::int32_t neg = static_cast<std::int16_t>(-num.value());
+            emit(PredicateOp::Const, neg);
+            return neg;
+         }
+         return std::nullopt;
+      }
+
+      if (eat("@")) {
+         auto label = std::string(identifier());
+         auto addr = m_labels.find(label);
+         if (addr == m_labels.end()) {
+            fail(std::format("Unknown label `{}`", label));
+            return std::nullopt;
+         }
+         std::int32_t value = static_cast<std::int16_t>(addr->second);
+         emit(PredicateOp::Const, value);
+         return value;
+      }
+
+      if (std::isdigit(m_expr[m_idx])) {
+         auto num = number();
+         if (num.has_value()) {
+            emit(PredicateOp::Const, num.value());
+         }
+         return num;
+      }
+
+      auto ident = std::string(identifier());
+      for (auto &c : ident) {
+         c = std::toupper(c);
+      }
+
+      if (ident == "A") {
+         m_pred.m_watches_a = true;
+         emit(PredicateOp::A);
+      } else if (ident == "D") {
+         m_pred.m_watches_d = true;
+         emit(PredicateOp::D);
+      } else if (ident == "M") {
+         m_pred.m_watches_a = true;
+         m_pred.m_watches_m = true;
+         emit(PredicateOp::M);
+      } else if (ident == "PC") {
+         m_pred.m_watches_pc = true;
+         is_pc = true;
+         emit(PredicateOp::PC);
+      } else if (ident == "RAM") {
+         if (!eat("[")) {
+            fail("Expected `[` after RAM");
+            return std::nullopt;
+         }
+         auto addr = number();
+         if (!addr.has_value()) {
+            return std::nullopt;
+         }
+         auto address = static_cast<std::uint16_t>(addr.value());
+         if (address >= m_pred.m_watched_ram.size()) {
+            fail("RAM address out of range");
+            return std::nullopt;
+         }
+         if (!eat("]")) {
+            fail("Expected `]`");
+            return std::nullopt;
+         }
+         m_pred.m_watched_ram.set(address);
+         emit(PredicateOp::Ram, address);
+      } else {
+         fail(ident.empty() ? "Expected an operand" : std::format("Unknown operand `{}`", ident));
+      }
+
+      return std::nullopt;
+   }
+
+   Term cmp() {
+      bool left_pc, right_pc;
+      auto left = operand(left_pc);
+
+      constexpr std::array<std::pair<std::string_view, PredicateOp>, 6> comparisons { {
+          { "==", PredicateOp::Eq },
+          { "!=", PredicateOp::Ne },
+          { "<=", PredicateOp::Le },
+          { ">=", PredicateOp::Ge },
+          { "<", PredicateOp::Lt },
+          { ">", PredicateOp::Gt },
+      } };
+
+      for (const auto &[token, op] : comparisons) {
+         if (eat(token)) {
+            auto right = operand(right_pc);
+            emit(op);
+
+            Term term { };
+            if (op == PredicateOp::Eq && left_pc && right.has_value()) {
+               term.pc_eq = right.value();
+            } else if (op == PredicateOp::Eq && right_pc && left.has_value()) {
+               term.pc_eq = left.value();
+            }
+            return term;
+         }
+      }
+
+      return Term { };
+   }
+
+   void expr(bool top_level) {
+      std::optional<std::uint16_t> anchor { };
+      std::size_t chains = 0;
+
+      do {
+         ++chains;
+         auto term = cmp();
+         if (term.pc_eq.has_value() && !anchor.has_value()) {
+            anchor = term.pc_eq;
+         }
+
+         while (eat("&&")) {
+            term = cmp();
+            if (term.pc_eq.has_value() && !anchor.has_value()) {
+               anchor = term.pc_eq;
+            }
+            emit(PredicateOp::And);
+         }
+
+         if (chains > 1) {
+            emit(PredicateOp::Or);
+         }
+      } while (eat("||"));
+
+      // disjunctions can hold at any PC
+      if (top_level && chains == 1) {
+         m_pred.m_pc_anchor = anchor;
+      }
+   }
+
+   public:
+   PredicateCompiler(
+       std::string_view expr, const std::unordered_map<std::string, std::uint16_t> &labels)
+       : m_expr { expr }
+       , m_labels { labels } { }
+
+   std::optional<Predicate> compile(std::string &error) {
+      expr(true);
+      skip_space();
+      if (m_idx < m_expr.size()) {
+         fail("Unexpected character");
+      }
+
+      if (m_max_depth > Predicate::MAX_STACK_DEPTH) {
+         fail("Expression is too deeply nested");
+      }
+
+      if (!m_error.empty()) {
+         error = m_error;
+         return std::nullopt;
+      }
+
+      return m_pred;
+   }
+};
+
+std::optional<Predicate> Predicate::compile(std::string_view expr,
+    const std::unordered_map<std::string, std::uint16_t> &labels, std::string &error) {
+   PredicateCompiler compiler { expr, labels };
+   return compiler.compile(error);
+}
+
+bool Predicate::eval(const Hack &hack) const {
+   std::array<std::int32_t, MAX_STACK_DEPTH> stack;
+   std::size_t top = 0;
+
+   auto binary = [&stack, &top](auto op) {
+      --top;
+      stack[top - 1] = op(stack[top - 1], stack[top]);
+   };
+
+   for (const auto &instr : m_code) {
+      switch (instr.op) {
+      case PredicateOp::Const:
+         stack[top++] = instr.arg;
+         break;
+      case PredicateOp::A:
+         stack[top++] = static_cast<std::int16_t>(hack.address_reg);
+         break;
+      case PredicateOp::D:
+         stack[top++] = static_cast<std::int16_t>(hack.data_reg);
+         break;
+      case PredicateOp::M:
+         stack[top++] = hack.address_reg < hack.data_mem.size()
+             ? static_cast<std::int16_t>(hack.data_mem[hack.address_reg])
+             : 0;
+         break;
+      case PredicateOp::PC:
+         stack[top++] = static_cast<std::int16_t>(hack.pc);
+         break;
+      case PredicateOp::Ram:
+         stack[top++] = static_cast<std::int16_t>(hack.data_mem[instr.arg]);
+         break;
+
+      case PredicateOp::Eq:
+         binary([](auto l, auto r) { return l == r; });
+         break;
+      case PredicateOp::Ne:
+         binary([](auto l, auto r) { return l != r; });
+         break;
+      case PredicateOp::Lt:
+         binary([](auto l, auto r) { return l < r; });
+         break;
+      case PredicateOp::Le:
+         binary([](auto l, auto r) { return l <= r; });
+         break;
+      case PredicateOp::Gt:
+         binary([](auto l, auto r) { return l > r; });
+         break;
+      case PredicateOp::Ge:
+         binary([](auto l, auto r) { return l >= r; });
+         break;
+      case PredicateOp::And:
+         binary([](auto l, auto r) { return l && r; });
+         break;
+      case PredicateOp::Or:
+         binary([](auto l, auto r) { return l || r; });
+         break;
+      case PredicateOp::Not:
+         stack[top - 1] = !stack[top - 1];
+         break;
+      }
+   }
+
+   return top > 0 && stack[top - 1] != 0;
+}
+
+bool Predicate::affected_by(std::uint16_t inst, std::uint16_t address, std::uint16_t pc) const {
+   if (m_pc_anchor.has_value()) {
+      return pc == m_pc_anchor.value();
+   }
+
+   if (m_watches_pc) {
+      return true;
+   }
+
+   bool is_a_instruction = (inst & (1 << 15)) == 0;
+   if (is_a_instruction) {
+      return m_watches_a;
+   }
+
+   std::uint16_t dest = (inst >> 3) & 0b111;
+   bool writes_a = dest & 0b100;
+   bool writes_d = dest & 0b010;
+   bool writes_m = dest & 0b001;
+
+   if (writes_a && m_watches_a) {
+      return true;
+   }
+
+   if (writes_d && m_watches_d) {
+      return true;
+   }
+
+   if (writes_m) {
+      return m_watches_m || (address < m_watched_ram.size() && m_watched_ram.test(address));
+   }
+
+   return false;
+}
+
+RunResult run_until(Hack &hack, const Predicate &until, std::uint64_t max_cycles) {
+   return run_until(hack, until, max_cycles, [](Hack &hack) { hack.tick(); });
+}
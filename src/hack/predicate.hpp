@@ -0,0 +1,103 @@
+#ifndef HACK_PREDICATE_HPP
+#define HACK_PREDICATE_HPP
+
+#include "hack.hpp"
+#include <bitset>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Stop conditions for the emulator such as `RAM[0]==5 && PC==@END` or `D<0`.
+//
+// Grammar:
+//   expr    = and ('||' and)*
+//   and     = cmp ('&&' cmp)*
+//   cmp     = operand (('==' | '!=' | '<' | '<=' | '>' | '>=') operand)?
+//   operand = number | '-' number | A | D | M | PC | RAM '[' number ']' | '@' label
+//           | '!' operand | '(' expr ')'
+//
+// Values are compared as signed 16-bit numbers and an operand on its own is true when non-zero.
+// Expressions are compiled once into a small stack bytecode, together with the set of registers
+// and addresses they read, so that they are only evaluated after ticks that could change them.
+
+enum class PredicateOp : std::uint8_t {
+   Const,
+   A,
+   D,
+   M,
+   PC,
+   Ram,
+
+   Eq,
+   Ne,
+   Lt,
+   Le,
+   Gt,
+   Ge,
+   Not,
+   And,
+   Or,
+};
+
+struct PredicateInstr {
+   PredicateOp op;
+   std::int32_t arg;
+};
+
+class Predicate final {
+   std::vector<PredicateInstr> m_code { };
+   std::bitset<32768> m_watched_ram { };
+   bool m_watches_a { false }, m_watches_d { false }, m_watches_m { false };
+   bool m_watches_pc { false };
+   // set when the expression can only hold at a single PC, e.g. `PC==@LOOP && D>0`
+   std::optional<std::uint16_t> m_pc_anchor { std::nullopt };
+
+   friend class PredicateCompiler;
+
+   public:
+   static constexpr std::size_t MAX_STACK_DEPTH = 32;
+
+   // `labels` is used to resolve `@label` operands to their ROM address.
+   // On failure returns nothing and writes the reason into `error`.
+   static std::optional<Predicate> compile(std::string_view expr,
+       const std::unordered_map<std::string, std::uint16_t> &labels, std::string &error);
+
+   bool eval(const Hack &hack) const;
+
+   // whether executing `inst` with `address` in the A register, ending up at `pc`, may have
+   // changed the result of the predicate
+   bool affected_by(std::uint16_t inst, std::uint16_t address, std::uint16_t pc) const;
+};
+
+struct RunResult {
+   std::uint64_t cycles;
+   // whether the run stopped because the predicate held
+   bool reached;
+};
+
+// ticks `hack` until `until` holds or `max_cycles` have been executed.
+// The predicate is only checked after a tick, so a condition that already holds doesn't stop the
+// machine before it runs.
+RunResult run_until(Hack &hack, const Predicate &until, std::uint64_t max_cycles);
+
+// same as above but every cycle is run through `tick(hack)`, e.g. to trace the run
+template <typename Tick>
+RunResult run_until(Hack &hack, const Predicate &until, std::uint64_t max_cycles, Tick &&tick) {
+   for (std::uint64_t i = 0; i < max_cycles; i++) {
+      // wrapped like the unchecked policies fetch it, `tick` reports a PC past the ROM when checked
+      auto inst = hack.instruction_mem[hack.pc & 0x7FFF];
+      auto address = hack.address_reg;
+      tick(hack);
+
+      if (until.affected_by(inst, address, hack.pc) && until.eval(hack)) {
+         return RunResult { .cycles = i + 1, .reached = true };
+      }
+   }
+
+   return RunResult { .cycles = max_cycles, .reached = false };
+}
+
+#endif
@@ -0,0 +1,92 @@
+#include "profile.hpp"
+#include <iterator>
+#include <string>
+#include <string_view>
+
+static void push_uint(std::string &buf, std::uint64_t value, std::size_t size) {
+   for (std::size_t i = 0; i < size; i++) {
+      buf.push_back(static_cast<char>(value >> (i * 8)));
+   }
+}
+
+static std::uint64_t read_uint(std::string_view data, std::size_t pos, std::size_t size) {
+   std::uint64_t value = 0;
+   for (std::size_t i = 0; i < size; i++) {
+      value |= std::uint64_t { static_cast<unsigned char>(data[pos + i]) } << (i * 8);
+   }
+   return value;
+}
+
+Profiler::Profiler(const std::filesystem::path &path, std::size_t rom_size)
+    : m_file { path, std::ios::binary } {
+   m_profile.executed.resize(rom_size);
+   m_profile.taken.resize(rom_size);
+}
+
+Profiler::~Profiler() { finish(); }
+
+bool Profiler::is_open() const { return m_file.is_open(); }
+
+void Profiler::tick(Hack &hack) {
+   const std::size_t pc = hack.pc;
+   hack.tick();
+
+   if (pc < m_profile.executed.size()) {
+      ++m_profile.executed[pc];
+      // a jump to the very next instruction can't be told apart from not jumping, and it costs
+      // the same anyway
+      if (hack.pc != static_cast<std::uint16_t>(pc + 1)) {
+         ++m_profile.taken[pc];
+      }
+   }
+}
+
+void Profiler::finish() {
+   if (!m_file.is_open()) {
+      return;
+   }
+
+   const auto size = m_profile.executed.size();
+   std::string data { };
+   data.reserve(PROFILE_MAGIC.size() + 5 + size * 16);
+   data.append(PROFILE_MAGIC.data(), PROFILE_MAGIC.size());
+   push_uint(data, PROFILE_VERSION, 1);
+   push_uint(data, size, 4);
+   for (std::size_t pc = 0; pc < size; pc++) {
+      push_uint(data, m_profile.executed[pc], 8);
+      push_uint(data, m_profile.taken[pc], 8);
+   }
+
+   m_file.write(data.data(), static_cast<std::streamsize>(data.size()));
+   m_file.close();
+}
+
+std::optional<Profile> read_profile(const std::filesystem::path &path) {
+   std::ifstream file { path, std::ios::binary };
+   if (!file.is_open()) {
+      return std::nullopt;
+   }
+   const std::string data { std::istreambuf_iterator<char>(file), { } };
+
+   constexpr std::size_t header_size = PROFILE_MAGIC.size() + 5;
+   if (data.size() < header_size
+       || std::string_view(data).substr(0, PROFILE_MAGIC.size())
+           != std::string_view(PROFILE_MAGIC.data(), PROFILE_MAGIC.size())
+       || read_uint(data, PROFILE_MAGIC.size(), 1) != PROFILE_VERSION) {
+      return std::nullopt;
+   }
+
+   const auto size = read_uint(data, PROFILE_MAGIC.size() + 1, 4);
+   if (data.size() != header_size + size * 16) {
+      return std::nullopt;
+   }
+
+   Profile profile { };
+   profile.executed.resize(size);
+   profile.taken.resize(size);
+   for (std::size_t pc = 0; pc < size; pc++) {
+      profile.executed[pc] = read_uint(data, header_size + pc * 16, 8);
+      profile.taken[pc] = read_uint(data, header_size + pc * 16 + 8, 8);
+   }
+   return profile;
+}
@@ -0,0 +1,54 @@
+#ifndef HACK_PROFILE_HPP
+#define HACK_PROFILE_HPP
+
+#include "hack.hpp"
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <vector>
+
+// Execution profiles, how often each instruction of a program ran and how often it jumped.
+// They're meant to be fed back into the assembler, see `assembly::Optimizer::set_profile`.
+//
+// Profiles start with PROFILE_MAGIC, a byte of PROFILE_VERSION and the u32 number of instructions,
+// followed by the u64 executed and taken counts of every instruction. All values are little endian.
+
+constexpr std::array<char, 8> PROFILE_MAGIC { 'N', '2', 'T', 'P', 'R', 'O', 'F', 'L' };
+constexpr std::uint8_t PROFILE_VERSION = 1;
+
+struct Profile {
+   // times each instruction ran, indexed by PC
+   std::vector<std::uint64_t> executed { };
+   // times each instruction jumped, it's always 0 for A-instructions
+   std::vector<std::uint64_t> taken { };
+};
+
+// Counts every cycle the emulator runs by PC and writes the counts to a profile file when done.
+// Instructions past the end of the program aren't counted.
+class Profiler final {
+   std::ofstream m_file;
+   Profile m_profile { };
+
+   public:
+   // `rom_size` is the number of instructions in the program being run
+   Profiler(const std::filesystem::path &path, std::size_t rom_size);
+   ~Profiler();
+
+   Profiler(const Profiler &) = delete;
+   Profiler &operator=(const Profiler &) = delete;
+
+   bool is_open() const;
+
+   // runs a single cycle of `hack` and counts it
+   void tick(Hack &hack);
+
+   // writes the counts and closes the file, ticking afterwards isn't counted
+   void finish();
+};
+
+// Reads a profile written by `Profiler`, nothing if it's not a valid one.
+std::optional<Profile> read_profile(const std::filesystem::path &path);
+
+#endif
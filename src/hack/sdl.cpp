@@ -0,0 +1,162 @@
+#include "sdl.hpp"
+#include "hack.hpp"
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+std::uint16_t convert_input_to_hack(SDL_Keycode key) {
+   switch (key) {
+   case SDLK_SPACE:
+      return 32;
+   case SDLK_0:
+      return 48;
+   case SDLK_1:
+      return 49;
+   case SDLK_2:
+      return 50;
+   case SDLK_3:
+      return 51;
+   case SDLK_4:
+      return 52;
+   case SDLK_5:
+      return 53;
+   case SDLK_6:
+      return 54;
+   case SDLK_7:
+      return 55;
+   case SDLK_8:
+      return 56;
+   case SDLK_9:
+      return 57;
+   case SDLK_A:
+      return 65;
+   case SDLK_B:
+      return 66;
+   case SDLK_C:
+      return 67;
+   case SDLK_D:
+      return 68;
+   case SDLK_E:
+      return 69;
+   case SDLK_F:
+      return 70;
+   case SDLK_G:
+      return 71;
+   case SDLK_H:
+      return 72;
+   case SDLK_I:
+      return 73;
+   case SDLK_J:
+      return 74;
+   case SDLK_K:
+      return 75;
+   case SDLK_L:
+      return 76;
+   case SDLK_M:
+      return 77;
+   case SDLK_N:
+      return 78;
+   case SDLK_O:
+      return 79;
+   case SDLK_P:
+      return 80;
+   case SDLK_Q:
+      return 81;
+   case SDLK_R:
+      return 82;
+   case SDLK_S:
+      return 83;
+   case SDLK_T:
+      return 84;
+   case SDLK_U:
+      return 85;
+   case SDLK_V:
+      return 86;
+   case SDLK_W:
+      return 87;
+   case SDLK_X:
+      return 88;
+   case SDLK_Y:
+      return 89;
+   case SDLK_Z:
+      return 90;
+
+   case SDLK_RETURN:
+      return 128;
+   case SDLK_BACKSPACE:
+      return 129;
+   case SDLK_LEFT:
+      return 130;
+   case SDLK_UP:
+      return 131;
+   case SDLK_RIGHT:
+      return 132;
+   case SDLK_DOWN:
+      return 133;
+   case SDLK_HOME:
+      return 134;
+   case SDLK_END:
+      return 135;
+   case SDLK_PAGEUP:
+      return 136;
+   case SDLK_PAGEDOWN:
+      return 137;
+   case SDLK_INSERT:
+      return 138;
+   case SDLK_DELETE:
+      return 139;
+   case SDLK_ESCAPE:
+      return 140;
+   case SDLK_F1:
+      return 141;
+   case SDLK_F2:
+      return 142;
+   case SDLK_F3:
+      return 143;
+   case SDLK_F4:
+      return 144;
+   case SDLK_F5:
+      return 145;
+   case SDLK_F6:
+      return 146;
+   case SDLK_F7:
+      return 147;
+   case SDLK_F8:
+      return 148;
+   case SDLK_F9:
+      return 149;
+   case SDLK_F10:
+      return 150;
+   case SDLK_F11:
+      return 151;
+   case SDLK_F12:
+      return 152;
+
+   default:
+      return 0;
+   }
+}
+
+void draw_screen(Hack &hack, SDL_Renderer *renderer, SDL_Texture *texture) {
+   auto screen = hack.get_screen_mmap();
+
+   std::array<Uint32, 512 * 256> pixels;
+   std::fill(pixels.begin(), pixels.end(), 0x000000FF);
+
+   for (std::size_t y = 0; y < 256; ++y) {
+      for (std::size_t x_chunk = 0; x_chunk < 32; ++x_chunk) {
+         std::uint16_t chunk = screen[y * 32 + x_chunk];
+         for (std::size_t i = 0; i < 16; ++i) {
+            if (chunk & (1 << i)) {
+               pixels.at(y * 512 + (x_chunk * 16 + i)) = 0xFFFFFFFF;
+            }
+         }
+      }
+   }
+
+   SDL_UpdateTexture(texture, nullptr, pixels.data(), 512 * sizeof(Uint32));
+   SDL_RenderClear(renderer);
+   SDL_RenderTexture(renderer, texture, nullptr, nullptr);
+   SDL_RenderPresent(renderer);
+}
@@ -0,0 +1,15 @@
+#ifndef HACK_SDL_HPP
+#define HACK_SDL_HPP
+
+#include "hack.hpp"
+#include <SDL3/SDL.h>
+#include <cstdint>
+
+// SDL frontend helpers for the emulator. These live outside of the core so that `n2t_hack` can be
+// embedded without pulling in SDL.
+
+std::uint16_t convert_input_to_hack(SDL_Keycode key);
+
+void draw_screen(Hack &hack, SDL_Renderer *renderer, SDL_Texture *texture);
+
+#endif
@@ -0,0 +1,81 @@
+#include "shared.hpp"
+#include <cstring>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define N2T_HAS_SHM
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// keeps the `Hack` on its own cache lines, away from the frame counter
+constexpr std::size_t HACK_OFFSET = 64;
+static_assert(sizeof(SharedHeader) <= HACK_OFFSET);
+
+static std::uint32_t offset_of(const void *segment, const void *member) {
+   return static_cast<const char *>(member) - static_cast<const char *>(segment);
+}
+
+SharedMachine::SharedMachine(std::string name)
+    : m_name { std::move(name) } {
+#ifdef N2T_HAS_SHM
+   int fd = shm_open(m_name.c_str(), O_CREAT | O_RDWR, 0644);
+   if (fd == -1) {
+      return;
+   }
+
+   const std::size_t size = HACK_OFFSET + sizeof(Hack);
+   if (ftruncate(fd, size) == -1) {
+      close(fd);
+      shm_unlink(m_name.c_str());
+      return;
+   }
+
+   void *segment = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   // the mapping stays valid after the descriptor is closed
+   close(fd);
+   if (segment == MAP_FAILED) {
+      shm_unlink(m_name.c_str());
+      return;
+   }
+
+   m_segment = segment;
+   m_size = size;
+   // a header left behind by a previous run mustn't look valid while the new one is set up
+   std::memset(segment, 0, HACK_OFFSET);
+   m_hack = new (static_cast<char *>(segment) + HACK_OFFSET) Hack { };
+   m_header = new (segment) SharedHeader {
+      .magic = { },
+      .version = SHARED_VERSION,
+      .ram_offset = offset_of(segment, m_hack->data_mem.data()),
+      .pc_offset = offset_of(segment, &m_hack->pc),
+      .address_reg_offset = offset_of(segment, &m_hack->address_reg),
+      .data_reg_offset = offset_of(segment, &m_hack->data_reg),
+      .frame = 0,
+   };
+
+   // readers check the magic first, so it's only written once the rest of the header is
+   std::atomic_thread_fence(std::memory_order_release);
+   std::memcpy(m_header->magic.data(), SHARED_MAGIC.data(), SHARED_MAGIC.size());
+#endif
+}
+
+SharedMachine::~SharedMachine() {
+#ifdef N2T_HAS_SHM
+   if (!m_segment) {
+      return;
+   }
+
+   m_hack->~Hack();
+   m_header->~SharedHeader();
+   munmap(m_segment, m_size);
+   shm_unlink(m_name.c_str());
+#endif
+}
+
+bool SharedMachine::is_open() const { return m_segment != nullptr; }
+
+Hack &SharedMachine::hack() { return *m_hack; }
+
+void SharedMachine::next_frame() { m_header->frame.fetch_add(1, std::memory_order_release); }
@@ -0,0 +1,62 @@
+#ifndef HACK_SHARED_HPP
+#define HACK_SHARED_HPP
+
+#include "hack.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Exporting the machine state to other processes.
+//
+// The emulator is constructed inside a POSIX shared memory segment, so local processes can map
+// the segment read only and follow RAM (screen and keyboard included) and the registers as they
+// change, without the emulator copying anything. The segment starts with a `SharedHeader` that
+// tells readers where each value lives, followed by the `Hack` itself.
+// Reads aren't synchronized with the emulator, a value can change while it's being read.
+// Readers that want a consistent picture of the screen should copy it once `frame` changes.
+
+constexpr std::array<char, 8> SHARED_MAGIC { 'N', '2', 'T', 'S', 'T', 'A', 'T', 'E' };
+constexpr std::uint32_t SHARED_VERSION = 1;
+
+struct SharedHeader {
+   std::array<char, 8> magic;
+   std::uint32_t version;
+   // byte offsets from the start of the segment.
+   // RAM is 32768 little endian words, each register a single word.
+   std::uint32_t ram_offset, pc_offset, address_reg_offset, data_reg_offset;
+   // incremented every time the emulator finishes a frame's worth of cycles
+   std::atomic<std::uint64_t> frame;
+};
+
+// readers in other processes can only rely on lock free atomics
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free);
+
+// Owns a shared memory segment holding an emulator.
+// Only available on POSIX systems, elsewhere `is_open` is always false.
+class SharedMachine final {
+   std::string m_name;
+   void *m_segment { nullptr };
+   std::size_t m_size { 0 };
+   SharedHeader *m_header { nullptr };
+   Hack *m_hack { nullptr };
+
+   public:
+   // creates the segment `name` (e.g. `/n2t`), reusing any segment a previous run left behind.
+   // The segment is removed again on destruction.
+   explicit SharedMachine(std::string name);
+   ~SharedMachine();
+
+   SharedMachine(const SharedMachine &) = delete;
+   SharedMachine &operator=(const SharedMachine &) = delete;
+
+   bool is_open() const;
+
+   // the emulator living in the segment, only valid if `is_open`
+   Hack &hack();
+
+   // lets readers know a frame's worth of cycles finished
+   void next_frame();
+};
+
+#endif
@@ -0,0 +1,284 @@
+#include "trace.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace chrono = std::chrono;
+
+// flush the encoded steps to disk once this many bytes are buffered
+constexpr std::size_t WRITE_CHUNK_SIZE = 1 << 16;
+
+static void push_u16(std::vector<std::uint8_t> &buf, std::uint16_t value) {
+   buf.push_back(value);
+   buf.push_back(value >> 8);
+}
+
+// small positive and negative deltas both end up as small numbers, at most 3 bytes are written
+static std::uint8_t *push_delta(std::uint8_t *out, std::uint16_t from, std::uint16_t to) {
+   auto delta = static_cast<std::int16_t>(to - from);
+   std::uint32_t zigzag = (static_cast<std::uint32_t>(delta) << 1) ^ (delta >> 15);
+   zigzag &= 0xFFFF;
+
+   while (zigzag >= 0x80) {
+      *out++ = zigzag | 0x80;
+      zigzag >>= 7;
+   }
+   *out++ = zigzag;
+   return out;
+}
+
+Tracer::Tracer(const std::filesystem::path &path, const Hack &hack)
+    : m_file { path, std::ios::binary }
+    , m_expected_pc { hack.pc }
+    , m_address_reg { hack.address_reg }
+    , m_data_reg { hack.data_reg }
+    , m_ram(hack.data_mem.begin(), hack.data_mem.end()) {
+   m_open = m_file.is_open();
+   if (!m_open) {
+      return;
+   }
+
+   m_buffer.reserve(WRITE_CHUNK_SIZE * 2);
+   m_buffer.insert(m_buffer.end(), TRACE_MAGIC.begin(), TRACE_MAGIC.end());
+   m_buffer.push_back(TRACE_VERSION);
+   push_u16(m_buffer, hack.pc);
+   push_u16(m_buffer, hack.address_reg);
+   push_u16(m_buffer, hack.data_reg);
+   for (auto word : m_ram) {
+      push_u16(m_buffer, word);
+   }
+
+   m_writer = std::jthread([this] { write_loop(); });
+}
+
+Tracer::~Tracer() { finish(); }
+
+bool Tracer::is_open() const { return m_open; }
+
+void Tracer::tick(Hack &hack) {
+   if (!m_writer.joinable()) {
+      hack.tick();
+      return;
+   }
+
+   TraceStep step { .pc = hack.pc, .m_address = hack.address_reg };
+   // a PC past the ROM is reported by `tick`
+   auto inst = hack.instruction_mem[hack.pc & 0x7FFF];
+   hack.tick();
+
+   step.cycle = ++m_cycle;
+   step.address_reg = hack.address_reg;
+   step.data_reg = hack.data_reg;
+
+   bool is_a_instruction = (inst & (1 << 15)) == 0;
+   if (is_a_instruction) {
+      step.writes = TRACE_A;
+   } else {
+      std::uint16_t dest = (inst >> 3) & 0b111;
+      step.writes = (dest & 0b100 ? TRACE_A : 0) | (dest & 0b010 ? TRACE_D : 0)
+          | (dest & 0b001 ? TRACE_M : 0);
+      if (dest & 0b001) {
+         step.m_value = hack.data_mem[step.m_address];
+      }
+   }
+
+   while (!m_queue.try_push(step)) {
+      std::this_thread::yield();
+   }
+}
+
+void Tracer::finish() {
+   m_finished.store(true, std::memory_order_release);
+   if (m_writer.joinable()) {
+      m_writer.join();
+   }
+}
+
+void Tracer::write_loop() {
+   for (;;) {
+      // anything pushed before `finish` is guaranteed to be popped after seeing it
+      bool finished = m_finished.load(std::memory_order_acquire);
+
+      bool popped = false;
+      while (auto step = m_queue.front()) {
+         encode(*step);
+         m_queue.pop();
+         popped = true;
+
+         if (m_buffer.size() >= WRITE_CHUNK_SIZE) {
+            m_file.write(reinterpret_cast<const char *>(m_buffer.data()), m_buffer.size());
+            m_buffer.clear();
+         }
+      }
+
+      if (finished) {
+         break;
+      }
+
+      if (!popped) {
+         std::this_thread::sleep_for(chrono::microseconds(100));
+      }
+   }
+
+   m_file.write(reinterpret_cast<const char *>(m_buffer.data()), m_buffer.size());
+   m_file.close();
+}
+
+void Tracer::encode(const TraceStep &step) {
+   // flags plus up to 4 deltas
+   std::array<std::uint8_t, 13> record;
+   auto out = record.data();
+
+   std::uint8_t flags = step.writes;
+   if (step.pc != m_expected_pc) {
+      flags |= TRACE_JUMP;
+   }
+
+   *out++ = flags;
+   if (flags & TRACE_JUMP) {
+      out = push_delta(out, m_expected_pc, step.pc);
+   }
+   if (flags & TRACE_A) {
+      out = push_delta(out, m_address_reg, step.address_reg);
+      m_address_reg = step.address_reg;
+   }
+   if (flags & TRACE_D) {
+      out = push_delta(out, m_data_reg, step.data_reg);
+      m_data_reg = step.data_reg;
+   }
+   if (flags & TRACE_M) {
+      auto &word = m_ram[step.m_address];
+      out = push_delta(out, word, step.m_value);
+      word = step.m_value;
+   }
+
+   m_expected_pc = step.pc + 1;
+   m_buffer.insert(m_buffer.end(), record.data(), out);
+}
+
+TraceReader::TraceReader(const std::filesystem::path &path)
+    : m_file { path, std::ios::binary }
+    , m_buffer(WRITE_CHUNK_SIZE) {
+   if (!m_file.is_open()) {
+      return;
+   }
+
+   std::array<char, TRACE_MAGIC.size()> magic { };
+   m_file.read(magic.data(), magic.size());
+   if (magic != TRACE_MAGIC || m_file.get() != TRACE_VERSION) {
+      return;
+   }
+
+   auto read_u16 = [this](std::uint16_t &value) {
+      std::uint8_t low, high;
+      if (!read_byte(low) || !read_byte(high)) {
+         return false;
+      }
+      value = low | (high << 8);
+      return true;
+   };
+
+   std::vector<std::uint16_t> ram(32768);
+   if (!read_u16(m_start_pc) || !read_u16(m_address_reg) || !read_u16(m_data_reg)) {
+      return;
+   }
+   for (auto &word : ram) {
+      if (!read_u16(word)) {
+         return;
+      }
+   }
+
+   m_expected_pc = m_start_pc;
+   m_ram = std::move(ram);
+}
+
+bool TraceReader::is_valid() const { return !m_ram.empty(); }
+
+std::uint16_t TraceReader::start_pc() const { return m_start_pc; }
+
+std::span<const std::uint16_t> TraceReader::ram() const { return m_ram; }
+
+bool TraceReader::read_byte(std::uint8_t &byte) {
+   if (m_buffer_idx == m_buffer_size) {
+      m_file.read(m_buffer.data(), m_buffer.size());
+      m_buffer_size = m_file.gcount();
+      m_buffer_idx = 0;
+      if (m_buffer_size == 0) {
+         return false;
+      }
+   }
+
+   byte = m_buffer[m_buffer_idx++];
+   return true;
+}
+
+bool TraceReader::read_delta(std::uint16_t &value) {
+   std::uint32_t zigzag = 0;
+   for (int shift = 0; shift < 21; shift += 7) {
+      std::uint8_t byte;
+      if (!read_byte(byte)) {
+         return false;
+      }
+
+      zigzag |= static_cast<std::uint32_t>(byte & 0x7F) << shift;
+      if (!(byte & 0x80)) {
+         auto delta = static_cast<std::int16_t>((zigzag >> 1) ^ -(zigzag & 1));
+         value += delta;
+         return true;
+      }
+   }
+
+   return false;
+}
+
+bool TraceReader::next(TraceStep &step) {
+   if (!is_valid()) {
+      return false;
+   }
+
+   std::uint8_t flags;
+   if (!read_byte(flags)) {
+      return false;
+   }
+
+   std::uint16_t pc = m_expected_pc, address_reg = m_address_reg, data_reg = m_data_reg;
+   if (flags & TRACE_JUMP && !read_delta(pc)) {
+      return false;
+   }
+   if (flags & TRACE_A && !read_delta(address_reg)) {
+      return false;
+   }
+   if (flags & TRACE_D && !read_delta(data_reg)) {
+      return false;
+   }
+
+   // M is always written at the address A held before the instruction ran
+   const std::uint16_t m_address = m_address_reg;
+   std::uint16_t m_value = 0;
+   if (flags & TRACE_M) {
+      if (m_address >= m_ram.size()) {
+         return false;
+      }
+      m_value = m_ram[m_address];
+      if (!read_delta(m_value)) {
+         return false;
+      }
+      m_ram[m_address] = m_value;
+   }
+
+   m_expected_pc = pc + 1;
+   m_address_reg = address_reg;
+   m_data_reg = data_reg;
+
+   step = TraceStep {
+      .cycle = ++m_cycle,
+      .pc = pc,
+      .address_reg = address_reg,
+      .data_reg = data_reg,
+      .m_address = m_address,
+      .m_value = m_value,
+      .writes = static_cast<std::uint8_t>(flags & (TRACE_A | TRACE_D | TRACE_M)),
+   };
+   return true;
+}
@@ -0,0 +1,115 @@
+#ifndef HACK_TRACE_HPP
+#define HACK_TRACE_HPP
+
+#include "../spsc_queue.hpp"
+#include "hack.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <thread>
+#include <vector>
+
+// Binary execution traces.
+//
+// A trace starts with a header holding the initial registers and RAM, followed by one record per
+// cycle. Records start with a byte of TRACE_* flags and only store what the cycle changed:
+//   TRACE_JUMP  PC of the executed instruction, as a delta from the previous PC + 1
+//   TRACE_A     new A register, as a delta from the previous A
+//   TRACE_D     new D register, as a delta from the previous D
+//   TRACE_M     value written to RAM[A], as a delta from its previous value
+// Deltas are zigzag encoded varints, so a straight-line cycle usually takes 2 or 3 bytes.
+// The cycle number is implicit, the first record is cycle 1.
+
+constexpr std::uint8_t TRACE_JUMP = 1 << 0;
+constexpr std::uint8_t TRACE_A = 1 << 1;
+constexpr std::uint8_t TRACE_D = 1 << 2;
+constexpr std::uint8_t TRACE_M = 1 << 3;
+
+constexpr std::array<char, 8> TRACE_MAGIC { 'N', '2', 'T', 'T', 'R', 'A', 'C', 'E' };
+constexpr std::uint8_t TRACE_VERSION = 1;
+
+struct TraceStep {
+   std::uint64_t cycle { 0 };
+   // address of the executed instruction
+   std::uint16_t pc { 0 };
+   // registers after the instruction ran
+   std::uint16_t address_reg { 0 }, data_reg { 0 };
+   // only meaningful when `writes` has TRACE_M
+   std::uint16_t m_address { 0 }, m_value { 0 };
+   std::uint8_t writes { 0 };
+};
+
+// Records every cycle the emulator runs into a trace file.
+// `tick` only pushes the step into a ring buffer, the encoding and writing is done by a background
+// thread. If the writer falls behind the emulator waits for it instead of dropping cycles.
+class Tracer final {
+   std::ofstream m_file;
+   bool m_open { false };
+   std::uint64_t m_cycle { 0 };
+
+   SpscQueue<TraceStep, 1 << 16> m_queue;
+   std::atomic<bool> m_finished { false };
+
+   // only accessed by the writer thread
+   std::uint16_t m_expected_pc, m_address_reg, m_data_reg;
+   std::vector<std::uint16_t> m_ram;
+   std::vector<std::uint8_t> m_buffer { };
+
+   std::jthread m_writer;
+
+   void write_loop();
+   void encode(const TraceStep &step);
+
+   public:
+   // the current state of `hack` is written as the trace's starting point
+   Tracer(const std::filesystem::path &path, const Hack &hack);
+   ~Tracer();
+
+   Tracer(const Tracer &) = delete;
+   Tracer &operator=(const Tracer &) = delete;
+
+   bool is_open() const;
+
+   // runs a single cycle of `hack` and records it.
+   // Writes to memory mapped devices are recorded with the value left in RAM.
+   void tick(Hack &hack);
+
+   // writes the remaining steps and closes the file, ticking afterwards isn't recorded
+   void finish();
+};
+
+// Reads back the steps of a trace file in order.
+class TraceReader final {
+   std::ifstream m_file;
+   std::vector<char> m_buffer;
+   std::size_t m_buffer_idx { 0 }, m_buffer_size { 0 };
+
+   std::uint64_t m_cycle { 0 };
+   std::uint16_t m_expected_pc { 0 };
+   std::uint16_t m_start_pc { 0 };
+   std::uint16_t m_address_reg { 0 }, m_data_reg { 0 };
+   std::vector<std::uint16_t> m_ram;
+
+   bool read_byte(std::uint8_t &byte);
+   bool read_delta(std::uint16_t &value);
+
+   public:
+   explicit TraceReader(const std::filesystem::path &path);
+
+   // whether the file could be opened and has a valid header
+   bool is_valid() const;
+
+   // decodes the next step, returns false at the end of the trace.
+   // A trace cut short in the middle of a step ends at the last complete one.
+   bool next(TraceStep &step);
+
+   // the PC the trace started at
+   std::uint16_t start_pc() const;
+   // RAM as of the last step read
+   std::span<const std::uint16_t> ram() const;
+};
+
+#endif
@@ -9,33 +9,33 @@ namespace hdl {
 
 std::optional<Range> Parser::parse_range() {
   if (!this->peek_expected(TokenType::OpenBracket)) {
-    auto token = this->peek();
+    const auto &token = this->peek();
     this->emit_error(token,
                      std::format("expected `[`, found `{}`", token.string()));
     return std::nullopt;
   }
-  auto token = this->eat().value();
+  const auto &token = *this->eat();
   Range range{};
   range.start_coord = token.start_coord;
 
   if (!this->peek_expected(TokenType::Number)) {
-    auto token = this->peek();
+    const auto &token = this->peek();
     this->emit_error(
         token, std::format("expected a number, found `{}`", token.string()));
     return std::nullopt;
   }
 
-  range.from = std::get<std::size_t>(this->eat().value().value);
+  range.from = std::get<std::size_t>(this->eat()->value);
 
   if (this->peek_expected(TokenType::CloseBracket)) {
-    auto token = this->eat().value();
+    const auto &token = *this->eat();
     range.to = range.from;
     range.end_coord = token.end_coord;
     return range;
   }
 
   if (!this->peek_expected(TokenType::RangeOp)) {
-    auto token = this->peek();
+    const auto &token = this->peek();
     this->emit_error(token,
                      std::format("expected `..`, found `{}`", token.string()));
     return std::nullopt;
@@ -43,36 +43,36 @@ std::optional<Range> Parser::parse_range() {
   this->eat();
 
   if (!this->peek_expected(TokenType::Number)) {
-    auto token = this->peek();
+    const auto &token = this->peek();
     this->emit_error(
         token, std::format("expected a number, found `{}`", token.string()));
     return std::nullopt;
   }
-  range.to = std::get<std::size_t>(this->eat().value().value);
+  range.to = std::get<std::size_t>(this->eat()->value);
 
   if (!this->peek_expected(TokenType::CloseBracket)) {
-    auto token = this->peek();
+    const auto &token = this->peek();
     this->emit_error(token,
                      std::format("expected `]`, found `{}`", token.string()));
     return std::nullopt;
   }
 
-  token = this->eat().value();
-  range.end_coord = token.end_coord;
+  const auto &end_token = *this->eat();
+  range.end_coord = end_token.end_coord;
 
   return range;
 }
 
 std::optional<Arg> Parser::parse_arg() {
   if (!this->peek_expected(TokenType::Ident)) {
-    auto token = this->peek();
+    const auto &token = this->peek();
     this->emit_error(token,
                      std::format("expected a part parameter but found `{}`",
                                  token.string()));
     return std::nullopt;
   }
   Arg arg{};
-  auto token = this->eat().value();
+  const auto &token = *this->eat();
   arg.name = std::get<std::string>(token.value);
   arg.start_coord = token.start_coord;
 
@@ -83,7 +83,7 @@ std::optional<Arg> Parser::parse_arg() {
   }
 
   if (!this->peek_expected(TokenType::Equal)) {
-    auto token = this->peek();
+    const auto &token = this->peek();
     this->emit_error(token,
                      std::format("expected `=`, found `{}`", token.string()));
     return std::nullopt;
@@ -91,34 +91,34 @@ std::optional<Arg> Parser::parse_arg() {
   this->eat();
 
   if (!this->peek_expected(TokenType::Ident)) {
-    auto token = this->peek();
+    const auto &token = this->peek();
     this->emit_error(
         token, std::format("expected an argument, found `{}`", token.string()));
     return std::nullopt;
   }
 
-  token = this->eat().value();
-  arg.output = std::get<std::string>(token.value);
-  arg.end_coord = token.end_coord;
+  const auto &output_token = *this->eat();
+  arg.output = std::get<std::string>(output_token.value);
+  arg.end_coord = output_token.end_coord;
 
   return arg;
 }
 
 std::optional<Part> Parser::parse_part() {
   if (!this->peek_expected(TokenType::Ident)) {
-    auto token = this->peek();
+    const auto &token = this->peek();
     this->emit_error(
         token, std::format("expected part name, found `{}`", token.string()));
     return std::nullopt;
   }
 
   Part part{};
-  auto token = this->eat().value();
+  const auto &token = *this->eat();
   part.name = std::get<std::string>(token.value);
   part.start_coord = token.start_coord;
 
   if (!this->peek_expected(TokenType::OpenParen)) {
-    auto token = this->peek();
+    const auto &token = this->peek();
     this->emit_error(token,
                      std::format("expected `(`, found `{}`", token.string()));
     return std::nullopt;
@@ -126,7 +126,7 @@ std::optional<Part> Parser::parse_part() {
   this->eat();
 
   if (!this->peek_expected(TokenType::Ident)) {
-    auto token = this->peek();
+    const auto &token = this->peek();
     this->emit_error(token, std::format("expected an argument in the form "
                                         "`a=b` or `a[x..y]=b` but found {}",
                                         token.string()));
@@ -148,7 +148,7 @@ std::optional<Part> Parser::parse_part() {
   }
 
   if (!this->peek_expected(TokenType::CloseParen)) {
-    auto token = this->peek();
+    const auto &token = this->peek();
     this->emit_error(token,
                      std::format("expected `)`, found `{}`", token.string()));
     return std::nullopt;
@@ -156,40 +156,40 @@ std::optional<Part> Parser::parse_part() {
   this->eat();
 
   if (!this->peek_expected(TokenType::Semicolon)) {
-    auto token = this->peek();
+    const auto &token = this->peek();
     this->emit_error(token,
                      std::format("expected `;`, found `{}`", token.string()));
     return std::nullopt;
   }
-  token = this->eat().value();
-  part.end_coord = token.end_coord;
+  const auto &end_token = *this->eat();
+  part.end_coord = end_token.end_coord;
 
   return part;
 }
 
 std::optional<std::vector<InOut>> Parser::parse_inout() {
   if (!this->peek_expected(TokenType::Ident)) {
-    auto token = this->peek();
+    const auto &token = this->peek();
     this->emit_error(token, std::format("expected `IN` or `OUT`, found `{}`",
                                         token.string()));
     return std::nullopt;
   }
 
   InOut inout{};
-  auto keyword = std::get<std::string>(this->eat().value().value);
+  auto keyword = std::get<std::string>(this->eat()->value);
   if (keyword == "IN") {
     inout.input = true;
   } else if (keyword == "OUT") {
     inout.input = false;
   } else {
-    auto token = this->curr_token();
+    const auto &token = this->curr_token();
     this->emit_error(token, std::format("expected `IN` or `OUT`, found `{}`",
                                         token.string()));
     return std::nullopt;
   }
 
   if (this->peek_expected(TokenType::Semicolon)) {
-    auto token = this->peek();
+    const auto &token = this->peek();
     this->emit_error(
         token, std::format("expected pin name, found `{}`", token.string()));
     return std::nullopt;
@@ -198,14 +198,14 @@ std::optional<std::vector<InOut>> Parser::parse_inout() {
   std::vector<InOut> ports;
   while (!this->eof() && this->peek().type != TokenType::Semicolon) {
     if (!this->peek_expected(TokenType::Ident)) {
-      auto token = this->peek();
+      const auto &token = this->peek();
       this->emit_error(
           token, std::format("expected pin name, found `{}`", token.string()));
       return std::nullopt;
     }
 
     InOut port = inout;
-    auto token = this->eat().value();
+    const auto &token = *this->eat();
     port.name = std::get<std::string>(token.value);
     port.size = 1;
     port.start_coord = token.start_coord;
@@ -215,27 +215,27 @@ std::optional<std::vector<InOut>> Parser::parse_inout() {
       this->eat();
 
       if (!this->peek_expected(TokenType::Number)) {
-        auto token = this->peek();
+        const auto &token = this->peek();
         this->emit_error(token, std::format("expected a number, found `{}`",
                                             token.string()));
         return std::nullopt;
       }
-      port.size = std::get<std::size_t>(this->eat().value().value);
+      port.size = std::get<std::size_t>(this->eat()->value);
 
       if (!this->peek_expected(TokenType::CloseBracket)) {
-        auto token = this->peek();
+        const auto &token = this->peek();
         this->emit_error(
             token, std::format("expected `}}`, found `{}`", token.string()));
         return std::nullopt;
       }
-      auto token = this->eat().value();
+      const auto &token = *this->eat();
       port.end_coord = token.end_coord;
     }
 
     ports.push_back(port);
 
     if (this->peek_expected(TokenType::Ident)) {
-      auto token = this->peek();
+      const auto &token = this->peek();
       this->emit_error(token,
                        std::format("missing `,` before `{}`", token.string()));
       this->eat();
@@ -249,7 +249,7 @@ std::optional<std::vector<InOut>> Parser::parse_inout() {
   }
 
   if (!this->peek_expected(TokenType::Semicolon)) {
-    auto token = this->peek();
+    const auto &token = this->peek();
     this->emit_error(token,
                      std::format("expected a `;`, found `{}`", token.string()));
     return std::nullopt;
@@ -262,27 +262,27 @@ std::optional<std::vector<InOut>> Parser::parse_inout() {
 std::optional<Chip> Parser::parse_chip() {
   Chip chip{};
   if (!this->peek_expected(TokenType::Ident)) {
-    auto token = this->peek();
+    const auto &token = this->peek();
     this->emit_error(token, std::format("expected an identifier, found `{}`",
                                         token.string()));
     return std::nullopt;
   }
-  auto curr_token = this->eat().value();
-
-  chip.name = std::get<std::string>(curr_token.value);
+  chip.name = std::get<std::string>(this->eat()->value);
 
   if (!this->peek_expected(TokenType::OpenBrace)) {
-    auto token = this->peek();
+    const auto &token = this->peek();
     this->emit_error(token,
                      std::format("expected `{{`, found `{}`", token.string()));
     return std::nullopt;
   }
   this->eat();
 
-  curr_token = this->peek();
-  while (!this->eof() &&
-         !(curr_token.type == TokenType::Ident &&
-           std::get<std::string>(curr_token.value) == "PARTS")) {
+  const auto at_parts = [this] {
+    const auto &token = this->peek();
+    return token.type == TokenType::Ident &&
+           std::get<std::string>(token.value) == "PARTS";
+  };
+  while (!this->eof() && !at_parts()) {
     auto inout = this->parse_inout();
 
     if (inout.has_value()) {
@@ -292,26 +292,24 @@ std::optional<Chip> Parser::parse_chip() {
     } else {
       break;
     }
-    curr_token = this->peek();
   }
 
   if (!this->peek_expected(TokenType::Ident)) {
-    auto token = this->peek();
+    const auto &token = this->peek();
     this->emit_error(
         token, std::format("expected `PARTS`, found `{}`", token.string()));
     return std::nullopt;
   }
 
-  curr_token = this->eat().value();
-  if (std::get<std::string>(curr_token.value) != "PARTS") {
-    auto token = this->curr_token();
+  if (std::get<std::string>(this->eat()->value) != "PARTS") {
+    const auto &token = this->curr_token();
     this->emit_error(token, std::format("expected `PARTS`, found `{}`",
                                         this->curr_token().string()));
     return std::nullopt;
   }
 
   if (!this->peek_expected(TokenType::Colon)) {
-    auto token = this->peek();
+    const auto &token = this->peek();
     this->emit_error(token,
                      std::format("expected `:`, found `{}`", token.string()));
     return std::nullopt;
@@ -328,7 +326,7 @@ std::optional<Chip> Parser::parse_chip() {
   }
 
   if (!this->peek_expected(TokenType::CloseBrace)) {
-    auto token = this->peek();
+    const auto &token = this->peek();
     this->emit_error(token,
                      std::format("expected `}}`, found `{}`", token.string()));
     return std::nullopt;
@@ -340,15 +338,15 @@ std::optional<Chip> Parser::parse_chip() {
 
 std::optional<std::vector<Chip>> Parser::parse() {
   std::vector<Chip> chips{};
-  Token token{this->curr_token()};
+  const Token *token = &this->curr_token();
   while (!this->eof()) {
-    if (token.type != TokenType::Ident) {
-      this->emit_error(token, std::format("expected an identifier, found `{}`",
-                                          token.string()));
+    if (token->type != TokenType::Ident) {
+      this->emit_error(*token, std::format("expected an identifier, found `{}`",
+                                           token->string()));
       break;
     }
 
-    if (std::get<std::string>(token.value) == "CHIP") {
+    if (std::get<std::string>(token->value) == "CHIP") {
       auto chip = this->parse_chip();
       if (chip.has_value()) {
         chips.push_back(chip.value());
@@ -357,12 +355,12 @@ std::optional<std::vector<Chip>> Parser::parse() {
       }
     } else {
       this->emit_error(
-          token, std::format("expected `CHIP`, found `{}`", token.string()));
+          *token, std::format("expected `CHIP`, found `{}`", token->string()));
       break;
     }
 
     if (m_idx + 1 < m_tokens.size()) {
-      token = this->curr_token();
+      token = &this->curr_token();
     } else {
       break;
     }
@@ -0,0 +1,171 @@
+#ifndef ISA_HPP
+#define ISA_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// Description of the Hack instruction set.
+//
+// The assembler, the disassembler and the emulator all derive their tables from the ones in here
+// at compile time, so there's a single place that knows how instructions are encoded.
+// A C-instruction is laid out as `111a cccc ccdd djjj`, the a-bit and the comp bits (`acccccc`)
+// select the computation, the dest bits where it's stored and the jump bits when to jump.
+namespace isa {
+
+// What the ALU computes. X is always D, Y is A or M depending on the a-bit.
+enum class AluOp : std::uint8_t {
+   Invalid,
+   Zero,
+   One,
+   MinusOne,
+   X,
+   Y,
+   NotX,
+   NotY,
+   NegX,
+   NegY,
+   IncX,
+   IncY,
+   DecX,
+   DecY,
+   XPlusY,
+   XMinusY,
+   YMinusX,
+   XAndY,
+   XOrY,
+   // multiply extension only
+   XTimesY,
+};
+
+struct Computation {
+   std::string_view mnemonic;
+   // the a-bit followed by the 6 comp bits
+   std::uint8_t bits;
+   AluOp op;
+   // only valid with the multiply extension, see `Hack::extended_isa`
+   bool extended { false };
+};
+
+inline constexpr std::array<Computation, 30> COMPUTATIONS { {
+    { "0", 0b0101010, AluOp::Zero },
+    { "1", 0b0111111, AluOp::One },
+    { "-1", 0b0111010, AluOp::MinusOne },
+    { "D", 0b0001100, AluOp::X },
+    { "A", 0b0110000, AluOp::Y },
+    { "M", 0b1110000, AluOp::Y },
+    { "!D", 0b0001101, AluOp::NotX },
+    { "!A", 0b0110001, AluOp::NotY },
+    { "!M", 0b1110001, AluOp::NotY },
+    { "-D", 0b0001111, AluOp::NegX },
+    { "-A", 0b0110011, AluOp::NegY },
+    { "-M", 0b1110011, AluOp::NegY },
+    { "D+1", 0b0011111, AluOp::IncX },
+    { "A+1", 0b0110111, AluOp::IncY },
+    { "M+1", 0b1110111, AluOp::IncY },
+    { "D-1", 0b0001110, AluOp::DecX },
+    { "A-1", 0b0110010, AluOp::DecY },
+    { "M-1", 0b1110010, AluOp::DecY },
+    { "D+A", 0b0000010, AluOp::XPlusY },
+    { "D+M", 0b1000010, AluOp::XPlusY },
+    { "D-A", 0b0010011, AluOp::XMinusY },
+    { "D-M", 0b1010011, AluOp::XMinusY },
+    { "A-D", 0b0000111, AluOp::YMinusX },
+    { "M-D", 0b1000111, AluOp::YMinusX },
+    { "D&A", 0b0000000, AluOp::XAndY },
+    { "D&M", 0b1000000, AluOp::XAndY },
+    { "D|A", 0b0010101, AluOp::XOrY },
+    { "D|M", 0b1010101, AluOp::XOrY },
+    { "D*A", 0b0000001, AluOp::XTimesY, true },
+    { "D*M", 0b1000001, AluOp::XTimesY, true },
+} };
+
+// indexed by the dest bits, each bit stores the result in one register
+inline constexpr std::array<std::string_view, 8> DESTINATIONS {
+   "", "M", "D", "MD", "A", "AM", "AD", "AMD",
+};
+inline constexpr std::uint8_t DEST_M = 0b001;
+inline constexpr std::uint8_t DEST_D = 0b010;
+inline constexpr std::uint8_t DEST_A = 0b100;
+
+// indexed by the jump bits, each bit jumps on one sign of the result
+inline constexpr std::array<std::string_view, 8> JUMPS {
+   "", "JGT", "JEQ", "JGE", "JLT", "JNE", "JLE", "JMP",
+};
+inline constexpr std::uint8_t JUMP_GT = 0b001;
+inline constexpr std::uint8_t JUMP_EQ = 0b010;
+inline constexpr std::uint8_t JUMP_LT = 0b100;
+
+// the jump bits that jump for `result`, a jump is taken if it shares any bit with them
+constexpr std::uint8_t jump_condition(std::uint16_t result) {
+   if (result == 0) {
+      return JUMP_EQ;
+   }
+   // the sign is the top bit, which is why A-instructions can only load 15 bits
+   return (result & (1 << 15)) ? JUMP_LT : JUMP_GT;
+}
+
+// the computation selected by each of the 128 `acccccc` patterns, nothing for invalid ones
+inline constexpr auto DECODED_COMPUTATIONS = [] {
+   std::array<std::optional<Computation>, 128> table { };
+   for (const auto &comp : COMPUTATIONS) {
+      if (table[comp.bits].has_value()) {
+         throw "two computations share the same bits";
+      }
+      table[comp.bits] = comp;
+   }
+   return table;
+}();
+
+// the ALU operation of each `acccccc` pattern, for decoding without going through `Computation`
+inline constexpr auto ALU_OPS = [] {
+   std::array<AluOp, 128> table { };
+   for (const auto &comp : COMPUTATIONS) {
+      table[comp.bits] = comp.op;
+   }
+   return table;
+}();
+
+// packs a mnemonic of up to 3 characters into an integer, 0 if it's too long to be one
+constexpr std::uint32_t mnemonic_key(std::string_view mnemonic) {
+   if (mnemonic.empty() || mnemonic.size() > 3) {
+      return 0;
+   }
+
+   std::uint32_t key = 0;
+   for (const char ch : mnemonic) {
+      key = (key << 8) | static_cast<unsigned char>(ch);
+   }
+   return key;
+}
+
+// the computations sorted by `mnemonic_key`, so they can be binary searched when encoding
+inline constexpr auto COMPUTATIONS_BY_KEY = [] {
+   auto table = COMPUTATIONS;
+   std::sort(table.begin(), table.end(), [](const Computation &a, const Computation &b) {
+      return mnemonic_key(a.mnemonic) < mnemonic_key(b.mnemonic);
+   });
+   return table;
+}();
+
+constexpr std::optional<Computation> find_computation(std::string_view mnemonic) {
+   const auto key = mnemonic_key(mnemonic);
+   const auto by_key = [](const Computation &comp, std::uint32_t key) {
+      return mnemonic_key(comp.mnemonic) < key;
+   };
+   const auto it
+       = std::lower_bound(COMPUTATIONS_BY_KEY.begin(), COMPUTATIONS_BY_KEY.end(), key, by_key);
+   if (it == COMPUTATIONS_BY_KEY.end() || mnemonic_key(it->mnemonic) != key) {
+      return std::nullopt;
+   }
+   return *it;
+}
+
+static_assert(find_computation("D+M")->bits == 0b1000010);
+static_assert(!find_computation("M+D").has_value());
+
+}; // namespace isa
+
+#endif
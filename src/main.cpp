@@ -1,6 +1,13 @@
 #include "asm/asm.hpp"
 #include "gui/gui.hpp"
+#include "hack/capture.hpp"
 #include "hack/hack.hpp"
+#include "hack/idiom.hpp"
+#include "hack/predicate.hpp"
+#include "hack/profile.hpp"
+#include "hack/sdl.hpp"
+#include "hack/shared.hpp"
+#include "hack/trace.hpp"
 // #include "hdl/lexer.hpp"
 // #include "hdl/parser.hpp"
 #include "backends/imgui_impl_opengl3.h"
@@ -12,12 +19,17 @@
 #include <SDL3/SDL_init.h>
 #include <SDL3/SDL_opengl.h>
 #include <SDL3/SDL_video.h>
+#include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <charconv>
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <format>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <optional>
 #include <span>
 #include <sstream>
@@ -43,66 +55,461 @@ int hdl_cmd(std::span<char *> args) {
    return 0;
 }
 
-int asm_cmd(std::span<char *> args) {
-   if (args.empty()) {
-      std::cerr << "missing file argument.\n";
+struct AsmOptions {
+   bool extended_isa { false };
+   // see `assembly::Optimizer`
+   bool optimize { false };
+   // lays the optimized program out by how it ran, see `assembly::Optimizer::set_profile`
+   const Profile *profile { nullptr };
+   // writes a `.hack.map` next to every `.hack`, see `assembly::SourceMap`
+   bool source_map { false };
+   // threads each file is assembled on
+   std::size_t threads { 1 };
+   // programs assembled before are taken from here instead, nothing to always assemble them
+   const assembly::ProgramCache *cache { nullptr };
+};
+
+// assembles `file` printing any errors found to `errors`.
+// `labels` and `source_map` are optional and get filled with the program's labels and source map.
+std::optional<std::vector<std::uint16_t>> assemble_file(const fs::path &file,
+    assembly::Labels *labels = nullptr, const AsmOptions &options = { },
+    std::ostream &errors = std::cerr, assembly::SourceMap *source_map = nullptr) {
+   const report::SourceFile source { file };
+   const assembly::AssemblyFlags flags {
+      .extended_isa = options.extended_isa,
+      .optimize = options.optimize,
+      .source_map = source_map != nullptr,
+   };
+
+   // the optimizer always says how much it saved, also when its output comes from the cache
+   const auto report_optimized = [&](std::ptrdiff_t saved, std::size_t size) {
+      if (options.optimize) {
+         errors << std::format("`{}`: optimized {} instructions down to {}.\n", file.string(),
+             static_cast<std::ptrdiff_t>(size) + saved, size);
+      }
+   };
+
+   // the cache doesn't know about profiles, it's only used without one
+   const auto *cache = options.profile ? nullptr : options.cache;
+   if (cache) {
+      auto cached = cache->load(source.contents(), flags);
+      if (cached.has_value()) {
+         report_optimized(cached->optimized_away, cached->rom.size());
+         if (labels) {
+            *labels = std::move(cached->labels);
+         }
+         if (source_map) {
+            // the same source could have been cached from somewhere else
+            *source_map = std::move(cached->source_map.value());
+            source_map->set_files({ file });
+         }
+         return std::move(cached->rom);
+      }
+   }
+
+   assembly::ParallelAssembler assembler { source, options.threads };
+   assembler.set_extended_isa(options.extended_isa);
+   assembler.set_optimize(options.optimize);
+   if (options.profile) {
+      assembler.set_profile(options.profile->executed, options.profile->taken);
+   }
+   auto asm_output = assembler.assemble();
+   if (!asm_output.has_value()) {
+      errors << assembler.get_error_report();
+      return std::nullopt;
+   }
+   report_optimized(assembler.optimized_away(), asm_output->size());
+   if (options.optimize && options.profile && !assembler.profile_used()) {
+      errors << std::format(
+          "`{}`: the profile isn't of this program optimized with `-O`, it was ignored.\n",
+          file.string());
+   }
+
+   if (cache) {
+      cache->store(source.contents(), flags,
+          {
+              .rom = asm_output.value(),
+              .labels = assembler.get_labels(),
+              .optimized_away = assembler.optimized_away(),
+              .source_map = source_map ? std::optional(assembler.get_source_map()) : std::nullopt,
+          });
+   }
+
+   if (labels) {
+      *labels = assembler.get_labels();
+   }
+   if (source_map) {
+      *source_map = assembler.get_source_map();
+   }
+   return asm_output;
+}
+
+// assembles `input` a line at a time into `output`, see `assembly::StreamAssembler`
+int stream_assemble(std::istream &input, std::ostream &output, const fs::path &name,
+    bool extended_isa) {
+   assembly::StreamAssembler assembler { output, name };
+   assembler.set_extended_isa(extended_isa);
+
+   std::string line { };
+   while (std::getline(input, line)) {
+      assembler.feed_line(line);
+   }
+
+   if (!assembler.finish().has_value()) {
+      std::cerr << assembler.get_error_report();
       return 1;
    }
+   return 0;
+}
 
-   // === parse args ===
-   const fs::path file = args[0];
-   if (!fs::exists(file)) {
-      std::cerr << "File does not exist.\n";
+// an `.asm` file to assemble and where its `.hack` is written
+struct AsmJob {
+   fs::path input;
+   fs::path output;
+};
+
+// expands `inputs` into the `.asm` files to assemble, directories are searched recursively.
+// The outputs go into `output_dir` when given, keeping their path relative to the directory
+// they were found in, and next to their source otherwise.
+std::optional<std::vector<AsmJob>> collect_asm_jobs(
+    std::span<const fs::path> inputs, const std::optional<fs::path> &output_dir) {
+   std::vector<AsmJob> jobs { };
+   const auto add_job = [&](const fs::path &input, const fs::path &relative) {
+      fs::path output = output_dir.has_value() ? output_dir.value() / relative : input;
+      output.replace_extension("hack");
+      jobs.push_back({ .input = input, .output = std::move(output) });
+   };
+
+   for (const auto &input : inputs) {
+      if (!fs::is_directory(input)) {
+         add_job(input, input.filename());
+         continue;
+      }
+
+      // sorted so that the jobs, and the order their errors are reported in, don't depend on
+      // the order the filesystem lists them in
+      std::vector<fs::path> dir_files { };
+      for (const auto &entry : fs::recursive_directory_iterator(input)) {
+         if (entry.is_regular_file() && entry.path().extension() == ".asm") {
+            dir_files.push_back(entry.path());
+         }
+      }
+      std::sort(dir_files.begin(), dir_files.end());
+
+      for (const auto &file : dir_files) {
+         add_job(file, file.lexically_relative(input));
+      }
+   }
+
+   // two jobs writing the same file would race and one of the outputs would be lost
+   std::vector<const AsmJob *> by_output { };
+   by_output.reserve(jobs.size());
+   for (const auto &job : jobs) {
+      by_output.push_back(&job);
+   }
+   std::sort(by_output.begin(), by_output.end(),
+       [](const AsmJob *a, const AsmJob *b) { return a->output < b->output; });
+   for (std::size_t i = 1; i < by_output.size(); i++) {
+      if (by_output[i - 1]->output == by_output[i]->output) {
+         std::cerr << std::format("`{}` and `{}` would both be written to `{}`.\n",
+             by_output[i - 1]->input.string(), by_output[i]->input.string(),
+             by_output[i]->output.string());
+         return std::nullopt;
+      }
+   }
+
+   return jobs;
+}
+
+// assembles `job` writing its errors to `errors`, returns whether the output was written
+bool run_asm_job(const AsmJob &job, const AsmOptions &options, std::ostream &errors) {
+   std::optional<std::vector<std::uint16_t>> asm_output { };
+   assembly::SourceMap source_map { };
+   try {
+      asm_output = assemble_file(
+          job.input, nullptr, options, errors, options.source_map ? &source_map : nullptr);
+   } catch (const std::exception &e) {
+      // one broken file shouldn't take the rest of the batch down with it
+      errors << std::format("Failed to assemble `{}`: {}\n", job.input.string(), e.what());
+      return false;
+   }
+
+   if (!asm_output.has_value()) {
+      return false;
+   }
+
+   if (job.output.has_parent_path()) {
+      std::error_code ec;
+      fs::create_directories(job.output.parent_path(), ec);
+   }
+
+   auto output = assembly::to_string(asm_output.value());
+   std::ofstream asm_file { job.output };
+   asm_file.write(output.c_str(), output.size());
+   if (!asm_file) {
+      errors << std::format("Failed to write `{}`.\n", job.output.string());
+      return false;
+   }
+
+   if (options.source_map) {
+      auto map_file = job.output;
+      map_file += ".map";
+      if (!source_map.write(map_file)) {
+         errors << std::format("Failed to write `{}`.\n", map_file.string());
+         return false;
+      }
+   }
+   return true;
+}
+
+// assembles every job on `threads` workers.
+// Errors are printed once all of them are done in the order of `jobs`, so that they read the same
+// from one run to the next.
+int run_asm_jobs(std::span<const AsmJob> jobs, std::size_t threads, AsmOptions options) {
+   std::vector<std::string> diagnostics(jobs.size());
+   std::vector<char> succeeded(jobs.size(), false);
+
+   // the threads left over when there are fewer files than threads go into the files themselves,
+   // up to as many as `options` allows
+   options.threads = std::clamp<std::size_t>(threads / jobs.size(), 1, options.threads);
+
+   std::atomic<std::size_t> next_job { 0 };
+   const auto worker = [&] {
+      for (auto i = next_job++; i < jobs.size(); i = next_job++) {
+         std::ostringstream errors { };
+         succeeded[i] = run_asm_job(jobs[i], options, errors);
+         diagnostics[i] = std::move(errors).str();
+      }
+   };
+
+   {
+      std::vector<std::jthread> workers { };
+      for (std::size_t i = 1; i < std::min(threads, jobs.size()); i++) {
+         workers.emplace_back(worker);
+      }
+      // the calling thread takes jobs too instead of just waiting
+      worker();
+   }
+
+   for (const auto &diagnostic : diagnostics) {
+      std::cerr << diagnostic;
+   }
+
+   const auto failed = std::count(succeeded.begin(), succeeded.end(), false);
+   if (failed != 0) {
+      if (jobs.size() > 1) {
+         std::cerr << std::format("{} of {} files failed to assemble.\n", failed, jobs.size());
+      }
       return 1;
    }
-   std::optional<const char *> output_flag { };
+   return 0;
+}
 
-   if (args.size() >= 2) {
-      if (args.size() == 3 && std::string_view(args[1]) == "-o") {
-         output_flag = args[2];
+int asm_cmd(std::span<char *> args) {
+   // === parse args ===
+   std::vector<fs::path> inputs { };
+   std::optional<const char *> output_flag { };
+   std::optional<std::size_t> jobs_flag { };
+   std::optional<fs::path> profile_flag { };
+   bool extended_isa = false;
+   bool stream = false;
+   bool optimize = false;
+   bool source_map = false;
+   bool use_cache = true;
+
+   for (std::size_t i = 0; i < args.size(); i++) {
+      const std::string_view flag { args[i] };
+      if (flag == "-o" && i + 1 < args.size()) {
+         output_flag = args[++i];
+      } else if (flag == "-j" && i + 1 < args.size()) {
+         const std::string_view num { args[++i] };
+         std::size_t threads;
+         auto res = std::from_chars(num.data(), num.data() + num.size(), threads);
+         if (res.ec != std::errc() || res.ptr != num.data() + num.size() || threads == 0) {
+            std::cerr << "invalid number of jobs.\n";
+            return 1;
+         }
+         jobs_flag = threads;
+      } else if (flag == "--extended") {
+         extended_isa = true;
+      } else if (flag == "--stream") {
+         stream = true;
+      } else if (flag == "-O") {
+         optimize = true;
+      } else if (flag == "-g") {
+         source_map = true;
+      } else if (flag == "--no-cache") {
+         use_cache = false;
+      } else if (flag == "--profile" && i + 1 < args.size()) {
+         profile_flag = args[++i];
+      } else if (flag == "-" || !flag.starts_with('-')) {
+         inputs.emplace_back(flag);
       } else {
-         std::cerr << "invalid flag. Expected `-o <output_file>`";
+         std::cerr << "invalid flag. Expected `-o <output>`, `-j <jobs>`, `-O`, `-g`, "
+                      "`--profile <file>`, `--extended`, `--stream` or `--no-cache`.\n";
          return 1;
       }
    }
 
-   // === assemble file ===
-   assembly::Lexer lex { file };
-   auto tokens = lex.tokenize();
-   if (tokens.empty()) {
-      std::cerr << "Failed to tokenize file. File is possibly not a valid "
-                   "assembly file.\n";
+   if (inputs.empty()) {
+      std::cerr << "missing file argument.\n";
       return 1;
    }
-   assembly::Parser parser { tokens, file };
-   auto insts_opt = parser.parse();
 
-   if (!insts_opt.has_value()) {
-      std::cerr << parser.get_error_report();
+   // `-` reads the program from stdin, which can only be assembled as it's streamed in
+   const bool from_stdin = std::find(inputs.begin(), inputs.end(), "-") != inputs.end();
+   if ((from_stdin || stream) && inputs.size() > 1) {
+      std::cerr << "only one file can be assembled when streaming.\n";
       return 1;
    }
+   stream = stream || from_stdin;
 
-   auto instructions = insts_opt.value();
-   assembly::CodeGen codegen { instructions, file };
-   auto asm_output = codegen.compile();
-   if (!asm_output.has_value()) {
-      std::cerr << codegen.get_error_report();
+   // the stream assembler forgets the lines it's done with
+   if (stream && source_map) {
+      std::cerr << "`-g` can't be combined with `--stream` or reading from stdin.\n";
       return 1;
    }
 
-   auto output = assembly::to_string(asm_output.value());
+   for (const auto &input : inputs) {
+      if (input != "-" && !fs::exists(input)) {
+         std::cerr << std::format("`{}` does not exist.\n", input.string());
+         return 1;
+      }
+   }
+
+   // a single file is written to the -o path, anything more goes into the -o directory
+   const bool batch = inputs.size() > 1 || fs::is_directory(inputs[0])
+       || (output_flag.has_value() && fs::is_directory(output_flag.value()));
+
+   // a profile is of a single program, as optimized without it
+   std::optional<Profile> profile { };
+   if (profile_flag.has_value()) {
+      if (!optimize || stream || batch) {
+         std::cerr << "`--profile` needs `-O` and a single file that isn't streamed.\n";
+         return 1;
+      }
+      profile = read_profile(profile_flag.value());
+      if (!profile.has_value()) {
+         std::cerr << "Failed to read profile. File is possibly not a valid profile.\n";
+         return 1;
+      }
+   }
+
+   if (stream) {
+      const fs::path &file = inputs[0];
+      // the output goes to stdout when reading from stdin, unless told otherwise
+      const bool to_stdout = output_flag.has_value() ? output_flag.value() == std::string_view("-")
+                                                     : from_stdin;
+      std::ifstream input_file { };
+      if (!from_stdin) {
+         input_file.open(file, std::ios::binary);
+      }
+      std::istream &input = from_stdin ? std::cin : input_file;
+      const fs::path name = from_stdin ? fs::path("<stdin>") : file;
+
+      if (to_stdout) {
+         return stream_assemble(input, std::cout, name, extended_isa);
+      }
+
+      fs::path output_file { file };
+      if (output_flag.has_value()) {
+         output_file = output_flag.value();
+      } else {
+         output_file.replace_extension("hack");
+      }
 
-   // === write compiled artifact to file ===
-   fs::path output_file { file };
+      std::ofstream asm_file { output_file };
+      auto result = stream_assemble(input, asm_file, name, extended_isa);
+      if (result != 0) {
+         // nothing's left behind on errors, just like when not streaming
+         asm_file.close();
+         fs::remove(output_file);
+      }
+      return result;
+   }
+
+   // === assemble files ===
+   const auto threads = jobs_flag.value_or(std::max(1u, std::thread::hardware_concurrency()));
+   const assembly::ProgramCache cache { };
+   const AsmOptions options {
+      .extended_isa = extended_isa,
+      .optimize = optimize,
+      .profile = profile.has_value() ? &profile.value() : nullptr,
+      .source_map = source_map,
+      // files are only split over threads when asked to, it hasn't been shown to pay off yet
+      .threads = jobs_flag.has_value() ? threads : 1,
+      .cache = use_cache ? &cache : nullptr,
+   };
+
+   if (!batch) {
+      fs::path output_file { inputs[0] };
+      if (output_flag.has_value()) {
+         output_file = output_flag.value();
+      } else {
+         output_file.replace_extension("hack");
+      }
+
+      const AsmJob job { .input = inputs[0], .output = output_file };
+      return run_asm_jobs(std::span(&job, 1), threads, options);
+   }
+
+   std::optional<fs::path> output_dir { };
    if (output_flag.has_value()) {
-      output_file = output_flag.value();
-   } else {
-      output_file.replace_extension("hack");
+      output_dir = output_flag.value();
+      if (fs::exists(output_dir.value()) && !fs::is_directory(output_dir.value())) {
+         std::cerr << "`-o` has to be a directory when assembling more than one file.\n";
+         return 1;
+      }
    }
 
-   std::ofstream asm_file { output_file.filename() };
-   asm_file.write(output.c_str(), output.size());
-   return 0;
+   auto jobs = collect_asm_jobs(inputs, output_dir);
+   if (!jobs.has_value()) {
+      return 1;
+   }
+
+   return run_asm_jobs(jobs.value(), threads, options);
+}
+
+// adds the labels of `source_map` in front of the instructions they point at, and the line every
+// instruction was written at after it. `disasm` has to be an instruction per line.
+std::string annotate_disassembly(std::string_view disasm, const assembly::SourceMap &source_map) {
+   const auto &declared = source_map.declared_labels();
+   std::vector<std::pair<std::uint16_t, std::string_view>> labels { };
+   labels.reserve(declared.size());
+   for (const auto &[name, pc] : declared) {
+      labels.emplace_back(pc, name);
+   }
+   // stable so that labels at the same PC keep their order
+   std::stable_sort(labels.begin(), labels.end(),
+       [](const auto &a, const auto &b) { return a.first < b.first; });
+
+   std::string output { };
+   auto next_label = labels.begin();
+   const auto emit_labels = [&](std::size_t pc) {
+      for (; next_label != labels.end() && next_label->first <= pc; ++next_label) {
+         output += std::format("({})\n", next_label->second);
+      }
+   };
+
+   std::size_t pc = 0;
+   for (std::size_t start = 0, end; (end = disasm.find('\n', start)) != disasm.npos;
+       start = end + 1, pc++) {
+      emit_labels(pc);
+      output += disasm.substr(start, end - start);
+      // the ROM can't be addressed past a u16 anyway
+      const auto loc = pc <= std::numeric_limits<std::uint16_t>::max()
+          ? source_map.location(static_cast<std::uint16_t>(pc))
+          : std::nullopt;
+      if (loc.has_value()) {
+         const auto &files = source_map.files();
+         const auto name = loc->file < files.size() ? files[loc->file].filename().string() : "";
+         output += std::format("  // {}:{}", name, loc->row + 1);
+      }
+      output += '\n';
+   }
+   // labels at the very end of the program
+   emit_labels(std::numeric_limits<std::size_t>::max());
+   return output;
 }
 
 int disasm_cmd(std::span<char *> args) {
@@ -111,23 +518,73 @@ int disasm_cmd(std::span<char *> args) {
       return 1;
    }
 
+   bool extended_isa = false;
+   for (std::size_t i = 1; i < args.size(); i++) {
+      if (std::string_view(args[i]) == "--extended") {
+         extended_isa = true;
+      } else {
+         std::cerr << "invalid flag. Expected `--extended`.\n";
+         return 1;
+      }
+   }
+
    fs::path file { args[0] };
    std::ifstream input { file };
    std::stringstream ss;
    ss << input.rdbuf();
 
-   auto disasm = assembly::disassemble(ss.str());
+   auto disasm = assembly::disassemble(ss.str(), extended_isa);
    if (!disasm.has_value()) {
       std::cerr << "Failed to disassemble file. It is possibly not a valid Hack ROM.\n";
       return 1;
    }
 
+   // with a source map the labels are put back and every instruction says where it came from
+   auto map_file = file;
+   map_file += ".map";
+   if (fs::exists(map_file)) {
+      const auto source_map = assembly::SourceMap::read(map_file);
+      const auto lines = std::count(disasm->begin(), disasm->end(), '\n');
+      if (source_map.has_value() && static_cast<std::size_t>(lines) == source_map->size()) {
+         disasm = annotate_disassembly(disasm.value(), source_map.value());
+      } else {
+         std::cerr << std::format(
+             "`{}` isn't a source map of this ROM, it was ignored.\n", map_file.string());
+      }
+   }
+
    file.replace_extension(".disasm");
    std::ofstream disasm_file { file };
    disasm_file << disasm.value();
    return 0;
 }
 
+// `source_map` is optional and says where in the source the PC is
+void print_hack_state(
+    const Hack &hack, std::uint64_t cycles, const assembly::SourceMap *source_map = nullptr) {
+   std::cout << std::format(
+       "Stopped after {} cycles: PC={} A={} D={}", cycles, hack.pc, hack.address_reg,
+       static_cast<std::int16_t>(hack.data_reg));
+   if (source_map && hack.pc < source_map->size()) {
+      std::cout << std::format(" at {}", source_map->describe(hack.pc));
+   }
+   std::cout << '\n';
+}
+
+// runs up to `ticks` cycles of `hack` handling memory accesses with `Policy`,
+// stopping early once `until` holds
+template <MemoryPolicy Policy>
+RunResult run_with_policy(Hack &hack, const std::optional<Predicate> &until, std::uint64_t ticks) {
+   if (until.has_value()) {
+      return run_until(hack, until.value(), ticks, [](Hack &hack) { hack.tick<Policy>(); });
+   }
+
+   for (std::uint64_t i = 0; i < ticks; i++) {
+      hack.tick<Policy>();
+   }
+   return RunResult { .cycles = ticks, .reached = false };
+}
+
 int run_cmd(std::span<char *> args) {
    if (args.empty()) {
       std::cerr << "missing file argument.\n";
@@ -140,43 +597,284 @@ int run_cmd(std::span<char *> args) {
       return 1;
    }
 
-   // === load and validate ROM ===
-   std::ifstream input_stream { file };
-   std::string tmp_str { };
-   std::string input { };
-   while (std::getline(input_stream, tmp_str)) {
-      input += tmp_str + '\n';
-      for (const auto ch : tmp_str) {
-         if (std::isdigit(ch) || std::isspace(ch)) {
-            continue;
+   // === parse args ===
+   std::optional<std::string_view> until_flag { };
+   std::optional<std::uint64_t> max_cycles_flag { };
+   std::optional<fs::path> record_flag { };
+   std::optional<fs::path> trace_flag { };
+   std::optional<fs::path> profile_flag { };
+   std::optional<std::string> share_flag { };
+   std::optional<MemoryPolicy> memory_flag { };
+   bool headless = false, fast_loops = false, extended_isa = false, optimize = false;
+   bool use_cache = true;
+
+   for (std::size_t i = 1; i < args.size(); i++) {
+      const std::string_view flag { args[i] };
+      if (flag == "--headless") {
+         headless = true;
+      } else if (flag == "--fast-loops") {
+         fast_loops = true;
+      } else if (flag == "--extended") {
+         extended_isa = true;
+      } else if (flag == "-O") {
+         optimize = true;
+      } else if (flag == "--no-cache") {
+         use_cache = false;
+      } else if (flag == "--record" && i + 1 < args.size()) {
+         record_flag = args[++i];
+      } else if (flag == "--trace" && i + 1 < args.size()) {
+         trace_flag = args[++i];
+      } else if (flag == "--profile" && i + 1 < args.size()) {
+         profile_flag = args[++i];
+      } else if (flag == "--share" && i + 1 < args.size()) {
+         share_flag = args[++i];
+      } else if (flag == "--memory" && i + 1 < args.size()) {
+         const std::string_view policy { args[++i] };
+         if (policy == "checked") {
+            memory_flag = MemoryPolicy::Checked;
+         } else if (policy == "masked") {
+            memory_flag = MemoryPolicy::Masked;
+         } else if (policy == "unchecked") {
+            memory_flag = MemoryPolicy::Unchecked;
+         } else {
+            std::cerr << "invalid memory policy. Expected checked, masked or unchecked.\n";
+            return 1;
          }
-
-         if (asm_cmd(args) != 0) {
+      } else if (flag == "--until" && i + 1 < args.size()) {
+         until_flag = args[++i];
+      } else if (flag == "--max-cycles" && i + 1 < args.size()) {
+         const std::string_view num { args[++i] };
+         std::uint64_t cycles;
+         auto res = std::from_chars(num.data(), num.data() + num.size(), cycles);
+         if (res.ec != std::errc() || res.ptr != num.data() + num.size()) {
+            std::cerr << "invalid number of cycles.\n";
             return 1;
          }
+         max_cycles_flag = cycles;
+      } else {
+         std::cerr << std::format("invalid flag `{}`. Check `help` for the available flags.\n", flag);
+         return 1;
+      }
+   }
 
-         auto compiled_filepath = fs::path(file).replace_extension("hack");
+   if (headless && !until_flag.has_value() && !max_cycles_flag.has_value()) {
+      std::cerr << "headless runs need either `--until` or `--max-cycles` to stop.\n";
+      return 1;
+   }
 
-         std::ifstream compiled_file { compiled_filepath };
-         if (!compiled_file.is_open()) {
-            std::cerr << "Failed to open file.\n";
-         }
+   // both have to observe every single cycle
+   if (fast_loops
+       && (until_flag.has_value() || trace_flag.has_value() || profile_flag.has_value())) {
+      std::cerr << "`--fast-loops` can't be combined with `--until`, `--trace` or `--profile`.\n";
+      return 1;
+   }
 
-         std::stringstream strbuf;
-         strbuf << compiled_file.rdbuf();
-         input = strbuf.str();
-         goto load_rom;
+   // both run every cycle themselves
+   if (trace_flag.has_value() && profile_flag.has_value()) {
+      std::cerr << "`--trace` can't be combined with `--profile`.\n";
+      return 1;
+   }
+
+   // traces, profiles and fast loops always check memory accesses
+   if (memory_flag.has_value()
+       && (fast_loops || trace_flag.has_value() || profile_flag.has_value())) {
+      std::cerr << "`--memory` can't be combined with `--fast-loops`, `--trace` or `--profile`.\n";
+      return 1;
+   }
+
+   // === load and validate ROM ===
+   std::ifstream input_stream { file };
+   std::stringstream input_buf;
+   input_buf << input_stream.rdbuf();
+   const std::string input = input_buf.str();
+
+   bool is_binary = std::all_of(
+       input.begin(), input.end(), [](char ch) { return std::isdigit(ch) || std::isspace(ch); });
+
+   std::optional<std::vector<std::uint16_t>> rom { };
+   assembly::Labels labels { };
+   std::optional<assembly::SourceMap> source_map { };
+   if (is_binary) {
+      rom = parse_rom(input);
+      if (!rom.has_value()) {
+         std::cerr << "Failed to load file. It is possibly not a valid Hack ROM.\n";
+         return 1;
+      }
+
+      // written by `asm -g`, it gives the ROM back its labels
+      auto map_file = file;
+      map_file += ".map";
+      if (fs::exists(map_file)) {
+         source_map = assembly::SourceMap::read(map_file);
+         if (!source_map.has_value() || source_map->size() != rom->size()) {
+            std::cerr << std::format(
+                "`{}` isn't a source map of this ROM, it was ignored.\n", map_file.string());
+            source_map.reset();
+         } else {
+            labels = source_map->labels();
+         }
+      }
+   } else {
+      const assembly::ProgramCache cache { };
+      const AsmOptions options {
+         .extended_isa = extended_isa,
+         .optimize = optimize,
+         .cache = use_cache ? &cache : nullptr,
+      };
+      source_map.emplace();
+      rom = assemble_file(file, &labels, options, std::cerr, &source_map.value());
+      if (!rom.has_value()) {
+         return 1;
       }
    }
+   const auto *map = source_map.has_value() ? &source_map.value() : nullptr;
 
-load_rom:
-   if (input.empty()) {
+   if (rom->empty()) {
       std::cout << "The hack ROM is empty.\n";
       return 1;
    }
 
-   Hack hack { };
-   hack.load_rom(input);
+   std::optional<SharedMachine> shared { };
+   if (share_flag.has_value()) {
+      shared.emplace(share_flag.value());
+      if (!shared->is_open()) {
+         std::cerr << "Failed to create the shared memory segment.\n";
+         return 1;
+      }
+   }
+
+   Hack local_hack { };
+   Hack &hack = shared.has_value() ? shared->hack() : local_hack;
+   hack.extended_isa = extended_isa;
+   if (!hack.load_rom(rom.value())) {
+      std::cerr << "The hack ROM doesn't fit in instruction memory.\n";
+      return 1;
+   }
+
+   IdiomEngine idioms { };
+   if (fast_loops) {
+      idioms.analyze(hack.instruction_mem);
+   }
+
+   std::optional<Predicate> until { };
+   if (until_flag.has_value()) {
+      std::string error { };
+      until = Predicate::compile(until_flag.value(), labels, error);
+      if (!until.has_value()) {
+         std::cerr << std::format("invalid `--until` expression: {}.\n", error);
+         return 1;
+      }
+   }
+
+   std::optional<ScreenRecorder> recorder { };
+   if (record_flag.has_value()) {
+      recorder.emplace(record_flag.value());
+      if (!recorder->is_open()) {
+         std::cerr << "Failed to open the recording file.\n";
+         return 1;
+      }
+   }
+
+   std::optional<Tracer> tracer { };
+   if (trace_flag.has_value()) {
+      tracer.emplace(trace_flag.value(), hack);
+      if (!tracer->is_open()) {
+         std::cerr << "Failed to open the trace file.\n";
+         return 1;
+      }
+   }
+
+   std::optional<Profiler> profiler { };
+   if (profile_flag.has_value()) {
+      profiler.emplace(profile_flag.value(), rom->size());
+      if (!profiler->is_open()) {
+         std::cerr << "Failed to open the profile file.\n";
+         return 1;
+      }
+   }
+
+   constexpr int ticks_per_frame = 1000000 / 16.6;
+   std::uint64_t cycles = 0;
+   const std::uint64_t max_cycles
+       = max_cycles_flag.value_or(std::numeric_limits<std::uint64_t>::max());
+   bool reached = false, stopped = false;
+
+   // runs up to `ticks` cycles, returns false if the program crashed
+   auto run_ticks = [&](std::uint64_t ticks) -> bool {
+      ticks = std::min(ticks, max_cycles - cycles);
+      try {
+         if (until.has_value() && tracer.has_value()) {
+            auto result = run_until(
+                hack, until.value(), ticks, [&tracer](Hack &hack) { tracer->tick(hack); });
+            cycles += result.cycles;
+            reached = result.reached;
+         } else if (tracer.has_value()) {
+            for (std::uint64_t i = 0; i < ticks; i++) {
+               tracer->tick(hack);
+               ++cycles;
+            }
+         } else if (until.has_value() && profiler.has_value()) {
+            auto result = run_until(
+                hack, until.value(), ticks, [&profiler](Hack &hack) { profiler->tick(hack); });
+            cycles += result.cycles;
+            reached = result.reached;
+         } else if (profiler.has_value()) {
+            for (std::uint64_t i = 0; i < ticks; i++) {
+               profiler->tick(hack);
+               ++cycles;
+            }
+         } else if (fast_loops) {
+            idioms.run(hack, ticks);
+            cycles += ticks;
+         } else {
+            RunResult result { };
+            switch (memory_flag.value_or(MemoryPolicy::Checked)) {
+            case MemoryPolicy::Checked:
+               result = run_with_policy<MemoryPolicy::Checked>(hack, until, ticks);
+               break;
+            case MemoryPolicy::Masked:
+               result = run_with_policy<MemoryPolicy::Masked>(hack, until, ticks);
+               break;
+            case MemoryPolicy::Unchecked:
+               result = run_with_policy<MemoryPolicy::Unchecked>(hack, until, ticks);
+               break;
+            }
+            cycles += result.cycles;
+            reached = result.reached;
+         }
+      } catch (std::string err) {
+         std::cerr << err << '\n';
+         // the PC has already moved past the instruction that failed
+         const std::uint16_t pc = hack.pc - 1;
+         if (map && pc < map->size()) {
+            std::cerr << std::format("  at {}\n", map->describe(pc));
+         }
+         return false;
+      }
+
+      stopped = reached || cycles >= max_cycles;
+      if (recorder.has_value()) {
+         recorder->capture(hack.get_screen_mmap());
+      }
+      if (shared.has_value()) {
+         shared->next_frame();
+      }
+      return true;
+   };
+
+   // === Run headless ===
+   if (headless) {
+      // still runs a frame at a time so that recordings keep the same frame rate
+      while (!stopped) {
+         if (!run_ticks(ticks_per_frame)) {
+            return 1;
+         }
+      }
+
+      print_hack_state(hack, cycles, map);
+      // scripts can rely on the exit code to know if the condition was reached
+      return until.has_value() && !reached ? 1 : 0;
+   }
 
    // === Run/Emulate ===
    if (!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS)) {
@@ -199,8 +897,6 @@ load_rom:
        renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, 512, 256);
    SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_NEAREST);
 
-   constexpr int ticks_per_frame = 1000000 / 16.6;
-
    for (;;) {
       auto frame_start = chrono::high_resolution_clock::now();
 
@@ -218,13 +914,14 @@ load_rom:
          }
       }
 
-      for (std::size_t i = 0; i < ticks_per_frame; i++) {
-         try {
-            hack.tick();
-         } catch (std::string err) {
-            std::cerr << err << '\n';
+      if (!stopped) {
+         if (!run_ticks(ticks_per_frame)) {
             return 1;
          }
+
+         if (stopped) {
+            print_hack_state(hack, cycles, map);
+         }
       }
 
       float frame_end = 0.0f;
@@ -233,7 +930,7 @@ load_rom:
              chrono::high_resolution_clock::now() - frame_start)
                          .count();
       }
-      hack.draw_screen(renderer, texture);
+      draw_screen(hack, renderer, texture);
    }
 
    SDL_DestroyTexture(texture);
@@ -242,6 +939,113 @@ load_rom:
    return 0;
 }
 
+// answers questions about a trace recorded with `run --trace`
+int trace_cmd(std::span<char *> args) {
+   if (args.size() == 0) {
+      std::cout << "Missing file argument.\n";
+      return 1;
+   }
+
+   TraceReader reader { args[0] };
+   if (!reader.is_valid()) {
+      std::cerr << "Failed to read trace. File is possibly not a valid trace.\n";
+      return 1;
+   }
+
+   const std::string_view query = args.size() > 1 ? args[1] : "summary";
+   if (query != "summary" && query != "pc" && query != "ram" && query != "at") {
+      std::cerr << std::format("Unknown query `{}`. Expected summary, pc, ram or at.\n", query);
+      return 1;
+   }
+
+   std::uint64_t arg = 0;
+   if (query != "summary") {
+      const std::string_view arg_str = args.size() > 2 ? args[2] : "";
+      auto res = std::from_chars(arg_str.data(), arg_str.data() + arg_str.size(), arg);
+      if (arg_str.empty() || res.ec != std::errc() || res.ptr != arg_str.data() + arg_str.size()) {
+         std::cerr << std::format("`{}` expects a number.\n", query);
+         return 1;
+      }
+   }
+
+   TraceStep step { };
+   if (query == "summary") {
+      TraceStep last { .pc = reader.start_pc() };
+      while (reader.next(step)) {
+         last = step;
+      }
+      std::cout << std::format("{} cycles, started at PC={}\n", last.cycle, reader.start_pc());
+      std::cout << std::format(
+          "Last cycle: PC={} A={} D={}\n", last.pc, last.address_reg, last.data_reg);
+      return 0;
+   }
+
+   if (query == "pc") {
+      std::uint64_t hits = 0, first = 0, last = 0;
+      while (reader.next(step)) {
+         if (step.pc == arg) {
+            first = hits == 0 ? step.cycle : first;
+            last = step.cycle;
+            ++hits;
+         }
+      }
+
+      if (hits == 0) {
+         std::cout << std::format("PC never reached {}\n", arg);
+         return 1;
+      }
+      std::cout << std::format(
+          "PC={} executed {} times, first at cycle {}, last at cycle {}\n", arg, hits, first, last);
+      return 0;
+   }
+
+   if (query == "ram") {
+      if (arg >= reader.ram().size()) {
+         std::cerr << "RAM address out of range.\n";
+         return 1;
+      }
+
+      const std::uint16_t initial = reader.ram()[arg];
+      std::uint16_t value = initial;
+      std::uint64_t writes = 0, changes = 0, first = 0, last = 0;
+      while (reader.next(step)) {
+         if (!(step.writes & TRACE_M) || step.m_address != arg) {
+            continue;
+         }
+
+         ++writes;
+         if (step.m_value != value) {
+            first = changes == 0 ? step.cycle : first;
+            last = step.cycle;
+            ++changes;
+         }
+         value = step.m_value;
+      }
+
+      if (changes == 0) {
+         std::cout << std::format(
+             "RAM[{}] never changed from {}, written {} times\n", arg, initial, writes);
+         return 0;
+      }
+      std::cout << std::format("RAM[{}] changed {} times ({} writes), first at cycle {}, last at "
+                               "cycle {} to {}\n",
+          arg, changes, writes, first, last, value);
+      return 0;
+   }
+
+   // at <cycle>
+   while (reader.next(step)) {
+      if (step.cycle == arg) {
+         std::cout << std::format("Cycle {}: executed PC={}, then A={} D={}\n", arg, step.pc,
+             step.address_reg, step.data_reg);
+         return 0;
+      }
+   }
+
+   std::cerr << std::format("Trace ends before cycle {}.\n", arg);
+   return 1;
+}
+
 int gui_cmd() {
    if (!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS)) {
       std::cerr << SDL_GetError() << '\n';
@@ -316,11 +1120,14 @@ int gui_cmd() {
             goto cleanup;
 
          case SDL_EVENT_KEY_DOWN:
-            gui.key.store(e.key.key, std::memory_order_release);
+            gui.key_events.try_push(gui::KeyEvent {
+                .timestamp = e.key.timestamp,
+                .key = convert_input_to_hack(e.key.key),
+            });
             break;
 
          case SDL_EVENT_KEY_UP:
-            gui.key = std::nullopt;
+            gui.key_events.try_push(gui::KeyEvent { .timestamp = e.key.timestamp, .key = 0 });
             break;
 
          case SDL_EVENT_SYSTEM_THEME_CHANGED:
@@ -380,9 +1187,48 @@ void print_help(const char *program) {
                             "\trun\tRun the hack emulator\n"
                             "\tasm\tCompile assembly into hack instructions\n"
                             "\tdisasm\tDisassemble hack instructions\n"
+                            "\ttrace\tQuery an execution trace\n"
                             "\thdl\tResolve hdl circuit\n"
                             "\tgui\tRun N2T GUI suite\n"
-                            "\thelp\tPrint this message\n",
+                            "\thelp\tPrint this message\n"
+                            "\n"
+                            "Asm options:\n"
+                            "\t-o <path>\t\tWrite the output to path, `-` for stdout, a directory "
+                            "with several files\n"
+                            "\t-j <n>\t\t\tAssemble on up to n threads, also splitting large "
+                            "files, a file per core by default\n"
+                            "\t--stream\t\tAssemble in a single pass while reading, `-` as the "
+                            "file reads stdin\n"
+                            "\t-O\t\t\tOptimize the program, printing how many instructions it "
+                            "saved (also for run)\n"
+                            "\t--profile <file>\tLay the optimized program out by a profile "
+                            "recorded with run\n"
+                            "\t-g\t\t\tWrite a .hack.map source map next to the output, read "
+                            "by run and disasm\n"
+                            "\t--no-cache\t\tAlways assemble, even sources assembled before (also "
+                            "for run)\n"
+                            "\n"
+                            "Run options:\n"
+                            "\t--headless\t\tRun without opening a window\n"
+                            "\t--until <expr>\t\tStop once expr holds, e.g. `RAM[0]==5 && PC==@END`\n"
+                            "\t--max-cycles <n>\tStop after running n cycles\n"
+                            "\t--record <file.png>\tRecord the screen into an animated PNG\n"
+                            "\t--trace <file>\t\tRecord every cycle into a binary trace\n"
+                            "\t--profile <file>\tCount how often each instruction runs and "
+                            "jumps, for asm -O\n"
+                            "\t--share <name>\t\tExport RAM and registers as a shared memory segment, "
+                            "e.g. `/n2t`\n"
+                            "\t--fast-loops\t\tRun common loops natively, e.g. screen fills\n"
+                            "\t--memory <policy>\tHow A > 32767 is handled: checked (default), masked "
+                            "or unchecked\n"
+                            "\t--extended\t\tEnable the D*A and D*M instructions (also for asm "
+                            "and disasm)\n"
+                            "\n"
+                            "Trace queries:\n"
+                            "\tsummary\t\tNumber of cycles and the final registers (default)\n"
+                            "\tpc <addr>\tFirst and last time the instruction at addr ran\n"
+                            "\tram <addr>\tFirst and last time RAM[addr] changed\n"
+                            "\tat <cycle>\tRegisters after the given cycle\n",
        program, program);
 }
 
@@ -415,6 +1261,10 @@ int main(int argc, char *argv[]) {
       return run_cmd(cmd_args);
    }
 
+   if (cmd == "trace") {
+      return trace_cmd(cmd_args);
+   }
+
    if (cmd == "gui") {
       return gui_cmd();
    }
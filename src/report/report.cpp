@@ -3,28 +3,13 @@
 #include <filesystem>
 #include <format>
 #include <optional>
-#include <sstream>
+#include <string_view>
 #include <vector>
 
 namespace report {
 
-Context::Context(const std::filesystem::path filepath)
-    : m_filepath { filepath }
-    , m_contents { filepath } {
-   if (!std::filesystem::exists(filepath)) {
-      // TODO check appropriate exception to throw
-      throw "The assembly file path does not exist";
-   }
-
-   std::ifstream file { filepath };
-   std::stringstream ss;
-   ss << file.rdbuf();
-   m_stream.str(ss.str());
-}
-
-Context::Context(std::string_view contents)
-    : m_stream { std::string(contents) }
-    , m_contents { contents } { }
+Context::Context(const SourceFile &source)
+    : m_source { source } { }
 
 void Context::create_report(ReportType type, Coord start, Coord end, std::string_view error_msg) {
    Report rep {
@@ -40,7 +25,7 @@ void Context::create_report(ReportType type, Coord start, Coord end, std::string
 }
 
 std::string generate_individual_report(
-    std::filesystem::path filepath, std::string_view line, Report report) {
+    const SourceFile &source, std::string_view line, Report report) {
    auto error_type_str = "";
    switch (report.type) {
    case report::ReportType::Error:
@@ -53,10 +38,10 @@ std::string generate_individual_report(
 
    // editors are 1-indexed so we have to display this
    auto editor_col = report.start_col + 1;
-   auto editor_row = report.start_row + 1;
+   auto editor_row = source.first_row() + report.start_row + 1;
 
    std::string report_str = std::format(
-       "-> {} on {}:{}:{}\n", error_type_str, filepath.c_str(), editor_row, editor_col);
+       "-> {} on {}:{}:{}\n", error_type_str, source.path().c_str(), editor_row, editor_col);
 
    const auto rownum = std::to_string(editor_row);
    std::string row_padding { };
@@ -105,18 +90,25 @@ std::optional<std::string> Context::generate_final_report() {
    std::sort(m_reports.begin(), m_reports.end(),
        [](Report a, Report b) { return a.start_row < b.start_row; });
 
-   std::string current_line { };
+   const auto contents = m_source.contents();
+   std::size_t line_start { 0 };
    std::size_t curr_row { 0 }, curr_col { 0 }, curr_report { 0 };
-   while (!m_stream.eof() && curr_report < m_reports.size()) {
-      current_line.clear();
-      std::getline(m_stream, current_line);
+   // a trailing newline is followed by one last empty line
+   while (line_start <= contents.size() && curr_report < m_reports.size()) {
+      auto line_end = contents.find('\n', line_start);
+      if (line_end == std::string_view::npos) {
+         line_end = contents.size();
+      }
+
+      const auto current_line = contents.substr(line_start, line_end - line_start);
+      line_start = line_end + 1;
       curr_col = 0;
 
       for (auto _ : current_line) {
          auto report = m_reports.at(curr_report);
 
          if (curr_row == report.start_row && curr_col == report.start_col) {
-            final_report.append(generate_individual_report(m_filepath, current_line, report));
+            final_report.append(generate_individual_report(m_source, current_line, report));
 
             ++curr_report;
             if (curr_report >= m_reports.size()) {
@@ -1,10 +1,9 @@
 #ifndef REPORT_REPORT_HPP
 #define REPORT_REPORT_HPP
 
-#include <filesystem>
-#include <fstream>
-#include <variant>
+#include "source.hpp"
 #include <optional>
+#include <string>
 #include <vector>
 
 namespace report {
@@ -36,15 +35,13 @@ struct Report {
    ReportType type;
 };
 
+// reports are generated out of `source`, so it has to outlive the context
 class Context final {
    std::vector<Report> m_reports;
-   std::filesystem::path m_filepath;
-   std::istringstream m_stream;
-   std::variant<std::filesystem::path, std::string_view> m_contents;
+   const SourceFile &m_source;
 
    public:
-   explicit Context(const std::filesystem::path filepath);
-   explicit Context(std::string_view contents);
+   explicit Context(const SourceFile &source);
    void create_report(ReportType type, Coord start, Coord end, std::string_view error_msg);
 
    std::optional<std::string> generate_final_report();
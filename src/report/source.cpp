@@ -0,0 +1,71 @@
+#include "source.hpp"
+#include <filesystem>
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define N2T_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace report {
+
+SourceFile::SourceFile(const std::filesystem::path filepath, FileAccess access)
+    : m_path { filepath } {
+   if (!std::filesystem::exists(filepath)) {
+      // TODO check appropriate exception to throw
+      throw "The assembly file path does not exist";
+   }
+
+#ifdef N2T_HAS_MMAP
+   int fd = access == FileAccess::Mapped ? open(filepath.c_str(), O_RDONLY) : -1;
+   if (fd != -1) {
+      struct stat st;
+      // empty files can't be mapped, they and anything that isn't a regular file are read instead
+      if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+         void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+         if (mapping != MAP_FAILED) {
+            m_mapping = mapping;
+            m_mapping_size = st.st_size;
+            m_contents = { static_cast<const char *>(mapping), m_mapping_size };
+         }
+      }
+
+      // the mapping stays valid after the descriptor is closed
+      close(fd);
+      if (m_mapping) {
+         return;
+      }
+   }
+#endif
+
+   std::ifstream file { filepath, std::ios::binary };
+   m_file_contents.resize(std::filesystem::file_size(filepath));
+   file.read(m_file_contents.data(), m_file_contents.size());
+   m_file_contents.resize(file.gcount());
+   m_contents = m_file_contents;
+}
+
+SourceFile::SourceFile(
+    std::string_view contents, std::filesystem::path name, std::size_t first_row)
+    : m_path { std::move(name) }
+    , m_contents { contents }
+    , m_first_row { first_row } { }
+
+SourceFile::~SourceFile() {
+#ifdef N2T_HAS_MMAP
+   if (m_mapping) {
+      munmap(m_mapping, m_mapping_size);
+   }
+#endif
+}
+
+std::string_view SourceFile::contents() const noexcept { return m_contents; }
+
+const std::filesystem::path &SourceFile::path() const noexcept { return m_path; }
+
+std::size_t SourceFile::first_row() const noexcept { return m_first_row; }
+
+}; // namespace report
@@ -0,0 +1,53 @@
+#ifndef REPORT_SOURCE_HPP
+#define REPORT_SOURCE_HPP
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace report {
+
+// How `SourceFile` loads a file from disk.
+enum class FileAccess {
+   // memory mapped where possible, the default
+   Mapped,
+   // always read into memory, for files that can change while they're in use (e.g. hot reloads).
+   // Touching the pages of a mapped file that has since been truncated raises SIGBUS.
+   Read,
+};
+
+// The contents of a source file, loaded once and shared by reference by every stage that needs
+// them (lexer, parser, code generation and their error reports).
+// Files are memory mapped where possible and read into memory otherwise, see `FileAccess`. In-memory sources are
+// borrowed, so the caller's buffer has to outlive the `SourceFile`.
+// Tokens and reports point into the contents, so it can't be copied nor moved.
+class SourceFile final {
+   std::filesystem::path m_path { };
+   // only used when the file couldn't be mapped
+   std::string m_file_contents { };
+   void *m_mapping { nullptr };
+   std::size_t m_mapping_size { 0 };
+   std::string_view m_contents { };
+   std::size_t m_first_row { 0 };
+
+   public:
+   explicit SourceFile(
+       const std::filesystem::path filepath, FileAccess access = FileAccess::Mapped);
+   // `name` is only used to refer to the source in reports.
+   // When `contents` are only part of a larger source, `first_row` is the row they start at.
+   explicit SourceFile(
+       std::string_view contents, std::filesystem::path name = { }, std::size_t first_row = 0);
+   ~SourceFile();
+
+   SourceFile(const SourceFile &) = delete;
+   SourceFile &operator=(const SourceFile &) = delete;
+
+   std::string_view contents() const noexcept;
+   const std::filesystem::path &path() const noexcept;
+   std::size_t first_row() const noexcept;
+};
+
+}; // namespace report
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+// Lock-free ring buffer for exactly one producer thread and one consumer thread.
+//
+// `Capacity` has to be a power of two so indices can wrap with a mask. Each side keeps a cached
+// copy of the other side's index and only reloads it when the queue looks full or empty, so in
+// the common case pushing and popping don't touch the other thread's cache line.
+template <typename T, std::size_t Capacity> class SpscQueue final {
+   static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of 2");
+   static constexpr std::size_t CACHE_LINE = 64;
+   static constexpr std::size_t MASK = Capacity - 1;
+
+   std::vector<T> m_slots = std::vector<T>(Capacity);
+
+   // owned by the consumer
+   alignas(CACHE_LINE) std::atomic<std::size_t> m_head { 0 };
+   std::size_t m_cached_tail { 0 };
+
+   // owned by the producer
+   alignas(CACHE_LINE) std::atomic<std::size_t> m_tail { 0 };
+   std::size_t m_cached_head { 0 };
+
+   public:
+   // producer only, returns false if the queue is full
+   bool try_push(const T &value) {
+      const auto tail = m_tail.load(std::memory_order_relaxed);
+      if (tail - m_cached_head == Capacity) {
+         m_cached_head = m_head.load(std::memory_order_acquire);
+         if (tail - m_cached_head == Capacity) {
+            return false;
+         }
+      }
+
+      m_slots[tail & MASK] = value;
+      m_tail.store(tail + 1, std::memory_order_release);
+      return true;
+   }
+
+   // consumer only, returns the element `offset` places after the oldest one without removing
+   // anything, nullptr if there aren't that many
+   T *peek(std::size_t offset) {
+      const auto head = m_head.load(std::memory_order_relaxed);
+      if (m_cached_tail - head <= offset) {
+         m_cached_tail = m_tail.load(std::memory_order_acquire);
+         if (m_cached_tail - head <= offset) {
+            return nullptr;
+         }
+      }
+
+      return &m_slots[(head + offset) & MASK];
+   }
+
+   // consumer only, returns the oldest element without removing it
+   T *front() { return peek(0); }
+
+   // consumer only, removes the element returned by `front`
+   void pop() {
+      const auto head = m_head.load(std::memory_order_relaxed);
+      m_head.store(head + 1, std::memory_order_release);
+   }
+
+   // consumer only
+   std::optional<T> try_pop() {
+      auto value = front();
+      if (!value) {
+         return std::nullopt;
+      }
+
+      std::optional<T> popped { *value };
+      pop();
+      return popped;
+   }
+};
+
+#endif
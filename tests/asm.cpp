@@ -0,0 +1,233 @@
+// Every way of assembling a program has to give the same output as `Lexer`, `Parser` and
+// `CodeGen`, which is what `assembly::assemble` goes through. Optimized programs have to leave RAM
+// the same way the unoptimized ones do once they halt.
+
+#include "../src/asm/asm.hpp"
+#include "../src/hack/hack.hpp"
+#include "../src/report/source.hpp"
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// the sample programs halt well before this
+constexpr std::uint64_t cycles_to_halt = 2'000'000;
+
+struct Program {
+   std::string name { };
+   std::string source { };
+   // whether it ends in a loop jumping in place, so it can be run to compare the optimized output
+   bool halts { true };
+   // Programs translated from VM code, kept in `programs/vm`. Their stack holds return addresses,
+   // which move when the program is optimized, so only the VM's pointers and statics are compared.
+   bool from_vm { false };
+};
+
+static int failures = 0;
+
+static void expect(bool condition, const Program &program, std::string_view what) {
+   if (!condition) {
+      std::cerr << std::format("FAIL `{}`: {}\n", program.name, what);
+      ++failures;
+   }
+}
+
+static std::vector<Program> read_programs() {
+   const fs::path dir { N2T_TEST_PROGRAMS };
+   std::vector<fs::path> paths { };
+   for (const auto &entry : fs::recursive_directory_iterator { dir }) {
+      if (entry.path().extension() == ".asm") {
+         paths.push_back(entry.path());
+      }
+   }
+   std::sort(paths.begin(), paths.end());
+
+   std::vector<Program> programs { };
+   for (const auto &path : paths) {
+      std::ifstream file { path, std::ios::binary };
+      std::stringstream contents { };
+      contents << file.rdbuf();
+      programs.push_back({
+          .name = fs::relative(path, dir).generic_string(),
+          .source = contents.str(),
+          .from_vm = path.parent_path().filename() == "vm",
+      });
+   }
+   return programs;
+}
+
+// large enough to be split into several chunks by `ParallelAssembler`, with labels used before
+// and after they're declared and variables first used in every chunk
+static Program make_large_program() {
+   constexpr std::size_t blocks = 2000;
+   Program program { .name = "generated", .halts = false };
+   for (std::size_t i = 0; i < blocks; i++) {
+      program.source += std::format("// block {}: adds {} to a variable\n"
+                                    "(Generated.function_{}$label_{})\n"
+                                    "   @Generated.variable_{}\n"
+                                    "   D=M\n"
+                                    "   @{}\n"
+                                    "   D=D+A\n"
+                                    "   @Generated.function_{}$label_{}\n"
+                                    "   D;JGT   // jumps forward or back\n\n",
+          i, i, i % 61, i, i % 97, i, (i * 7) % 61, (i * 7919) % blocks);
+   }
+   return program;
+}
+
+static std::vector<std::string_view> split_lines(std::string_view source) {
+   std::vector<std::string_view> lines { };
+   while (!source.empty()) {
+      const auto newline = source.find('\n');
+      lines.push_back(source.substr(0, newline));
+      source = newline == std::string_view::npos ? "" : source.substr(newline + 1);
+   }
+   return lines;
+}
+
+static void test_stream(const Program &program, const std::vector<std::uint16_t> &expected) {
+   std::ostringstream output { };
+   assembly::StreamAssembler assembler { output, program.name };
+   for (const auto line : split_lines(program.source)) {
+      assembler.feed_line(line);
+   }
+
+   const auto size = assembler.finish();
+   expect(size == expected.size(), program,
+       "StreamAssembler assembled a different number of instructions");
+   expect(output.str() == assembly::to_string(expected), program,
+       "StreamAssembler output differs");
+}
+
+// Lines the parser rejects without a report of its own still have to fail the whole program and
+// hold back the output, like they do for `assembly::assemble`
+static void test_stream_errors() {
+   for (const std::string_view bad_line : { "(LOOP", "@" }) {
+      const Program program { .name = std::format("stream with `{}`", bad_line) };
+      const std::string source = std::format("D=A\n{}\n@LOOP\n0;JMP\n", bad_line);
+      expect(!assembly::assemble(source).has_value(), program, "assembles");
+
+      std::ostringstream output { };
+      assembly::StreamAssembler assembler { output, program.name };
+      for (const auto line : split_lines(source)) {
+         assembler.feed_line(line);
+      }
+      expect(!assembler.finish().has_value(), program, "StreamAssembler didn't fail");
+      expect(!assembler.get_error_report().empty(), program, "StreamAssembler reported nothing");
+      // `D=A` was written before the error was found, nothing after it is
+      expect(output.str() == assembly::to_string(assembly::assemble("D=A").value()), program,
+          "StreamAssembler kept writing after the error");
+   }
+}
+
+static void test_parallel(const Program &program, const std::vector<std::uint16_t> &expected) {
+   const report::SourceFile source { std::string_view { program.source }, program.name };
+   for (const std::size_t threads : { 1, 4 }) {
+      assembly::ParallelAssembler assembler { source, threads };
+      const auto rom = assembler.assemble();
+      expect(rom == expected, program,
+          std::format("ParallelAssembler output differs with {} threads", threads));
+   }
+}
+
+static void test_session(const Program &program, const std::vector<std::uint16_t> &expected) {
+   assembly::AssemblySession session { program.name };
+   session.load(program.source);
+   expect(!session.has_errors() && session.rom() == expected, program,
+       "AssemblySession output differs");
+
+   // drops a line from the middle and adds a new variable in its place
+   auto lines = split_lines(program.source);
+   const auto middle = lines.size() / 2;
+   std::string edited { };
+   for (std::size_t i = 0; i < lines.size(); i++) {
+      if (i == middle) {
+         edited += "@Edited.variable\nM=0\n";
+      } else {
+         edited += lines[i];
+         edited += '\n';
+      }
+   }
+
+   session.update(edited);
+   const auto edited_expected = assembly::assemble(edited);
+   expect(edited_expected.has_value() && !session.has_errors()
+           && session.rom() == edited_expected.value(),
+       program, "AssemblySession output differs after an edit");
+}
+
+// RAM once the program has been running for long enough to halt
+static std::unique_ptr<Hack> run_to_halt(const std::vector<std::uint16_t> &rom) {
+   auto hack = std::make_unique<Hack>();
+   if (!hack->load_rom(rom)) {
+      return nullptr;
+   }
+   for (std::uint64_t i = 0; i < cycles_to_halt; i++) {
+      hack->tick();
+   }
+   return hack;
+}
+
+static void test_optimized(const Program &program, const std::vector<std::uint16_t> &expected) {
+   const report::SourceFile source { std::string_view { program.source }, program.name };
+   assembly::ParallelAssembler assembler { source, 1 };
+   assembler.set_optimize(true);
+   const auto rom = assembler.assemble();
+   expect(rom.has_value() && rom->size() <= expected.size(), program,
+       "optimizing made the program larger");
+   if (!rom.has_value() || !program.halts) {
+      return;
+   }
+
+   const auto plain = run_to_halt(expected);
+   const auto optimized = run_to_halt(rom.value());
+   if (!plain || !optimized) {
+      expect(false, program, "doesn't fit in ROM");
+      return;
+   }
+
+   // SP, LCL, ARG, THIS and THAT, then the statics
+   constexpr std::array<std::pair<std::size_t, std::size_t>, 2> vm_ram { {
+       { 0, 5 },
+       { 16, 256 },
+   } };
+   bool same = plain->data_mem == optimized->data_mem;
+   if (program.from_vm) {
+      same = std::all_of(vm_ram.begin(), vm_ram.end(), [&](auto range) {
+         return std::equal(plain->data_mem.begin() + range.first,
+             plain->data_mem.begin() + range.second, optimized->data_mem.begin() + range.first);
+      });
+   }
+   expect(same, program, "the optimized program leaves RAM differently");
+}
+
+int main() {
+   auto programs = read_programs();
+   programs.push_back(make_large_program());
+
+   for (const auto &program : programs) {
+      const auto expected = assembly::assemble(program.source);
+      expect(expected.has_value(), program, "doesn't assemble");
+      if (!expected.has_value()) {
+         continue;
+      }
+
+      test_stream(program, expected.value());
+      test_parallel(program, expected.value());
+      test_session(program, expected.value());
+      test_optimized(program, expected.value());
+   }
+
+   test_stream_errors();
+
+   std::cout << std::format("{} programs, {} failures\n", programs.size(), failures);
+   return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,51 @@
+// Blackens the top half of the screen, then clears every other row of it.
+
+   @SCREEN
+   D=A
+   @ptr
+   M=D
+(FILL)
+   @ptr
+   A=M
+   M=-1
+   @ptr
+   M=M+1
+   D=M
+   @20480   // SCREEN + 4096, the top half
+   D=D-A
+   @FILL
+   D;JLT
+
+   @SCREEN
+   D=A
+   @row
+   M=D
+(ROW)
+   @32      // words per row
+   D=A
+   @left
+   M=D
+(CLEAR)
+   @row
+   A=M
+   M=0
+   @row
+   M=M+1
+   @left
+   MD=M-1
+   @CLEAR
+   D;JGT
+
+   // skips the next row
+   @32
+   D=A
+   @row
+   MD=D+M
+   @20480
+   D=D-A
+   @ROW
+   D;JLT
+
+(END)
+   @END
+   0;JMP
@@ -0,0 +1,54 @@
+// Stores the largest of R0 and R1 in R2, then the largest of R3 and R4 in R5.
+
+@1234
+D=A
+@R0
+M=D
+@4321
+D=A
+@R1
+M=D
+@30000
+D=A
+@R3
+M=D
+@R4
+M=-1
+
+@R0
+D=M
+@R1
+D=D-M
+@FIRST_IS_MAX
+D;JGT
+@R1
+D=M
+@STORE_FIRST
+0;JMP
+(FIRST_IS_MAX)
+@R0
+D=M
+(STORE_FIRST)
+@R2
+M=D
+
+@R3
+D=M
+@R4
+D=D-M
+@SECOND_IS_MAX
+D;JGT
+@R4
+D=M
+@STORE_SECOND
+0;JMP
+(SECOND_IS_MAX)
+@R3
+D=M
+(STORE_SECOND)
+@R5
+M=D
+
+(END)
+@END
+0;JMP
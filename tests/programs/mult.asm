@@ -0,0 +1,33 @@
+// Multiplies R0 by R1 into R2 through repeated addition.
+
+   @7
+   D=A
+   @R0
+   M=D
+   @9
+   D=A
+   @R1
+   M=D
+
+   @R2
+   M=0
+   @i
+   M=0
+(LOOP)
+   @i
+   D=M
+   @R1
+   D=D-M
+   @END
+   D;JGE
+   @R0
+   D=M
+   @R2
+   M=D+M
+   @i
+   M=M+1
+   @LOOP
+   0;JMP
+(END)
+   @END
+   0;JMP
@@ -0,0 +1,81 @@
+// Writes the numbers 1 to 100 into an array and adds them up into `total`,
+// copying the array somewhere else along the way.
+
+@100
+D=A
+@count
+M=D
+@1000
+D=A
+@array
+M=D
+@n
+M=1
+
+(WRITE)
+@n
+D=M
+@array
+A=M
+M=D
+@array
+M=M+1
+@n
+MD=M+1
+@count
+D=D-M
+@WRITE
+D;JLE
+
+// copy the array to 2000
+@1000
+D=A
+@src
+M=D
+@2000
+D=A
+@dst
+M=D
+@count
+D=M
+@left
+M=D
+(COPY)
+@src
+A=M
+D=M
+@dst
+A=M
+M=D
+@src
+M=M+1
+@dst
+M=M+1
+@left
+MD=M-1
+@COPY
+D;JGT
+
+@2000
+D=A
+@ptr
+M=D
+@total
+M=0
+(ADD)
+@ptr
+A=M
+D=M
+@total
+M=D+M
+@ptr
+M=M+1
+D=M
+@2100
+D=D-A
+@ADD
+D;JLT
+
+(END)
+@END
+0;JMP